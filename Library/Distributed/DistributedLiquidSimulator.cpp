@@ -0,0 +1,218 @@
+#include "DistributedLiquidSimulator.h"
+
+#include <array>
+#include <cmath>
+#include <iostream>
+
+#include "ComputeWeights.h"
+#include "DistributedPressureProjection.h"
+#include "ExtrapolateField.h"
+#include "FieldAdvector.h"
+#include "Timer.h"
+
+namespace FluidSim3D::Distributed
+{
+using namespace SimTools;
+
+DistributedLiquidSimulator::DistributedLiquidSimulator(const SlabDecomposition& decomposition, float cfl)
+    : myDecomposition(decomposition), myCFL(cfl)
+{
+    assert(decomposition.ghostWidth() >= ghostWidth(cfl));
+
+    const Transform& xform = decomposition.localXform();
+    const Vec3i& size = decomposition.localSize();
+
+    myLiquidVelocity = VectorGrid<float>(xform, size, VectorGridSettings::SampleType::STAGGERED);
+    mySolidVelocity = VectorGrid<float>(xform, size, 0., VectorGridSettings::SampleType::STAGGERED);
+
+    myLiquidSurface = LevelSet(xform, size, myCFL);
+    mySolidSurface = LevelSet(xform, size, myCFL);
+
+    myOldPressure = ScalarGrid<float>(xform, size, 0);
+}
+
+void DistributedLiquidSimulator::setSolidSurface(const TriMesh& solidMesh)
+{
+    mySolidSurface.setBackgroundNegative();
+    mySolidSurface.initFromMesh(solidMesh, false);
+
+    myDecomposition.exchangeHalo(mySolidSurface);
+}
+
+void DistributedLiquidSimulator::setLiquidSurface(const TriMesh& liquidMesh)
+{
+    myLiquidSurface.initFromMesh(liquidMesh, false);
+
+    myDecomposition.exchangeHalo(myLiquidSurface);
+}
+
+void DistributedLiquidSimulator::addForce(float dt, const Vec3f& force)
+{
+    // Ghost faces get the same update as their owners so no exchange is needed
+    for (int axis : {0, 1, 2})
+    {
+        parallelFor(KernelClass::LIGHT, 0, myLiquidVelocity.grid(axis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
+                            myLiquidVelocity(face, axis) += dt * force[axis];
+                        }
+                    });
+    }
+}
+
+float DistributedLiquidSimulator::maxVelocityMagnitude() const
+{
+    Vec3i ownedMin(myDecomposition.localOwnedBegin(), 0, 0);
+    Vec3i ownedMax(myDecomposition.localOwnedEnd(), myLiquidSurface.size()[1], myLiquidSurface.size()[2]);
+
+    float localMax = parallelReduce(
+        KernelClass::LIGHT, ownedMin[0], ownedMax[0], float(0),
+        [&](const tbb::blocked_range<int>& range, float partialMax) -> float {
+            Vec3i sliceMin = ownedMin, sliceMax = ownedMax;
+            sliceMin[0] = range.begin();
+            sliceMax[0] = range.end();
+
+            forEachVoxelRange(sliceMin, sliceMax, [&](const Vec3i& cell) {
+                Vec3f averageVelocity;
+                for (int axis : {0, 1, 2})
+                    averageVelocity[axis] = .5 * (myLiquidVelocity(cellToFace(cell, axis, 0), axis) +
+                                                  myLiquidVelocity(cellToFace(cell, axis, 1), axis));
+
+                partialMax = std::max(partialMax, mag(averageVelocity));
+            });
+
+            return partialMax;
+        },
+        [](float x, float y) -> float { return std::max(x, y); });
+
+    return myDecomposition.max(localMax);
+}
+
+void DistributedLiquidSimulator::runTimestep(float dt)
+{
+    bool doPrint = myDecomposition.isRoot();
+
+    if (doPrint) std::cout << "\nStarting distributed simulation loop\n" << std::endl;
+
+    Timer simTimer;
+
+    // Extrapolate the liquid into the solid
+    LevelSet extrapolatedSurface = myLiquidSurface;
+
+    float dx = extrapolatedSurface.dx();
+
+    parallelFor(KernelClass::LIGHT, 0, myLiquidSurface.voxelCount(), [&](const tbb::blocked_range<int>& range) {
+        for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+        {
+            Vec3i cell = myLiquidSurface.unflatten(cellIndex);
+
+            if (mySolidSurface(cell) <= 0) extrapolatedSurface(cell) -= dx;
+        }
+    });
+
+    extrapolatedSurface.reinit();
+    myDecomposition.exchangeHalo(extrapolatedSurface);
+
+    if (doPrint) std::cout << "  Extrapolate into solids: " << simTimer.stop() << "s" << std::endl;
+
+    simTimer.reset();
+
+    // Faces on the edge of the local grid are missing a neighbour so their weights come from the owner
+    VectorGrid<float> cutCellWeights = computeCutCellWeights(mySolidSurface, true);
+    VectorGrid<float> ghostFluidWeights = computeGhostFluidWeights(extrapolatedSurface);
+
+    exchangeHalo(cutCellWeights);
+    exchangeHalo(ghostFluidWeights);
+
+    if (doPrint) std::cout << "  Compute weights: " << simTimer.stop() << "s" << std::endl;
+
+    simTimer.reset();
+
+    DistributedPressureProjection projectDivergence(myDecomposition, extrapolatedSurface, cutCellWeights,
+                                                    ghostFluidWeights, mySolidVelocity);
+
+    projectDivergence.setInitialGuess(myOldPressure);
+    projectDivergence.project(myLiquidVelocity);
+
+    myOldPressure = projectDivergence.takePressureGrid();
+    myDecomposition.exchangeHalo(myOldPressure);
+
+    exchangeHalo(myLiquidVelocity);
+
+    std::array<BitMaskGrid, 3> validFaces = projectDivergence.takeValidFaces();
+
+    if (doPrint) std::cout << "  Solve for pressure: " << simTimer.stop() << "s" << std::endl;
+
+    simTimer.reset();
+
+    // The extrapolation band fits inside the ghost layers so owned faces see every valid face they would
+    // on a single grid. The ghost faces are then replaced by the owners' values.
+    for (int axis : {0, 1, 2})
+    {
+        validFaces[axis].forEachVoxel(false, [&](int faceIndex) {
+            myLiquidVelocity(validFaces[axis].unflatten(faceIndex), axis) = 0;
+        });
+
+        extrapolateField(myLiquidVelocity.grid(axis), std::move(validFaces[axis]), 1.5 * myCFL);
+    }
+
+    exchangeHalo(myLiquidVelocity);
+
+    if (doPrint) std::cout << "  Extrapolate velocity: " << simTimer.stop() << "s" << std::endl;
+
+    simTimer.reset();
+
+    // Semi-Lagrangian advection. Backtraces from owned samples stay inside the ghost layers.
+    auto velocityFunc = [&](float, const Vec3f& point) { return myLiquidVelocity.interp(point); };
+
+    {
+        ScalarGrid<float> tempPressure(myOldPressure.xform(), myOldPressure.size());
+        advectField(dt, tempPressure, myOldPressure, velocityFunc, IntegrationOrder::RK3);
+        std::swap(myOldPressure, tempPressure);
+    }
+
+    {
+        LevelSet tempSurface = myLiquidSurface;
+        advectField(dt, tempSurface, myLiquidSurface, velocityFunc, IntegrationOrder::RK3);
+        std::swap(myLiquidSurface, tempSurface);
+    }
+
+    VectorGrid<float> tempVelocity(myLiquidVelocity.xform(), myLiquidVelocity.gridSize(),
+                                   VectorGridSettings::SampleType::STAGGERED);
+
+    for (int axis : {0, 1, 2})
+        advectField(dt, tempVelocity.grid(axis), myLiquidVelocity.grid(axis), velocityFunc, IntegrationOrder::RK3);
+
+    std::swap(myLiquidVelocity, tempVelocity);
+
+    // Remove solid regions from liquid surface
+    parallelFor(KernelClass::LIGHT, 0, myLiquidSurface.voxelCount(), [&](const tbb::blocked_range<int>& range) {
+        for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+        {
+            Vec3i cell = myLiquidSurface.unflatten(cellIndex);
+            myLiquidSurface(cell) = std::max(myLiquidSurface(cell), -mySolidSurface(cell));
+        }
+    });
+
+    myLiquidSurface.reinit();
+
+    myDecomposition.exchangeHalo(myOldPressure);
+    myDecomposition.exchangeHalo(myLiquidSurface);
+    exchangeHalo(myLiquidVelocity);
+
+    if (doPrint) std::cout << "  Advect simulation: " << simTimer.stop() << "s" << std::endl;
+}
+
+void DistributedLiquidSimulator::gatherLiquidSurface(LevelSet& globalSurface) const
+{
+    myDecomposition.gather(myLiquidSurface, globalSurface);
+}
+
+void DistributedLiquidSimulator::gatherLiquidVelocity(VectorGrid<float>& globalVelocity) const
+{
+    for (int axis : {0, 1, 2}) myDecomposition.gather(myLiquidVelocity.grid(axis), globalVelocity.grid(axis));
+}
+
+}  // namespace FluidSim3D::Distributed
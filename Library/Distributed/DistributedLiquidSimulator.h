@@ -0,0 +1,84 @@
+#ifndef LIBRARY_DISTRIBUTED_LIQUID_SIMULATOR_H
+#define LIBRARY_DISTRIBUTED_LIQUID_SIMULATOR_H
+
+#include <cmath>
+
+#include "LevelSet.h"
+#include "ScalarGrid.h"
+#include "SlabDecomposition.h"
+#include "TriMesh.h"
+#include "Utilities.h"
+#include "Vec.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// DistributedLiquidSimulator.h/cpp
+//
+// The inviscid part of EulerianLiquidSimulator
+// run over a slab decomposition. Each rank keeps
+// padded local grids for its slab and refreshes
+// the ghost layers after every stage that reads
+// across slab boundaries. The ghost width covers
+// the velocity extrapolation band and the furthest
+// an advection backtrace can travel in one
+// CFL-limited timestep.
+//
+// The liquid surface is advected as a level set
+// and redistanced geometrically, since the local
+// surface mesh of a slab isn't closed.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Distributed
+{
+using namespace SurfaceTrackers;
+using namespace Utilities;
+
+class DistributedLiquidSimulator
+{
+public:
+    DistributedLiquidSimulator(const SlabDecomposition& decomposition, float cfl = 5);
+
+    // Ghost width needed by a decomposition for a given CFL number
+    static int ghostWidth(float cfl) { return int(std::ceil(1.5 * cfl)) + 2; }
+
+    // Every rank passes the same global mesh and scan converts its own slab of it
+    void setSolidSurface(const TriMesh& solidMesh);
+    void setLiquidSurface(const TriMesh& liquidMesh);
+
+    void addForce(float dt, const Vec3f& force);
+
+    // Perform pressure projection, extrapolation, surface and velocity advection
+    void runTimestep(float dt);
+
+    // Useful for CFL. The maximum is taken over all ranks.
+    float maxVelocityMagnitude() const;
+
+    // Collect the owned parts of the simulation on the root rank. The global grids are
+    // only written on the root.
+    void gatherLiquidSurface(LevelSet& globalSurface) const;
+    void gatherLiquidVelocity(VectorGrid<float>& globalVelocity) const;
+
+    const SlabDecomposition& decomposition() const { return myDecomposition; }
+
+private:
+    void exchangeHalo(VectorGrid<float>& grid) const
+    {
+        for (int axis : {0, 1, 2}) myDecomposition.exchangeHalo(grid.grid(axis));
+    }
+
+    const SlabDecomposition& myDecomposition;
+
+    // Simulation containers over the padded local slab
+    VectorGrid<float> myLiquidVelocity, mySolidVelocity;
+    LevelSet myLiquidSurface, mySolidSurface;
+
+    float myCFL;
+
+    ScalarGrid<float> myOldPressure;
+};
+
+}  // namespace FluidSim3D::Distributed
+
+#endif
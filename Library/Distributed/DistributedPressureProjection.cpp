@@ -0,0 +1,337 @@
+#include "DistributedPressureProjection.h"
+
+#include <array>
+#include <iostream>
+
+namespace FluidSim3D::Distributed
+{
+using SolveReal = double;
+
+DistributedPressureProjection::DistributedPressureProjection(const SlabDecomposition& decomposition,
+                                                             const LevelSet& surface,
+                                                             const VectorGrid<float>& cutCellWeights,
+                                                             const VectorGrid<float>& ghostFluidWeights,
+                                                             const VectorGrid<float>& solidVelocity)
+    : myDecomposition(decomposition),
+      mySolidVelocity(solidVelocity),
+      myGhostFluidWeights(ghostFluidWeights),
+      myCutCellWeights(cutCellWeights),
+      mySurface(surface),
+      myInitialGuessPressure(nullptr),
+      myUseInitialGuessPressure(false),
+      myIterations(0),
+      myError(0)
+{
+    assert(solidVelocity.sampleType() == VectorGridSettings::SampleType::STAGGERED);
+    assert(surface.size() == decomposition.localSize());
+    assert(solidVelocity.isGridMatched(cutCellWeights) && solidVelocity.isGridMatched(ghostFluidWeights));
+
+    myPressure = ScalarGrid<float>(surface.xform(), surface.size(), 0);
+    for (int axis : {0, 1, 2}) myValidFaces[axis].resize(solidVelocity.size(axis));
+}
+
+void DistributedPressureProjection::project(VectorGrid<float>& velocity)
+{
+    assert(velocity.isGridMatched(mySolidVelocity));
+
+    enum class MaterialLabels
+    {
+        SOLID_CELL,
+        AIR_CELL,
+        LIQUID_CELL
+    };
+
+    // Labels only depend on the local weights and surface so ghost cells are labelled
+    // the same way as on the rank that owns them.
+    PackedLabelGrid<MaterialLabels, 2> materialCellLabels(mySurface.size());
+
+    materialCellLabels.assign([&](int cellIndex) {
+        Vec3i cell = materialCellLabels.unflatten(cellIndex);
+
+        for (int axis : {0, 1, 2})
+            for (int direction : {0, 1})
+            {
+                Vec3i face = cellToFace(cell, axis, direction);
+
+                if (myCutCellWeights(face, axis) > 0)
+                    return mySurface(cell) <= 0 ? MaterialLabels::LIQUID_CELL : MaterialLabels::AIR_CELL;
+            }
+
+        return MaterialLabels::SOLID_CELL;
+    });
+
+    // Number the owned liquid cells
+    constexpr int UNLABELLED_CELL = -1;
+
+    UniformGrid<int> liquidCellIndices(mySurface.size(), UNLABELLED_CELL);
+    std::vector<Vec3i> liquidCells;
+
+    Vec3i ownedMin(myDecomposition.localOwnedBegin(), 0, 0);
+    Vec3i ownedMax(myDecomposition.localOwnedEnd(), mySurface.size()[1], mySurface.size()[2]);
+
+    forEachVoxelRange(ownedMin, ownedMax, [&](const Vec3i& cell) {
+        if (materialCellLabels(cell) == MaterialLabels::LIQUID_CELL)
+        {
+            liquidCellIndices(cell) = liquidCells.size();
+            liquidCells.push_back(cell);
+        }
+    });
+
+    int liquidCellCount = liquidCells.size();
+    double globalLiquidCellCount = myDecomposition.sum(liquidCellCount);
+
+    // Build the rows for the owned liquid cells. Off-diagonal weights to cells that aren't liquid are zero.
+    std::vector<SolveReal> rhsVector(liquidCellCount, 0);
+    std::vector<SolveReal> solutionVector(liquidCellCount, 0);
+    std::vector<SolveReal> diagonals(liquidCellCount, 0);
+    std::vector<std::array<SolveReal, 6>> offDiagonals(liquidCellCount);
+
+    parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+        for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+        {
+            Vec3i cell = liquidCells[liquidIndex];
+
+            SolveReal divergence = 0;
+            SolveReal diagonal = 0;
+
+            for (int axis : {0, 1, 2})
+                for (int direction : {0, 1})
+                {
+                    Vec3i face = cellToFace(cell, axis, direction);
+
+                    SolveReal weight = myCutCellWeights(face, axis);
+
+                    SolveReal sign = (direction == 0) ? 1 : -1;
+
+                    // Add divergence from faces
+                    if (weight > 0) divergence += sign * weight * velocity(face, axis);
+                    if (weight < 1.) divergence += sign * (1. - weight) * mySolidVelocity(face, axis);
+
+                    SolveReal& offDiagonal = offDiagonals[liquidIndex][2 * axis + direction];
+                    offDiagonal = 0;
+
+                    Vec3i adjacentCell = cellToCell(cell, axis, direction);
+
+                    // Bounds check. Slabs are padded on internal boundaries so this only
+                    // triggers at the edge of the global domain.
+                    if (adjacentCell[axis] < 0 || adjacentCell[axis] >= mySurface.size()[axis]) continue;
+
+                    if (weight > 0)
+                    {
+                        if (materialCellLabels(adjacentCell) == MaterialLabels::LIQUID_CELL)
+                        {
+                            offDiagonal = weight;
+                            diagonal += weight;
+                        }
+                        else
+                        {
+                            assert(materialCellLabels(adjacentCell) == MaterialLabels::AIR_CELL);
+
+                            SolveReal theta = myGhostFluidWeights(face, axis);
+
+                            theta = Utilities::clamp(theta, SolveReal(.01), SolveReal(1));
+                            diagonal += weight / theta;
+                        }
+                    }
+                }
+
+            assert(diagonal > 0);
+
+            rhsVector[liquidIndex] = divergence;
+            diagonals[liquidIndex] = diagonal;
+
+            if (myUseInitialGuessPressure)
+            {
+                assert(myInitialGuessPressure != nullptr);
+                solutionVector[liquidIndex] = (*myInitialGuessPressure)(cell);
+            }
+        }
+    });
+
+    // Matrix-vector product. The vector is scattered onto the local grid so the values of
+    // neighbouring cells on other ranks arrive through a one layer halo exchange.
+    UniformGrid<SolveReal> stencilGrid(mySurface.size(), 0);
+
+    auto applyMatrix = [&](const std::vector<SolveReal>& vector, std::vector<SolveReal>& product) {
+        parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+            for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+                stencilGrid(liquidCells[liquidIndex]) = vector[liquidIndex];
+        });
+
+        myDecomposition.exchangeHalo(stencilGrid, 1);
+
+        parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+            for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+            {
+                Vec3i cell = liquidCells[liquidIndex];
+
+                SolveReal value = diagonals[liquidIndex] * vector[liquidIndex];
+
+                for (int axis : {0, 1, 2})
+                    for (int direction : {0, 1})
+                    {
+                        SolveReal offDiagonal = offDiagonals[liquidIndex][2 * axis + direction];
+                        if (offDiagonal != 0) value -= offDiagonal * stencilGrid(cellToCell(cell, axis, direction));
+                    }
+
+                product[liquidIndex] = value;
+            }
+        });
+    };
+
+    auto dot = [&](const std::vector<SolveReal>& vector0, const std::vector<SolveReal>& vector1) {
+        SolveReal localDot = parallelReduce(
+            KernelClass::LIGHT, 0, liquidCellCount, SolveReal(0),
+            [&](const tbb::blocked_range<int>& range, SolveReal partialDot) -> SolveReal {
+                for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+                    partialDot += vector0[liquidIndex] * vector1[liquidIndex];
+
+                return partialDot;
+            },
+            [](SolveReal x, SolveReal y) -> SolveReal { return x + y; });
+
+        return myDecomposition.sum(localDot);
+    };
+
+    auto axpy = [&](SolveReal alpha, const std::vector<SolveReal>& x, std::vector<SolveReal>& y) {
+        parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+            for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+                y[liquidIndex] += alpha * x[liquidIndex];
+        });
+    };
+
+    auto precondition = [&](const std::vector<SolveReal>& residual, std::vector<SolveReal>& preconditioned) {
+        parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+            for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+                preconditioned[liquidIndex] = residual[liquidIndex] / diagonals[liquidIndex];
+        });
+    };
+
+    // Jacobi preconditioned CG with the same stopping rule as the Eigen solver used by PressureProjection
+    constexpr SolveReal tolerance = 1E-3;
+    int maxIterations = 2 * int(globalLiquidCellCount);
+
+    std::vector<SolveReal> residual(liquidCellCount), preconditioned(liquidCellCount);
+    std::vector<SolveReal> direction(liquidCellCount), matrixDirection(liquidCellCount);
+
+    applyMatrix(solutionVector, residual);
+    parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+        for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+            residual[liquidIndex] = rhsVector[liquidIndex] - residual[liquidIndex];
+    });
+
+    SolveReal rhsNorm2 = dot(rhsVector, rhsVector);
+
+    myIterations = 0;
+    myError = 0;
+
+    if (rhsNorm2 == 0)
+        std::fill(solutionVector.begin(), solutionVector.end(), 0);
+    else
+    {
+        SolveReal threshold = tolerance * tolerance * rhsNorm2;
+        SolveReal residualNorm2 = dot(residual, residual);
+
+        precondition(residual, direction);
+        SolveReal absNew = dot(residual, direction);
+
+        while (residualNorm2 >= threshold && myIterations < maxIterations)
+        {
+            applyMatrix(direction, matrixDirection);
+
+            SolveReal alpha = absNew / dot(direction, matrixDirection);
+
+            axpy(alpha, direction, solutionVector);
+            axpy(-alpha, matrixDirection, residual);
+
+            residualNorm2 = dot(residual, residual);
+            ++myIterations;
+
+            if (residualNorm2 < threshold) break;
+
+            precondition(residual, preconditioned);
+
+            SolveReal absOld = absNew;
+            absNew = dot(residual, preconditioned);
+
+            SolveReal beta = absNew / absOld;
+
+            parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+                for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+                    direction[liquidIndex] = preconditioned[liquidIndex] + beta * direction[liquidIndex];
+            });
+        }
+
+        myError = std::sqrt(residualNorm2 / rhsNorm2);
+
+        if (myIterations == maxIterations && myError > tolerance && myDecomposition.isRoot())
+            std::cout << "   Solver failed to converge" << std::endl;
+    }
+
+    if (myDecomposition.isRoot())
+    {
+        std::cout << "    Solver iterations:     " << myIterations << std::endl;
+        std::cout << "    Solver error: " << myError << std::endl;
+    }
+
+    // Copy the owned solution to the pressure grid and bring in the neighbouring layer for the gradient
+    parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+        for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+            myPressure(liquidCells[liquidIndex]) = solutionVector[liquidIndex];
+    });
+
+    myDecomposition.exchangeHalo(myPressure, 1);
+
+    // Build valid faces over the whole local grid so the ghost faces match their owners
+    for (int axis : {0, 1, 2})
+    {
+        BitMaskGrid& validFaces = myValidFaces[axis];
+
+        validFaces.assign([&](int faceIndex) {
+            Vec3i face = validFaces.unflatten(faceIndex);
+
+            if (myCutCellWeights(face, axis) > 0)
+            {
+                Vec3i backwardCell = faceToCell(face, axis, 0);
+                Vec3i forwardCell = faceToCell(face, axis, 1);
+
+                if (backwardCell[axis] < 0 || forwardCell[axis] >= mySurface.size()[axis]) return false;
+
+                return materialCellLabels(backwardCell) == MaterialLabels::LIQUID_CELL ||
+                       materialCellLabels(forwardCell) == MaterialLabels::LIQUID_CELL;
+            }
+
+            return false;
+        });
+    }
+
+    // Apply pressure update to the owned faces
+    for (int axis : {0, 1, 2})
+    {
+        const BitMaskGrid& validFaces = myValidFaces[axis];
+
+        validFaces.forEachVoxel(true, [&](int faceIndex) {
+            Vec3i face = validFaces.unflatten(faceIndex);
+
+            if (!myDecomposition.isOwnedLayer(face[0], axis == 0)) return;
+
+            Vec3i backwardCell = faceToCell(face, axis, 0);
+            Vec3i forwardCell = faceToCell(face, axis, 1);
+
+            SolveReal gradient = myPressure(forwardCell) - myPressure(backwardCell);
+
+            if (materialCellLabels(backwardCell) == MaterialLabels::AIR_CELL ||
+                materialCellLabels(forwardCell) == MaterialLabels::AIR_CELL)
+            {
+                SolveReal theta = myGhostFluidWeights(face, axis);
+                theta = Utilities::clamp(theta, SolveReal(.01), SolveReal(1));
+
+                gradient /= theta;
+            }
+
+            velocity(face, axis) -= gradient;
+        });
+    }
+}
+
+}  // namespace FluidSim3D::Distributed
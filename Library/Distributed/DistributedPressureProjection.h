@@ -0,0 +1,87 @@
+#ifndef LIBRARY_DISTRIBUTED_PRESSURE_PROJECTION_H
+#define LIBRARY_DISTRIBUTED_PRESSURE_PROJECTION_H
+
+#include <array>
+
+#include "LevelSet.h"
+#include "PackedLabelGrid.h"
+#include "ScalarGrid.h"
+#include "SlabDecomposition.h"
+#include "Utilities.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// DistributedPressureProjection.h/cpp
+//
+// The pressure projection of PressureProjection.h
+// over a slab decomposition. Each rank builds the
+// rows for the liquid cells it owns and the system
+// is solved with Jacobi preconditioned CG without
+// assembling a matrix. Every matrix-vector product
+// exchanges one ghost layer with the neighbouring
+// ranks and every dot product is a global sum.
+//
+// All inputs are local padded grids whose ghost
+// layers are up to date.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Distributed
+{
+using namespace SurfaceTrackers;
+using namespace Utilities;
+
+class DistributedPressureProjection
+{
+public:
+    DistributedPressureProjection(const SlabDecomposition& decomposition, const LevelSet& surface,
+                                  const VectorGrid<float>& cutCellWeights, const VectorGrid<float>& ghostFluidWeights,
+                                  const VectorGrid<float>& solidVelocity);
+
+    // Projects the owned faces of the velocity. Ghost faces must be exchanged afterwards.
+    void project(VectorGrid<float>& velocity);
+
+    void setInitialGuess(const ScalarGrid<float>& initialGuessPressure)
+    {
+        assert(mySurface.isGridMatched(initialGuessPressure));
+        myUseInitialGuessPressure = true;
+        myInitialGuessPressure = &initialGuessPressure;
+    }
+
+    void disableInitialGuess() { myUseInitialGuessPressure = false; }
+
+    const ScalarGrid<float>& getPressureGrid() const { return myPressure; }
+
+    const std::array<BitMaskGrid, 3>& getValidFaces() const { return myValidFaces; }
+
+    // Move the results out instead of copying them. The projection can't project again afterwards.
+    ScalarGrid<float> takePressureGrid() { return std::move(myPressure); }
+    std::array<BitMaskGrid, 3> takeValidFaces() { return std::move(myValidFaces); }
+
+    int iterations() const { return myIterations; }
+    double error() const { return myError; }
+
+private:
+    const SlabDecomposition& myDecomposition;
+
+    const VectorGrid<float>& mySolidVelocity;
+    const VectorGrid<float>& myGhostFluidWeights;
+    const VectorGrid<float>& myCutCellWeights;
+
+    std::array<BitMaskGrid, 3> myValidFaces;
+
+    const LevelSet& mySurface;
+
+    ScalarGrid<float> myPressure;
+
+    const ScalarGrid<float>* myInitialGuessPressure;
+    bool myUseInitialGuessPressure;
+
+    int myIterations;
+    double myError;
+};
+
+}  // namespace FluidSim3D::Distributed
+
+#endif
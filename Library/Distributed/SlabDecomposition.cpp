@@ -0,0 +1,42 @@
+#include "SlabDecomposition.h"
+
+namespace FluidSim3D::Distributed
+{
+SlabDecomposition::SlabDecomposition(MPI_Comm communicator, const Transform& globalXform, const Vec3i& globalSize,
+                                     int ghostWidth)
+    : myCommunicator(communicator), myGlobalXform(globalXform), myGlobalSize(globalSize), myGhostWidth(ghostWidth)
+{
+    assert(ghostWidth > 0);
+
+    MPI_Comm_rank(myCommunicator, &myRank);
+    MPI_Comm_size(myCommunicator, &myRankCount);
+
+    // Halo layers are always taken from the neighbouring rank so a slab must be able to fill
+    // its neighbour's ghost layers (plus the extra x-face layer) on its own.
+    for (int rank = 0; rank < myRankCount; ++rank) assert(ownedEnd(rank) - ownedBegin(rank) > ghostWidth);
+
+    myLocalBegin = std::max(ownedBegin(myRank) - ghostWidth, 0);
+    int localEnd = std::min(ownedEnd(myRank) + ghostWidth, myGlobalSize[0]);
+
+    myLocalSize = Vec3i(localEnd - myLocalBegin, myGlobalSize[1], myGlobalSize[2]);
+
+    Vec3f localOffset = myGlobalXform.offset();
+    localOffset[0] += myLocalBegin * myGlobalXform.dx();
+    myLocalXform = Transform(myGlobalXform.dx(), localOffset);
+}
+
+double SlabDecomposition::sum(double value) const
+{
+    double globalValue;
+    MPI_Allreduce(&value, &globalValue, 1, MPI_DOUBLE, MPI_SUM, myCommunicator);
+    return globalValue;
+}
+
+float SlabDecomposition::max(float value) const
+{
+    float globalValue;
+    MPI_Allreduce(&value, &globalValue, 1, MPI_FLOAT, MPI_MAX, myCommunicator);
+    return globalValue;
+}
+
+}  // namespace FluidSim3D::Distributed
@@ -0,0 +1,238 @@
+#ifndef LIBRARY_SLAB_DECOMPOSITION_H
+#define LIBRARY_SLAB_DECOMPOSITION_H
+
+#include <mpi.h>
+
+#include <type_traits>
+#include <vector>
+
+#include "Transform.h"
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// SlabDecomposition.h/cpp
+//
+// Splits a global cell grid into one slab
+// per MPI rank along the x-axis. Each rank
+// stores its slab padded with ghost layers
+// on the sides that border another rank.
+// Grids are flattened with x as the slowest
+// axis so every layer is contiguous.
+//
+// Cell grids (and y/z-face grids) own the
+// layers of the rank's cells. The x-face grid
+// has one extra layer; each rank owns the
+// faces on the low side of its cells and the
+// last rank also owns the final face.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Distributed
+{
+using namespace Utilities;
+
+class SlabDecomposition
+{
+public:
+    // Every rank in the communicator must construct the decomposition with the same arguments.
+    // Each slab must be wider than the ghost width.
+    SlabDecomposition(MPI_Comm communicator, const Transform& globalXform, const Vec3i& globalSize, int ghostWidth);
+
+    MPI_Comm communicator() const { return myCommunicator; }
+    int rank() const { return myRank; }
+    int rankCount() const { return myRankCount; }
+
+    bool isRoot() const { return myRank == 0; }
+
+    const Transform& globalXform() const { return myGlobalXform; }
+    const Vec3i& globalSize() const { return myGlobalSize; }
+
+    // Padded grid stored by this rank
+    const Transform& localXform() const { return myLocalXform; }
+    const Vec3i& localSize() const { return myLocalSize; }
+
+    int ghostWidth() const { return myGhostWidth; }
+
+    // Range of cells along x owned by a rank, in global index space
+    int ownedBegin(int rank) const { return myGlobalSize[0] * rank / myRankCount; }
+    int ownedEnd(int rank) const { return myGlobalSize[0] * (rank + 1) / myRankCount; }
+
+    // Range of owned cells along x in local index space
+    int localOwnedBegin() const { return ownedBegin(myRank) - myLocalBegin; }
+    int localOwnedEnd() const { return ownedEnd(myRank) - myLocalBegin; }
+
+    // Global x index of the first local layer
+    int localBegin() const { return myLocalBegin; }
+
+    bool hasLowerNeighbour() const { return myRank > 0; }
+    bool hasUpperNeighbour() const { return myRank < myRankCount - 1; }
+
+    // True if a local layer of a cell grid (or of the x-face grid) is owned by this rank
+    bool isOwnedLayer(int localLayer, bool isXFaceGrid = false) const
+    {
+        if (localLayer < localOwnedBegin()) return false;
+        if (localLayer < localOwnedEnd()) return true;
+
+        // The last x-face of the domain
+        return isXFaceGrid && !hasUpperNeighbour() && localLayer == localOwnedEnd();
+    }
+
+    // Overwrite up to layerCount ghost layers on each side with the values from the owning rank.
+    // Works for any grid with a size() and element access by cell, such as UniformGrid,
+    // ScalarGrid or LevelSet, sized either to the local cells or to the local x-faces.
+    template <typename Grid>
+    void exchangeHalo(Grid& grid, int layerCount) const;
+
+    template <typename Grid>
+    void exchangeHalo(Grid& grid) const
+    {
+        exchangeHalo(grid, myGhostWidth + 1);
+    }
+
+    // Collect the owned layers of every rank into a global grid on the root rank. The global
+    // grid must already be sized on the root to the global cells (or x-faces). Other ranks
+    // leave it untouched.
+    template <typename Grid>
+    void gather(const Grid& localGrid, Grid& globalGrid) const;
+
+    double sum(double value) const;
+    float max(float value) const;
+
+private:
+    template <typename Grid, typename T>
+    void packLayers(const Grid& grid, int firstLayer, int layerCount, std::vector<T>& buffer) const;
+
+    template <typename Grid, typename T>
+    void unpackLayers(Grid& grid, int firstLayer, int layerCount, const std::vector<T>& buffer) const;
+
+    MPI_Comm myCommunicator;
+    int myRank, myRankCount;
+
+    Transform myGlobalXform, myLocalXform;
+    Vec3i myGlobalSize, myLocalSize;
+
+    int myGhostWidth;
+    int myLocalBegin;
+};
+
+template <typename Grid, typename T>
+void SlabDecomposition::packLayers(const Grid& grid, int firstLayer, int layerCount, std::vector<T>& buffer) const
+{
+    Vec3i size = grid.size();
+    buffer.resize(layerCount * size[1] * size[2]);
+
+    int index = 0;
+    forEachVoxelRange(Vec3i(firstLayer, 0, 0), Vec3i(firstLayer + layerCount, size[1], size[2]),
+                      [&](const Vec3i& coord) { buffer[index++] = grid(coord); });
+}
+
+template <typename Grid, typename T>
+void SlabDecomposition::unpackLayers(Grid& grid, int firstLayer, int layerCount, const std::vector<T>& buffer) const
+{
+    Vec3i size = grid.size();
+    assert(int(buffer.size()) == layerCount * size[1] * size[2]);
+
+    int index = 0;
+    forEachVoxelRange(Vec3i(firstLayer, 0, 0), Vec3i(firstLayer + layerCount, size[1], size[2]),
+                      [&](const Vec3i& coord) { grid(coord) = buffer[index++]; });
+}
+
+template <typename Grid>
+void SlabDecomposition::exchangeHalo(Grid& grid, int layerCount) const
+{
+    using T = std::decay_t<decltype(grid(Vec3i(0)))>;
+    static_assert(std::is_trivially_copyable<T>::value, "Halo values are sent as raw bytes");
+
+    // x-face grids carry one extra layer above the owned cells that belongs to the upper neighbour
+    int extraLayer = grid.size()[0] - myLocalSize[0];
+    assert(extraLayer == 0 || extraLayer == 1);
+    assert(grid.size()[1] == myLocalSize[1] || grid.size()[1] == myLocalSize[1] + 1);
+
+    int lowerGhostCount = std::min(myGhostWidth, layerCount);
+    int upperGhostCount = std::min(myGhostWidth + extraLayer, layerCount);
+
+    std::vector<T> sendBuffer, receiveBuffer;
+
+    // Send the top owned layers up and receive the lower ghost layers from below
+    {
+        int upperRank = hasUpperNeighbour() ? myRank + 1 : MPI_PROC_NULL;
+        int lowerRank = hasLowerNeighbour() ? myRank - 1 : MPI_PROC_NULL;
+
+        if (hasUpperNeighbour()) packLayers(grid, localOwnedEnd() - lowerGhostCount, lowerGhostCount, sendBuffer);
+        if (hasLowerNeighbour()) receiveBuffer.resize(lowerGhostCount * grid.size()[1] * grid.size()[2]);
+
+        MPI_Sendrecv(sendBuffer.data(), int(sendBuffer.size() * sizeof(T)), MPI_BYTE, upperRank, 0,
+                     receiveBuffer.data(), int(receiveBuffer.size() * sizeof(T)), MPI_BYTE, lowerRank, 0,
+                     myCommunicator, MPI_STATUS_IGNORE);
+
+        if (hasLowerNeighbour()) unpackLayers(grid, localOwnedBegin() - lowerGhostCount, lowerGhostCount, receiveBuffer);
+    }
+
+    sendBuffer.clear();
+    receiveBuffer.clear();
+
+    // Send the bottom owned layers down and receive the upper ghost layers from above
+    {
+        int upperRank = hasUpperNeighbour() ? myRank + 1 : MPI_PROC_NULL;
+        int lowerRank = hasLowerNeighbour() ? myRank - 1 : MPI_PROC_NULL;
+
+        if (hasLowerNeighbour()) packLayers(grid, localOwnedBegin(), upperGhostCount, sendBuffer);
+        if (hasUpperNeighbour()) receiveBuffer.resize(upperGhostCount * grid.size()[1] * grid.size()[2]);
+
+        MPI_Sendrecv(sendBuffer.data(), int(sendBuffer.size() * sizeof(T)), MPI_BYTE, lowerRank, 1,
+                     receiveBuffer.data(), int(receiveBuffer.size() * sizeof(T)), MPI_BYTE, upperRank, 1,
+                     myCommunicator, MPI_STATUS_IGNORE);
+
+        if (hasUpperNeighbour()) unpackLayers(grid, localOwnedEnd(), upperGhostCount, receiveBuffer);
+    }
+}
+
+template <typename Grid>
+void SlabDecomposition::gather(const Grid& localGrid, Grid& globalGrid) const
+{
+    using T = std::decay_t<decltype(localGrid(Vec3i(0)))>;
+    static_assert(std::is_trivially_copyable<T>::value, "Gathered values are sent as raw bytes");
+
+    int extraLayer = localGrid.size()[0] - myLocalSize[0];
+    assert(extraLayer == 0 || extraLayer == 1);
+
+    int layerSize = localGrid.size()[1] * localGrid.size()[2];
+
+    auto ownedLayerCount = [&](int rank) {
+        return ownedEnd(rank) - ownedBegin(rank) + (rank == myRankCount - 1 ? extraLayer : 0);
+    };
+
+    std::vector<T> sendBuffer;
+    packLayers(localGrid, localOwnedBegin(), ownedLayerCount(myRank), sendBuffer);
+
+    std::vector<int> byteCounts, byteOffsets;
+    std::vector<T> receiveBuffer;
+
+    if (isRoot())
+    {
+        assert(globalGrid.size()[0] == myGlobalSize[0] + extraLayer);
+        assert(globalGrid.size()[1] == localGrid.size()[1] && globalGrid.size()[2] == localGrid.size()[2]);
+
+        byteCounts.resize(myRankCount);
+        byteOffsets.resize(myRankCount);
+
+        for (int rank = 0; rank < myRankCount; ++rank)
+        {
+            byteCounts[rank] = ownedLayerCount(rank) * layerSize * sizeof(T);
+            byteOffsets[rank] = ownedBegin(rank) * layerSize * sizeof(T);
+        }
+
+        receiveBuffer.resize(globalGrid.size()[0] * layerSize);
+    }
+
+    MPI_Gatherv(sendBuffer.data(), int(sendBuffer.size() * sizeof(T)), MPI_BYTE, receiveBuffer.data(),
+                byteCounts.data(), byteOffsets.data(), MPI_BYTE, 0, myCommunicator);
+
+    if (isRoot()) unpackLayers(globalGrid, 0, globalGrid.size()[0], receiveBuffer);
+}
+
+}  // namespace FluidSim3D::Distributed
+
+#endif
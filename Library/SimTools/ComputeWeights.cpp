@@ -112,27 +112,27 @@ VectorGrid<float> computeGhostFluidWeights(const LevelSet& surface)
 
     for (int axis : {0, 1, 2})
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, ghostFluidWeights.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = ghostFluidWeights.grid(axis).unflatten(faceIndex);
-
-                                  Vec3i backwardCell = faceToCell(face, axis, 0);
-                                  Vec3i forwardCell = faceToCell(face, axis, 1);
-
-                                  if (backwardCell[axis] < 0 || forwardCell[axis] >= surface.size()[axis])
-                                      continue;
-                                  else
-                                  {
-                                      float phiBackward = surface(backwardCell);
-                                      float phiForward = surface(forwardCell);
-
-                                      if (phiBackward < 0 || phiForward < 0)
-                                          ghostFluidWeights(face, axis) = lengthFraction(phiBackward, phiForward);
-                                  }
-                              }
-                          });
+        parallelFor(KernelClass::LIGHT, 0, ghostFluidWeights.grid(axis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = ghostFluidWeights.grid(axis).unflatten(faceIndex);
+
+                            Vec3i backwardCell = faceToCell(face, axis, 0);
+                            Vec3i forwardCell = faceToCell(face, axis, 1);
+
+                            if (backwardCell[axis] < 0 || forwardCell[axis] >= surface.size()[axis])
+                                continue;
+                            else
+                            {
+                                float phiBackward = surface(backwardCell);
+                                float phiForward = surface(forwardCell);
+
+                                if (phiBackward < 0 || phiForward < 0)
+                                    ghostFluidWeights(face, axis) = lengthFraction(phiBackward, phiForward);
+                            }
+                        }
+                    });
     }
 
     return ghostFluidWeights;
@@ -145,16 +145,16 @@ VectorGrid<float> computeCutCellWeights(const LevelSet& surface, bool invertWeig
     ScalarGrid<float> nodeSampledSurface(surface.xform(), surface.size(), 0, ScalarGridSettings::SampleType::NODE);
 
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, nodeSampledSurface.voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
-                              {
-                                  Vec3i node = nodeSampledSurface.unflatten(sampleIndex);
-
-                                  Vec3f worldNodePoint = nodeSampledSurface.indexToWorld(Vec3f(node));
-                                  nodeSampledSurface(node) = surface.interp(worldNodePoint);
-                              }
-                          });
+        parallelFor(KernelClass::LIGHT, 0, nodeSampledSurface.voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
+                        {
+                            Vec3i node = nodeSampledSurface.unflatten(sampleIndex);
+
+                            Vec3f worldNodePoint = nodeSampledSurface.indexToWorld(Vec3f(node));
+                            nodeSampledSurface(node) = surface.interp(worldNodePoint);
+                        }
+                    });
     }
 
     for (int faceAxis : {0, 1, 2})
@@ -162,28 +162,28 @@ VectorGrid<float> computeCutCellWeights(const LevelSet& surface, bool invertWeig
         Vec3i faceSize = cutCellWeights.size(faceAxis);
         int totalFaceSamples = faceSize[0] * faceSize[1] * faceSize[2];
 
-        tbb::parallel_for(tbb::blocked_range<int>(0, totalFaceSamples, tbbHeavyGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = cutCellWeights.grid(faceAxis).unflatten(faceIndex);
+        parallelFor(KernelClass::HEAVY, 0, totalFaceSamples,
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = cutCellWeights.grid(faceAxis).unflatten(faceIndex);
 
-                                  std::array<float, 4> nodePhis;
+                            std::array<float, 4> nodePhis;
 
-                                  for (int nodeIndex = 0; nodeIndex < 4; ++nodeIndex)
-                                  {
-                                      Vec3i node = faceToNodeCCW(face, faceAxis, nodeIndex);
-                                      nodePhis[nodeIndex] = nodeSampledSurface(node);
-                                  }
+                            for (int nodeIndex = 0; nodeIndex < 4; ++nodeIndex)
+                            {
+                                Vec3i node = faceToNodeCCW(face, faceAxis, nodeIndex);
+                                nodePhis[nodeIndex] = nodeSampledSurface(node);
+                            }
 
-                                  float weight = fractionInside(nodePhis);
-                                  weight = Utilities::clamp(weight, float(0), float(1));
+                            float weight = fractionInside(nodePhis);
+                            weight = Utilities::clamp(weight, float(0), float(1));
 
-                                  if (invertWeights) weight = 1. - weight;
+                            if (invertWeights) weight = 1. - weight;
 
-                                  if (weight > 0) cutCellWeights(face, faceAxis) = weight;
-                              }
-                          });
+                            if (weight > 0) cutCellWeights(face, faceAxis) = weight;
+                        }
+                    });
     }
 
     return cutCellWeights;
@@ -201,33 +201,33 @@ void computeSupersampleVolumes(ScalarGrid<float>& volumes, const LevelSet& surfa
     float dx = 1. / float(samples);
     float sampleVolume = Utilities::cube(dx);
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, volumes.voxelCount(), tbbHeavyGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
-                          {
-                              Vec3i sampleCoord = volumes.unflatten(sampleIndex);
+    parallelFor(KernelClass::HEAVY, 0, volumes.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
+                    {
+                        Vec3i sampleCoord = volumes.unflatten(sampleIndex);
 
-                              if (surface.interp(volumes.indexToWorld(Vec3f(sampleCoord))) > 2. * surface.dx())
-                                  continue;
+                        if (surface.interp(volumes.indexToWorld(Vec3f(sampleCoord))) > 2. * surface.dx())
+                            continue;
 
-                              Vec3f start = Vec3f(sampleCoord) - Vec3f(.5 - .5 * dx);
-                              Vec3f end = Vec3f(sampleCoord) + Vec3f(.5);
+                        Vec3f start = Vec3f(sampleCoord) - Vec3f(.5 - .5 * dx);
+                        Vec3f end = Vec3f(sampleCoord) + Vec3f(.5);
 
-                              Vec3f sample;
-                              float insideMaterialCount = 0;
+                        Vec3f sample;
+                        float insideMaterialCount = 0;
 
-                              for (sample[0] = start[0]; sample[0] <= end[0]; sample[0] += dx)
-                                  for (sample[1] = start[1]; sample[1] <= end[1]; sample[1] += dx)
-                                      for (sample[2] = start[2]; sample[2] <= end[2]; sample[2] += dx)
-                                      {
-                                          Vec3f worldSamplePoint = volumes.indexToWorld(sample);
+                        for (sample[0] = start[0]; sample[0] <= end[0]; sample[0] += dx)
+                            for (sample[1] = start[1]; sample[1] <= end[1]; sample[1] += dx)
+                                for (sample[2] = start[2]; sample[2] <= end[2]; sample[2] += dx)
+                                {
+                                    Vec3f worldSamplePoint = volumes.indexToWorld(sample);
 
-                                          if (surface.interp(worldSamplePoint) <= 0.) ++insideMaterialCount;
-                                      }
+                                    if (surface.interp(worldSamplePoint) <= 0.) ++insideMaterialCount;
+                                }
 
-                              if (insideMaterialCount > 0) volumes(sampleCoord) = insideMaterialCount * sampleVolume;
-                          }
-                      });
+                        if (insideMaterialCount > 0) volumes(sampleCoord) = insideMaterialCount * sampleVolume;
+                    }
+                });
 }
 
 VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int samples)
@@ -241,8 +241,8 @@ VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int sa
 
     for (int axis : {0, 1, 2})
     {
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, volumes.grid(axis).voxelCount(), tbbHeavyGrainSize),
+        parallelFor(
+            KernelClass::HEAVY, 0, volumes.grid(axis).voxelCount(),
             [&](const tbb::blocked_range<int>& range) {
                 for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
                 {
@@ -272,4 +272,30 @@ VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int sa
 
     return volumes;
 }
+
+//
+// Overloads that run inside an execution context
+//
+
+VectorGrid<float> computeGhostFluidWeights(const LevelSet& surface, const ExecutionContext& context)
+{
+    return context.execute([&] { return computeGhostFluidWeights(surface); });
+}
+
+VectorGrid<float> computeCutCellWeights(const LevelSet& surface, bool invertWeights, const ExecutionContext& context)
+{
+    return context.execute([&] { return computeCutCellWeights(surface, invertWeights); });
+}
+
+void computeSupersampleVolumes(ScalarGrid<float>& volumes, const LevelSet& surface, int samples,
+                               const ExecutionContext& context)
+{
+    context.execute([&] { computeSupersampleVolumes(volumes, surface, samples); });
+}
+
+VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int samples, const ExecutionContext& context)
+{
+    return context.execute([&] { return computeSupersampledFaceVolumes(surface, samples); });
+}
+
 }  // namespace FluidSim3D::SimTools
\ No newline at end of file
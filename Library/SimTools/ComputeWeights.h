@@ -22,12 +22,17 @@ namespace FluidSim3D::SimTools
 using namespace SurfaceTrackers;
 
 VectorGrid<float> computeGhostFluidWeights(const LevelSet& surface);
+VectorGrid<float> computeGhostFluidWeights(const LevelSet& surface, const ExecutionContext& context);
 
 VectorGrid<float> computeCutCellWeights(const LevelSet& surface, bool invertWeights = false);
+VectorGrid<float> computeCutCellWeights(const LevelSet& surface, bool invertWeights, const ExecutionContext& context);
 
 void computeSupersampleVolumes(ScalarGrid<float>& volumes, const LevelSet& surface, int samples);
+void computeSupersampleVolumes(ScalarGrid<float>& volumes, const LevelSet& surface, int samples,
+                               const ExecutionContext& context);
 
 VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int samples);
+VectorGrid<float> computeSupersampledFaceVolumes(const LevelSet& surface, int samples, const ExecutionContext& context);
 
 }  // namespace FluidSim3D::SimTools
 
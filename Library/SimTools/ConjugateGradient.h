@@ -0,0 +1,467 @@
+#ifndef LIBRARY_CONJUGATE_GRADIENT_H
+#define LIBRARY_CONJUGATE_GRADIENT_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Sparse>
+
+#include "Timer.h"
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// ConjugateGradient.h
+//
+// Pipelined Jacobi preconditioned CG (Ghysels
+// and Vanroose). Standard CG needs two global
+// reductions per iteration, one before and one
+// after the residual update. The pipelined form
+// carries extra recurrences so that every dot
+// product of an iteration is taken in the same
+// sweep as the vector updates. An iteration is
+// still two passes over memory: the operator
+// application, which reduces nothing but ends in
+// a barrier, and the update sweep, which holds
+// the only reduction. Folding the operator into
+// the update sweep (n = Am is only needed an
+// entry at a time) was slower for the pressure
+// stencil on a single core so they stay apart.
+// It costs four more vectors and can lose a few
+// digits of the true residual, which is well
+// below the tolerances the solvers use.
+//
+// Operators provide apply(x, y), unknownCount()
+// and inverseDiagonal(index), which is zero on
+// any entry of the vector that isn't an unknown.
+// A standard CG taking any preconditioner is
+// also provided for the multigrid solves.
+//
+// SolverTolerance decides when any of the CG
+// solves stop: on the relative residual (as
+// Eigen does), on the largest residual entry,
+// which for pressure is the divergence left in
+// the worst cell, or on a time budget.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SimTools
+{
+using namespace Utilities;
+
+enum class ConjugateGradientVariant
+{
+    STANDARD,
+    PIPELINED
+};
+
+class SolverTolerance
+{
+public:
+    enum class Mode
+    {
+        // |r| <= tolerance * |b| in the 2-norm, the rule of Eigen's ConjugateGradient
+        RELATIVE_RESIDUAL,
+        // Every entry of r is within tolerance
+        MAX_RESIDUAL,
+        // MAX_RESIDUAL at tolerance times a reference taken from the previous step. The caller
+        // resolves it with relativeTo before solving.
+        RELATIVE_TO_PREVIOUS,
+        // The relative rule, but the solve also stops once the budget in seconds is spent
+        TIME_BUDGET
+    };
+
+    SolverTolerance() : myMode(Mode::RELATIVE_RESIDUAL), myTolerance(1E-3), myTimeBudget(0) {}
+
+    static SolverTolerance relativeResidual(double tolerance)
+    {
+        return SolverTolerance(Mode::RELATIVE_RESIDUAL, tolerance, 0);
+    }
+
+    static SolverTolerance maxResidual(double tolerance) { return SolverTolerance(Mode::MAX_RESIDUAL, tolerance, 0); }
+
+    static SolverTolerance relativeToPrevious(double fraction)
+    {
+        return SolverTolerance(Mode::RELATIVE_TO_PREVIOUS, fraction, 0);
+    }
+
+    static SolverTolerance timeBudget(double seconds, double tolerance = 1E-3)
+    {
+        return SolverTolerance(Mode::TIME_BUDGET, tolerance, seconds);
+    }
+
+    // Resolve a RELATIVE_TO_PREVIOUS rule. Without a reference yet it falls back to the default rule.
+    SolverTolerance relativeTo(double reference) const
+    {
+        assert(myMode == Mode::RELATIVE_TO_PREVIOUS);
+        return reference > 0 ? maxResidual(myTolerance * reference) : SolverTolerance();
+    }
+
+    // Rescale an absolute rule into the units of the residual. Relative rules are unit free.
+    SolverTolerance scaled(double scale) const
+    {
+        SolverTolerance scaledTolerance = *this;
+        if (myMode == Mode::MAX_RESIDUAL || myMode == Mode::RELATIVE_TO_PREVIOUS)
+            scaledTolerance.myTolerance *= scale;
+        return scaledTolerance;
+    }
+
+    Mode mode() const { return myMode; }
+    double tolerance() const { return myTolerance; }
+    double timeBudget() const { return myTimeBudget; }
+
+private:
+    SolverTolerance(Mode mode, double tolerance, double timeBudget)
+        : myMode(mode), myTolerance(tolerance), myTimeBudget(timeBudget)
+    {
+        assert(tolerance > 0 && timeBudget >= 0);
+    }
+
+    Mode myMode;
+    double myTolerance, myTimeBudget;
+};
+
+// Applies a SolverTolerance inside a CG loop. The loops track both the squared residual norm and
+// the largest residual entry.
+class ConvergenceTest
+{
+public:
+    ConvergenceTest(const SolverTolerance& tolerance, double rhsNorm2) : myTolerance(tolerance)
+    {
+        assert(tolerance.mode() != SolverTolerance::Mode::RELATIVE_TO_PREVIOUS);
+        myThreshold = tolerance.tolerance() * tolerance.tolerance() * rhsNorm2;
+    }
+
+    bool isConverged(double residualNorm2, double maxResidual) const
+    {
+        if (myTolerance.mode() == SolverTolerance::Mode::MAX_RESIDUAL)
+            return maxResidual <= myTolerance.tolerance();
+
+        return residualNorm2 < myThreshold;
+    }
+
+    // TIME_BUDGET solves stop here with a usable, if unconverged, solution
+    bool isOutOfTime()
+    {
+        return myTolerance.mode() == SolverTolerance::Mode::TIME_BUDGET && myTimer.stop() >= myTolerance.timeBudget();
+    }
+
+private:
+    const SolverTolerance& myTolerance;
+    double myThreshold;
+    Timer myTimer;
+};
+
+// A symmetric matrix in Eigen's default column-major layout. Column i holds the entries of row i so
+// the product is computed a row at a time in parallel.
+class SymmetricSparseOperator
+{
+public:
+    using SolveReal = double;
+    using Vector = Eigen::VectorXd;
+
+    explicit SymmetricSparseOperator(const Eigen::SparseMatrix<SolveReal>& matrix)
+        : myMatrix(matrix), myInverseDiagonals(Vector::Zero(matrix.cols()))
+    {
+        assert(matrix.rows() == matrix.cols() && matrix.isCompressed());
+
+        for (int column = 0; column < matrix.outerSize(); ++column)
+            for (Eigen::SparseMatrix<SolveReal>::InnerIterator it(matrix, column); it; ++it)
+            {
+                if (it.row() == column && it.value() != 0) myInverseDiagonals(column) = 1. / it.value();
+            }
+    }
+
+    void apply(const Vector& vector, Vector& product) const
+    {
+        const int* offsets = myMatrix.outerIndexPtr();
+        const int* columns = myMatrix.innerIndexPtr();
+        const SolveReal* values = myMatrix.valuePtr();
+
+        parallelFor(KernelClass::LIGHT, 0, int(myMatrix.cols()), [&](const tbb::blocked_range<int>& range) {
+            for (int row = range.begin(); row != range.end(); ++row)
+            {
+                SolveReal value = 0;
+                for (int entry = offsets[row]; entry < offsets[row + 1]; ++entry)
+                    value += values[entry] * vector[columns[entry]];
+
+                product[row] = value;
+            }
+        });
+    }
+
+    int unknownCount() const { return myMatrix.cols(); }
+
+    SolveReal inverseDiagonal(int index) const { return myInverseDiagonals(index); }
+
+private:
+    const Eigen::SparseMatrix<SolveReal>& myMatrix;
+    Vector myInverseDiagonals;
+};
+
+// Diagonal scaling by any operator's inverse diagonal
+template <typename Operator>
+class JacobiPreconditioner
+{
+public:
+    explicit JacobiPreconditioner(const Operator& matrix) : myMatrix(matrix) {}
+
+    template <typename Vector>
+    void apply(const Vector& residual, Vector& preconditioned) const
+    {
+        parallelFor(KernelClass::LIGHT, 0, int(residual.size()), [&](const tbb::blocked_range<int>& range) {
+            for (int index = range.begin(); index != range.end(); ++index)
+                preconditioned[index] = myMatrix.inverseDiagonal(index) * residual[index];
+        });
+    }
+
+private:
+    const Operator& myMatrix;
+};
+
+// Largest magnitude of any entry, reduced alongside a squared norm as (norm2, max)
+inline Vec2d joinNormAndMax(const Vec2d& x, const Vec2d& y) { return Vec2d(x[0] + y[0], std::max(x[1], y[1])); }
+
+// Standard CG with any symmetric positive definite preconditioner providing apply(residual, result).
+// solution holds the initial guess on entry. error is the final relative residual. Returns false if
+// it runs out of iterations before meeting the tolerance or the time budget.
+template <typename Operator, typename Preconditioner, typename Vector>
+bool solvePreconditionedConjugateGradient(const Operator& matrix, const Preconditioner& preconditioner,
+                                          const Vector& rhs, Vector& solution, const SolverTolerance& tolerance,
+                                          int& iterations, double& error)
+{
+    using SolveReal = double;
+
+    int vectorSize = rhs.size();
+    int maxIterations = 2 * matrix.unknownCount();
+
+    iterations = 0;
+    error = 0;
+
+    auto dot = [&](const Vector& vector0, const Vector& vector1) {
+        return parallelReduce(
+            KernelClass::LIGHT, 0, vectorSize, SolveReal(0),
+            [&](const tbb::blocked_range<int>& range, SolveReal partialDot) -> SolveReal {
+                for (int index = range.begin(); index != range.end(); ++index)
+                    partialDot += vector0[index] * vector1[index];
+                return partialDot;
+            },
+            [](SolveReal x, SolveReal y) -> SolveReal { return x + y; });
+    };
+
+    auto sweep = [&](const auto& body) {
+        parallelFor(KernelClass::LIGHT, 0, vectorSize, [&](const tbb::blocked_range<int>& range) {
+            for (int index = range.begin(); index != range.end(); ++index) body(index);
+        });
+    };
+
+    SolveReal rhsNorm2 = dot(rhs, rhs);
+
+    if (rhsNorm2 == 0)
+    {
+        sweep([&](int index) { solution[index] = 0; });
+        return true;
+    }
+
+    Vector residual = rhs, preconditioned = rhs, direction = rhs, matrixDirection = rhs;
+
+    matrix.apply(solution, residual);
+    sweep([&](int index) { residual[index] = rhs[index] - residual[index]; });
+
+    preconditioner.apply(residual, direction);
+
+    auto residualNormAndMax = [&] {
+        return parallelReduce(
+            KernelClass::LIGHT, 0, vectorSize, Vec2d(0),
+            [&](const tbb::blocked_range<int>& range, Vec2d partialNorms) -> Vec2d {
+                for (int index = range.begin(); index != range.end(); ++index)
+                {
+                    partialNorms[0] += residual[index] * residual[index];
+                    partialNorms[1] = std::max(partialNorms[1], SolveReal(std::fabs(residual[index])));
+                }
+                return partialNorms;
+            },
+            joinNormAndMax);
+    };
+
+    ConvergenceTest convergenceTest(tolerance, rhsNorm2);
+
+    Vec2d residualNorms = residualNormAndMax();
+    SolveReal absNew = dot(residual, direction);
+
+    bool isConverged = convergenceTest.isConverged(residualNorms[0], residualNorms[1]);
+
+    while (!isConverged && iterations < maxIterations && !convergenceTest.isOutOfTime())
+    {
+        matrix.apply(direction, matrixDirection);
+
+        SolveReal alpha = absNew / dot(direction, matrixDirection);
+
+        sweep([&](int index) {
+            solution[index] += alpha * direction[index];
+            residual[index] -= alpha * matrixDirection[index];
+        });
+
+        residualNorms = residualNormAndMax();
+        ++iterations;
+
+        isConverged = convergenceTest.isConverged(residualNorms[0], residualNorms[1]);
+        if (isConverged) break;
+
+        preconditioner.apply(residual, preconditioned);
+
+        SolveReal absOld = absNew;
+        absNew = dot(residual, preconditioned);
+
+        SolveReal beta = absNew / absOld;
+        sweep([&](int index) { direction[index] = preconditioned[index] + beta * direction[index]; });
+    }
+
+    error = std::sqrt(residualNorms[0] / rhsNorm2);
+
+    return isConverged || convergenceTest.isOutOfTime();
+}
+
+// solution holds the initial guess on entry. error is the final relative residual. Returns false if
+// it runs out of iterations or the recurrences break down before meeting the tolerance.
+template <typename Operator, typename Vector>
+bool solvePipelinedConjugateGradient(const Operator& matrix, const Vector& rhs, Vector& solution,
+                                     const SolverTolerance& tolerance, int& iterations, double& error)
+{
+    using SolveReal = double;
+
+    int vectorSize = rhs.size();
+    int maxIterations = 2 * matrix.unknownCount();
+
+    iterations = 0;
+    error = 0;
+
+    auto sweep = [&](const auto& body) {
+        parallelFor(KernelClass::LIGHT, 0, vectorSize, [&](const tbb::blocked_range<int>& range) {
+            for (int index = range.begin(); index != range.end(); ++index) body(index);
+        });
+    };
+
+    SolveReal rhsNorm2 = parallelReduce(
+        KernelClass::LIGHT, 0, vectorSize, SolveReal(0),
+        [&](const tbb::blocked_range<int>& range, SolveReal partialDot) -> SolveReal {
+            for (int index = range.begin(); index != range.end(); ++index) partialDot += rhs[index] * rhs[index];
+            return partialDot;
+        },
+        [](SolveReal x, SolveReal y) -> SolveReal { return x + y; });
+
+    if (rhsNorm2 == 0)
+    {
+        sweep([&](int index) { solution[index] = 0; });
+        return true;
+    }
+
+    // residual r, preconditioned residual u, w = Au, m = Mw, n = Am and the search direction p
+    // with its recurrences s = Ap, q = Ms and z = Aq
+    Vector r = rhs, u = rhs, w = rhs, m = rhs, n = rhs;
+    Vector p = rhs, s = rhs, q = rhs, z = rhs;
+
+    sweep([&](int index) { p[index] = s[index] = q[index] = z[index] = n[index] = 0; });
+
+    matrix.apply(solution, r);
+    sweep([&](int index) {
+        r[index] = rhs[index] - r[index];
+        u[index] = matrix.inverseDiagonal(index) * r[index];
+    });
+
+    matrix.apply(u, w);
+
+    // Dot products (r, u), (w, u) and (r, r), and the largest entry of r
+    auto reduceDots = [](const Vec4d& x, const Vec4d& y) -> Vec4d {
+        return Vec4d(x[0] + y[0], x[1] + y[1], x[2] + y[2], std::max(x[3], y[3]));
+    };
+
+    Vec4d dots = parallelReduce(
+        KernelClass::LIGHT, 0, vectorSize, Vec4d(0),
+        [&](const tbb::blocked_range<int>& range, Vec4d partialDots) -> Vec4d {
+            for (int index = range.begin(); index != range.end(); ++index)
+            {
+                m[index] = matrix.inverseDiagonal(index) * w[index];
+
+                partialDots[0] += r[index] * u[index];
+                partialDots[1] += w[index] * u[index];
+                partialDots[2] += r[index] * r[index];
+                partialDots[3] = std::max(partialDots[3], SolveReal(std::fabs(r[index])));
+            }
+            return partialDots;
+        },
+        reduceDots);
+
+    ConvergenceTest convergenceTest(tolerance, rhsNorm2);
+
+    SolveReal oldGamma = 0, oldAlpha = 0;
+
+    bool isConverged = convergenceTest.isConverged(dots[2], dots[3]);
+
+    while (!isConverged && iterations < maxIterations && !convergenceTest.isOutOfTime())
+    {
+        // A separate sweep without a reduction
+        matrix.apply(m, n);
+
+        SolveReal gamma = dots[0];
+        SolveReal delta = dots[1];
+
+        SolveReal beta = 0, alpha;
+
+        if (iterations == 0)
+            alpha = gamma / delta;
+        else
+        {
+            beta = gamma / oldGamma;
+
+            SolveReal denominator = delta - beta * gamma / oldAlpha;
+            if (!(denominator > 0)) break;
+
+            alpha = gamma / denominator;
+        }
+
+        // Every update and the next iteration's dot products in one sweep with the iteration's only join
+        dots = parallelReduce(
+            KernelClass::LIGHT, 0, vectorSize, Vec4d(0),
+            [&](const tbb::blocked_range<int>& range, Vec4d partialDots) -> Vec4d {
+                for (int index = range.begin(); index != range.end(); ++index)
+                {
+                    z[index] = n[index] + beta * z[index];
+                    q[index] = m[index] + beta * q[index];
+                    s[index] = w[index] + beta * s[index];
+                    p[index] = u[index] + beta * p[index];
+
+                    solution[index] += alpha * p[index];
+                    r[index] -= alpha * s[index];
+                    u[index] -= alpha * q[index];
+                    w[index] -= alpha * z[index];
+
+                    m[index] = matrix.inverseDiagonal(index) * w[index];
+
+                    partialDots[0] += r[index] * u[index];
+                    partialDots[1] += w[index] * u[index];
+                    partialDots[2] += r[index] * r[index];
+                    partialDots[3] = std::max(partialDots[3], SolveReal(std::fabs(r[index])));
+                }
+                return partialDots;
+            },
+            reduceDots);
+
+        oldGamma = gamma;
+        oldAlpha = alpha;
+
+        ++iterations;
+
+        isConverged = convergenceTest.isConverged(dots[2], dots[3]);
+    }
+
+    error = std::sqrt(dots[2] / rhsNorm2);
+
+    return isConverged || convergenceTest.isOutOfTime();
+}
+
+}  // namespace FluidSim3D::SimTools
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef LIBRARY_EXTRAPOLATE_FIELD_H
 #define LIBRARY_EXTRAPOLATE_FIELD_H
 
+#include "PackedLabelGrid.h"
 #include "UniformGrid.h"
 #include "Utilities.h"
 #include "VectorGrid.h"
@@ -19,6 +20,10 @@
 // based on which boundary locations
 // are inserted into the queue first.
 //
+// The mask is a bit grid with finished cells
+// set. It's taken by value and grows as the
+// layers are filled in. Callers that are done
+// with the mask can move it in to skip the copy.
 //
 ////////////////////////////////////
 
@@ -27,7 +32,7 @@ namespace FluidSim3D::SimTools
 using namespace Utilities;
 
 template <typename Field>
-void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellMask, int bandwidth)
+void extrapolateField(Field& field, BitMaskGrid finishedCellMask, int bandwidth)
 {
     assert(bandwidth > 0);
     assert(field.size() == finishedCellMask.size());
@@ -38,29 +43,26 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
 
     tbb::enumerable_thread_specific<std::vector<Vec3i>> parallelToVisitCells;
 
-    tbb::parallel_for(
-        tbb::blocked_range<int>(0, finishedCellMask.voxelCount(), tbbLightGrainSize),
+    // Words without a finished cell are skipped whole
+    parallelFor(
+        KernelClass::LIGHT, 0, finishedCellMask.wordCount(),
         [&](const tbb::blocked_range<int>& range) {
             auto& localToVisitCells = parallelToVisitCells.local();
-            for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-            {
+
+            // Load up adjacent unfinished cells
+            finishedCellMask.forEachVoxel(true, range.begin(), range.end(), [&](int cellIndex) {
                 Vec3i cell = finishedCellMask.unflatten(cellIndex);
 
-                // Load up adjacent unfinished cells
-                if (finishedCellMask(cell) == VisitedCellLabels::FINISHED_CELL)
-                {
-                    for (int axis : {0, 1, 2})
-                        for (int direction : {0, 1})
-                        {
-                            Vec3i adjacentCell = cellToCell(cell, axis, direction);
+                for (int axis : {0, 1, 2})
+                    for (int direction : {0, 1})
+                    {
+                        Vec3i adjacentCell = cellToCell(cell, axis, direction);
 
-                            if (adjacentCell[axis] < 0 || adjacentCell[axis] >= finishedCellMask.size()[axis]) continue;
+                        if (adjacentCell[axis] < 0 || adjacentCell[axis] >= finishedCellMask.size()[axis]) continue;
 
-                            if (finishedCellMask(adjacentCell) != VisitedCellLabels::FINISHED_CELL)
-                                localToVisitCells.push_back(adjacentCell);
-                        }
-                }
-            }
+                        if (!finishedCellMask(adjacentCell)) localToVisitCells.push_back(adjacentCell);
+                    }
+            });
         });
 
     mergeLocalThreadVectors(toVisitCells, parallelToVisitCells);
@@ -84,8 +86,8 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
         tbb::parallel_sort(toVisitCells.begin(), toVisitCells.end(), vecCompare);
 
         // Compute values from adjacent finished cells
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, toVisitCells.size(), tbbLightGrainSize),
+        parallelFor(
+            KernelClass::LIGHT, 0, toVisitCells.size(),
             [&](const tbb::blocked_range<int>& range) {
                 // Because the list could contain duplicates, we need to advance forward through possible duplicates
                 int cellIndex = range.begin();
@@ -106,7 +108,7 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
 
                     oldCell = cell;
 
-                    assert(finishedCellMask(cell) != VisitedCellLabels::FINISHED_CELL);
+                    assert(!finishedCellMask(cell));
 
                     // TODO: get template type from field instead of assuming float is valid
                     float accumulatedValue = 0;
@@ -119,7 +121,7 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
 
                             if (adjacentCell[axis] < 0 || adjacentCell[axis] >= finishedCellMask.size()[axis]) continue;
 
-                            if (finishedCellMask(adjacentCell) == VisitedCellLabels::FINISHED_CELL)
+                            if (finishedCellMask(adjacentCell))
                             {
                                 accumulatedValue += field(adjacentCell);
                                 ++accumulatedCount;
@@ -132,31 +134,30 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
                 }
             });
 
-        // Set visited cells to finished
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, toVisitCells.size(), tbbLightGrainSize),
+        // Set visited cells to finished. The sorted list is in flattened order so cells that share a word of the
+        // mask are neighbours in it. Each range starts past the words it shares with the previous range and runs
+        // on to the end of its last word, so no word is written by two tasks.
+        auto maskWord = [&](int cellIndex) {
+            return finishedCellMask.wordIndex(finishedCellMask.flatten(toVisitCells[cellIndex]));
+        };
+
+        parallelFor(
+            KernelClass::LIGHT, 0, toVisitCells.size(),
             [&](const tbb::blocked_range<int>& range) {
-                // Because the list could contain duplicates, we need to advance forward through possible duplicates
                 int cellIndex = range.begin();
 
                 if (cellIndex > 0)
                 {
-                    while (cellIndex < toVisitCells.size() && toVisitCells[cellIndex] == toVisitCells[cellIndex - 1])
+                    while (cellIndex < toVisitCells.size() && maskWord(cellIndex) == maskWord(cellIndex - 1))
                         ++cellIndex;
                 }
 
-                Vec3i oldCell(-1);
-
-                for (; cellIndex < range.end(); ++cellIndex)
+                for (; cellIndex < toVisitCells.size(); ++cellIndex)
                 {
-                    Vec3i cell = toVisitCells[cellIndex];
-
-                    if (cell == oldCell) continue;
+                    if (cellIndex >= range.end() && maskWord(cellIndex) != maskWord(cellIndex - 1)) break;
 
-                    oldCell = cell;
-
-                    assert(finishedCellMask(cell) != VisitedCellLabels::FINISHED_CELL);
-                    finishedCellMask(cell) = VisitedCellLabels::FINISHED_CELL;
+                    // Duplicates are set twice
+                    finishedCellMask.set(toVisitCells[cellIndex], true);
                 }
             });
 
@@ -165,8 +166,8 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
         {
             parallelToVisitCells.clear();
 
-            tbb::parallel_for(
-                tbb::blocked_range<int>(0, toVisitCells.size(), tbbLightGrainSize),
+            parallelFor(
+                KernelClass::LIGHT, 0, toVisitCells.size(),
                 [&](const tbb::blocked_range<int>& range) {
                     auto& localToVisitCells = parallelToVisitCells.local();
 
@@ -190,7 +191,7 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
 
                         oldCell = cell;
 
-                        assert(finishedCellMask(cell) == VisitedCellLabels::FINISHED_CELL);
+                        assert(finishedCellMask(cell));
 
                         for (int axis : {0, 1, 2})
                             for (int direction : {0, 1})
@@ -200,8 +201,7 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
                                 if (adjacentCell[axis] < 0 || adjacentCell[axis] >= finishedCellMask.size()[axis])
                                     continue;
 
-                                if (finishedCellMask(adjacentCell) != VisitedCellLabels::FINISHED_CELL)
-                                    localToVisitCells.push_back(adjacentCell);
+                                if (!finishedCellMask(adjacentCell)) localToVisitCells.push_back(adjacentCell);
                             }
                     }
                 });
@@ -212,5 +212,11 @@ void extrapolateField(Field& field, UniformGrid<VisitedCellLabels> finishedCellM
     }
 }
 
+template <typename Field>
+void extrapolateField(Field& field, BitMaskGrid finishedCellMask, int bandwidth, const ExecutionContext& context)
+{
+    context.execute([&] { extrapolateField(field, std::move(finishedCellMask), bandwidth); });
+}
+
 }  // namespace FluidSim3D::SimTools
 #endif
\ No newline at end of file
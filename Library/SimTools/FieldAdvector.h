@@ -29,18 +29,25 @@ void advectField(float dt, Field& destinationField, const Field& sourceField, co
 {
     assert(&destinationField != &sourceField);
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, sourceField.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = sourceField.unflatten(cellIndex);
-
-                              Vec3f worldPoint = sourceField.indexToWorld(Vec3f(cell));
-                              worldPoint = Integrator(-dt, worldPoint, velocity, order);
-
-                              destinationField(cell) = sourceField.interp(worldPoint);
-                          }
-                      });
+    parallelFor(KernelClass::LIGHT, 0, sourceField.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = sourceField.unflatten(cellIndex);
+
+                        Vec3f worldPoint = sourceField.indexToWorld(Vec3f(cell));
+                        worldPoint = Integrator(-dt, worldPoint, velocity, order);
+
+                        destinationField(cell) = sourceField.interp(worldPoint);
+                    }
+                });
+}
+
+template <typename Field, typename VelocityField>
+void advectField(float dt, Field& destinationField, const Field& sourceField, const VelocityField& velocity,
+                 IntegrationOrder order, const ExecutionContext& context)
+{
+    context.execute([&] { advectField(dt, destinationField, sourceField, velocity, order); });
 }
 
 }  // namespace FluidSim3D::SimTools
@@ -1,9 +1,16 @@
 #include "PressureProjection.h"
 
-#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <numeric>
+
+#include <Eigen/Core>
 
 #include "LevelSet.h"
+#include "PressureStencil.h"
+#include "SparseMatrixAssembly.h"
 #include "tbb/tbb.h"
 
 namespace FluidSim3D::SimTools
@@ -16,7 +23,14 @@ PressureProjection::PressureProjection(const LevelSet& surface, const VectorGrid
       myGhostFluidWeights(ghostFluidWeights),
       mySolidVelocity(solidVelocity),
       myUseInitialGuessPressure(false),
-      myInitialGuessPressure(nullptr)
+      myInitialGuessPressure(nullptr),
+      myUseTallCells(false),
+      myTallCellBand(4),
+      myUseMatrixFreeSolve(false),
+      myConjugateGradientVariant(ConjugateGradientVariant::STANDARD),
+      mySolverIterations(0),
+      myInitialMaxDivergence(0),
+      myMaxDivergence(0)
 {
     // For efficiency sake, this should only take in velocity on a staggered grid
     // that matches the center sampled surface and collision
@@ -38,8 +52,29 @@ PressureProjection::PressureProjection(const LevelSet& surface, const VectorGrid
     assert(solidVelocity.isGridMatched(cutCellWeights) && solidVelocity.isGridMatched(ghostFluidWeights));
 
     myPressure = ScalarGrid<float>(surface.xform(), surface.size(), 0);
-    myValidFaces = VectorGrid<VisitedCellLabels>(surface.xform(), surface.size(), VisitedCellLabels::UNVISITED_CELL,
-                                                 VectorGridSettings::SampleType::STAGGERED);
+    for (int axis : {0, 1, 2}) myValidFaces[axis].resize(solidVelocity.size(axis));
+}
+
+PressureProjection::SolveReal PressureProjection::cellInflow(const Vec3i& cell,
+                                                            const VectorGrid<float>& velocity) const
+{
+    SolveReal divergence = 0;
+
+    for (int axis : {0, 1, 2})
+        for (int direction : {0, 1})
+        {
+            Vec3i face = cellToFace(cell, axis, direction);
+
+            SolveReal weight = myCutCellWeights(face, axis);
+
+            SolveReal sign = (direction == 0) ? 1 : -1;
+
+            // Add divergence from faces
+            if (weight > 0) divergence += sign * weight * velocity(face, axis);
+            if (weight < 1.) divergence += sign * (1. - weight) * mySolidVelocity(face, axis);
+        }
+
+    return divergence;
 }
 
 void PressureProjection::project(VectorGrid<float>& velocity)
@@ -53,37 +88,22 @@ void PressureProjection::project(VectorGrid<float>& velocity)
         LIQUID_CELL
     };
 
-    UniformGrid<MaterialLabels> materialCellLabels(mySurface.size(), MaterialLabels::SOLID_CELL);
-
-    tbb::parallel_for(tbb::blocked_range<int>(0, materialCellLabels.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = materialCellLabels.unflatten(cellIndex);
-
-                              bool isFluidCell = false;
-
-                              for (int axis = 0; axis < 3 && !isFluidCell; ++axis)
-                                  for (int direction : {0, 1})
-                                  {
-                                      Vec3i face = cellToFace(cell, axis, direction);
-
-                                      if (myCutCellWeights(face, axis) > 0)
-                                      {
-                                          isFluidCell = true;
-                                          break;
-                                      }
-                                  }
-
-                              if (isFluidCell)
-                              {
-                                  if (mySurface(cell) <= 0)
-                                      materialCellLabels(cell) = MaterialLabels::LIQUID_CELL;
-                                  else
-                                      materialCellLabels(cell) = MaterialLabels::AIR_CELL;
-                              }
-                          }
-                      });
+    PackedLabelGrid<MaterialLabels, 2> materialCellLabels(mySurface.size());
+
+    materialCellLabels.assign([&](int cellIndex) {
+        Vec3i cell = materialCellLabels.unflatten(cellIndex);
+
+        for (int axis : {0, 1, 2})
+            for (int direction : {0, 1})
+            {
+                Vec3i face = cellToFace(cell, axis, direction);
+
+                if (myCutCellWeights(face, axis) > 0)
+                    return mySurface(cell) <= 0 ? MaterialLabels::LIQUID_CELL : MaterialLabels::AIR_CELL;
+            }
+
+        return MaterialLabels::SOLID_CELL;
+    });
 
     constexpr int UNLABELLED_CELL = -1;
 
@@ -98,12 +118,56 @@ void PressureProjection::project(VectorGrid<float>& velocity)
     Vector rhsVector = Vector::Zero(liquidCellCount);
     Vector initialGuessVector = Vector::Zero(liquidCellCount);
 
-    tbb::enumerable_thread_specific<std::vector<Eigen::Triplet<SolveReal>>> parallelSparseMatrixElements;
+    // The matrix-free solve only needs the diagonal. Tall cells assemble their reduced system from the
+    // diagonal and the face weights so they don't need the fine matrix either.
+    bool useMatrixFree = myUseMatrixFreeSolve && !myUseTallCells;
+    bool assembleFineMatrix = !myUseMatrixFreeSolve && !myUseTallCells;
+
+    Vector diagonalVector;
+    if (!assembleFineMatrix) diagonalVector = Vector::Zero(liquidCellCount);
+
+    Eigen::SparseMatrix<SolveReal> sparseMatrix;
+
+    if (assembleFineMatrix)
+    {
+        // Count the entries of each row: the diagonal and every coupled liquid neighbour
+        std::vector<int> rowCounts(liquidCellCount);
 
-    tbb::parallel_for(
-        tbb::blocked_range<int>(0, liquidCellIndices.voxelCount(), tbbLightGrainSize),
+        parallelFor(KernelClass::LIGHT, 0, liquidCellIndices.voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                        {
+                            Vec3i cell = liquidCellIndices.unflatten(cellIndex);
+
+                            int liquidIndex = liquidCellIndices(cell);
+                            if (liquidIndex < 0) continue;
+
+                            int rowCount = 1;
+
+                            for (int axis : {0, 1, 2})
+                                for (int direction : {0, 1})
+                                {
+                                    Vec3i adjacentCell = cellToCell(cell, axis, direction);
+
+                                    if (adjacentCell[axis] < 0 || adjacentCell[axis] >= mySurface.size()[axis])
+                                        continue;
+
+                                    if (myCutCellWeights(cellToFace(cell, axis, direction), axis) > 0 &&
+                                        liquidCellIndices(adjacentCell) >= 0)
+                                        ++rowCount;
+                                }
+
+                            rowCounts[liquidIndex] = rowCount;
+                        }
+                    });
+
+        allocateSparseRows(sparseMatrix, rowCounts);
+    }
+
+    parallelFor(
+        KernelClass::LIGHT, 0, liquidCellIndices.voxelCount(),
         [&](const tbb::blocked_range<int>& range) {
-            auto& localSparseMatrixElements = parallelSparseMatrixElements.local();
+            SparseRowAccumulator<SolveReal, 7> rowEntries;
 
             for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
             {
@@ -116,25 +180,10 @@ void PressureProjection::project(VectorGrid<float>& velocity)
                     assert(materialCellLabels(cell) == MaterialLabels::LIQUID_CELL);
 
                     // Compute divergence to add to RHS
-                    SolveReal divergence = 0;
-
-                    for (int axis : {0, 1, 2})
-                        for (int direction : {0, 1})
-                        {
-                            Vec3i face = cellToFace(cell, axis, direction);
-
-                            SolveReal weight = myCutCellWeights(face, axis);
-
-                            SolveReal sign = (direction == 0) ? 1 : -1;
-
-                            // Add divergence from faces
-                            if (weight > 0) divergence += sign * weight * velocity(face, axis);
-                            if (weight < 1.) divergence += sign * (1. - weight) * mySolidVelocity(face, axis);
-                        }
-
-                    rhsVector(liquidIndex) = divergence;
+                    rhsVector(liquidIndex) = cellInflow(cell, velocity);
 
                     SolveReal diagonal = 0;
+                    rowEntries.clear();
 
                     for (int axis : {0, 1, 2})
                         for (int direction : {0, 1})
@@ -155,7 +204,7 @@ void PressureProjection::project(VectorGrid<float>& velocity)
                                 {
                                     assert(materialCellLabels(adjacentCell) == MaterialLabels::LIQUID_CELL);
 
-                                    localSparseMatrixElements.emplace_back(liquidIndex, adjacentLiquidIndex, -weight);
+                                    rowEntries.add(adjacentLiquidIndex, -weight);
                                     diagonal += weight;
                                 }
                                 else
@@ -173,12 +222,21 @@ void PressureProjection::project(VectorGrid<float>& velocity)
                         }
 
                     assert(diagonal > 0);
-                    localSparseMatrixElements.emplace_back(liquidIndex, liquidIndex, diagonal);
+
+                    if (!assembleFineMatrix)
+                        diagonalVector(liquidIndex) = diagonal;
+                    else
+                    {
+                        rowEntries.add(liquidIndex, diagonal);
+                        writeSparseRow(sparseMatrix, liquidIndex, rowEntries);
+                    }
 
                     if (myUseInitialGuessPressure)
                     {
                         assert(myInitialGuessPressure != nullptr);
-                        initialGuessVector(liquidIndex) = (*myInitialGuessPressure)(cell);
+                        // Pressures past the half range are stored as infinite and make no useful guess
+                        float guess = (*myInitialGuessPressure)(cell);
+                        initialGuessVector(liquidIndex) = std::isfinite(guess) ? guess : 0;
                     }
                 }
                 else
@@ -186,124 +244,838 @@ void PressureProjection::project(VectorGrid<float>& velocity)
             }
         });
 
-    std::vector<Eigen::Triplet<SolveReal>> sparseMatrixElements;
-    mergeLocalThreadVectors(sparseMatrixElements, parallelSparseMatrixElements);
+    // The surface and weights are fixed for the projection so the components only have to be labelled once,
+    // even when projecting again after viscosity
+    if (myLiquidComponents.empty() && liquidCellCount > 0) labelLiquidComponents(liquidCellIndices, liquidCellCount);
+
+    assert(int(myLiquidComponents.size()) == liquidCellCount);
+
+    const std::vector<int>& liquidComponents = myLiquidComponents;
+    const std::vector<bool>& componentHasAir = myComponentHasAir;
+
+    myInitialMaxDivergence = liquidCellCount > 0 ? rhsVector.cwiseAbs().maxCoeff() / mySurface.dx() : 0;
+
+    Vector solutionVector;
+
+    if (myUseTallCells)
+    {
+        // A liquid cell has to stay fine if it's near air, a solid or a partial face. Air seeds are dilated
+        // by the surface band along every axis. Solid seeds only need the band vertically since a column
+        // running alongside a wall is still resolved horizontally, so they get a single ring across.
+        enum FineSeed
+        {
+            COARSE,
+            SOLID_SEED,
+            SURFACE_SEED
+        };
+
+        UniformGrid<int> isFineCell(mySurface.size(), COARSE);
+
+        parallelFor(KernelClass::LIGHT, 0, isFineCell.voxelCount(), [&](const tbb::blocked_range<int>& range) {
+            for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+            {
+                Vec3i cell = isFineCell.unflatten(cellIndex);
+
+                if (materialCellLabels(cell) == MaterialLabels::AIR_CELL)
+                {
+                    isFineCell(cell) = SURFACE_SEED;
+                    continue;
+                }
+                else if (materialCellLabels(cell) == MaterialLabels::SOLID_CELL)
+                    continue;
+
+                for (int axis : {0, 1, 2})
+                    for (int direction : {0, 1})
+                    {
+                        // The domain boundary is a grid-aligned wall so the stencil there is already exact
+                        Vec3i adjacentCell = cellToCell(cell, axis, direction);
+                        if (adjacentCell[axis] < 0 || adjacentCell[axis] >= mySurface.size()[axis]) continue;
+
+                        if (materialCellLabels(adjacentCell) == MaterialLabels::AIR_CELL)
+                            isFineCell(cell) = SURFACE_SEED;
+                        else if (materialCellLabels(adjacentCell) == MaterialLabels::SOLID_CELL ||
+                                 myCutCellWeights(cellToFace(cell, axis, direction), axis) < 1)
+                            isFineCell(cell) = std::max(isFineCell(cell), int(SOLID_SEED));
+                    }
+            }
+        });
+
+        // Dilate one axis at a time. Along each line of cells a forward and a backward sweep track the
+        // nearest seed of each kind, so the cost doesn't grow with the band.
+        UniformGrid<int> dilatedCells(mySurface.size(), COARSE);
 
-    Eigen::SparseMatrix<SolveReal> sparseMatrix(liquidCellCount, liquidCellCount);
-    sparseMatrix.setFromTriplets(sparseMatrixElements.begin(), sparseMatrixElements.end());
+        for (int axis : {0, 1, 2})
+        {
+            int solidRadius = axis == 1 ? myTallCellBand : 1;
+            int lineLength = mySurface.size()[axis];
+
+            Vec3i lineCounts = mySurface.size();
+            lineCounts[axis] = 1;
+
+            auto dilatedSeed = [&](int surfaceDistance, int solidDistance) {
+                if (surfaceDistance <= myTallCellBand) return int(SURFACE_SEED);
+                return solidDistance <= solidRadius ? int(SOLID_SEED) : int(COARSE);
+            };
+
+            parallelFor(KernelClass::LIGHT, 0, lineCounts[0] * lineCounts[1] * lineCounts[2],
+                        [&](const tbb::blocked_range<int>& range) {
+                            for (int lineIndex = range.begin(); lineIndex != range.end(); ++lineIndex)
+                            {
+                                Vec3i cell(lineIndex / (lineCounts[1] * lineCounts[2]),
+                                           (lineIndex / lineCounts[2]) % lineCounts[1], lineIndex % lineCounts[2]);
+
+                                // Any seed counts for the solid radius since surface seeds reach at least as far
+                                int lastSurface = -myTallCellBand - 1, lastSeed = -myTallCellBand - 1;
+
+                                for (cell[axis] = 0; cell[axis] < lineLength; ++cell[axis])
+                                {
+                                    int seed = isFineCell(cell);
+                                    if (seed == SURFACE_SEED) lastSurface = cell[axis];
+                                    if (seed != COARSE) lastSeed = cell[axis];
+
+                                    dilatedCells(cell) = dilatedSeed(cell[axis] - lastSurface, cell[axis] - lastSeed);
+                                }
+
+                                int nextSurface = lineLength + myTallCellBand, nextSeed = lineLength + myTallCellBand;
+
+                                for (cell[axis] = lineLength - 1; cell[axis] >= 0; --cell[axis])
+                                {
+                                    int seed = isFineCell(cell);
+                                    if (seed == SURFACE_SEED) nextSurface = cell[axis];
+                                    if (seed != COARSE) nextSeed = cell[axis];
+
+                                    int backwardSeed = dilatedSeed(nextSurface - cell[axis], nextSeed - cell[axis]);
+                                    dilatedCells(cell) = std::max(dilatedCells(cell), backwardSeed);
+                                }
+                            }
+                        });
+
+            std::swap(isFineCell, dilatedCells);
+        }
+
+        // Runs of at least three coarse liquid cells along y become tall cells. Solid cells end a run. Store the ends
+        // of the run for each cell in it.
+        UniformGrid<Vec2i> tallCellEnds(mySurface.size(), Vec2i(-1));
+
+        Vec3i size = mySurface.size();
+
+        parallelFor(KernelClass::LIGHT, 0, size[0] * size[2], [&](const tbb::blocked_range<int>& range) {
+            for (int columnIndex = range.begin(); columnIndex != range.end(); ++columnIndex)
+            {
+                int i = columnIndex / size[2];
+                int k = columnIndex % size[2];
+
+                int j = 0;
+                while (j < size[1])
+                {
+                    if (isFineCell(i, j, k) || liquidCellIndices(i, j, k) < 0)
+                    {
+                        ++j;
+                        continue;
+                    }
+
+                    int runStart = j;
+                    while (j < size[1] && !isFineCell(i, j, k) && liquidCellIndices(i, j, k) >= 0) ++j;
+
+                    if (j - runStart >= 3)
+                    {
+                        for (int runIndex = runStart; runIndex < j; ++runIndex)
+                            tallCellEnds(i, runIndex, k) = Vec2i(runStart, j - 1);
+                    }
+                }
+            }
+        });
+
+        // Number the remaining unknowns: every fine liquid cell and both ends of each tall cell
+        UniformGrid<int> coarseCellIndices(mySurface.size(), UNLABELLED_CELL);
+
+        std::vector<Vec3i> coarseCells;
+
+        forEachVoxelRange(Vec3i(0), coarseCellIndices.size(), [&](const Vec3i& cell) {
+            if (liquidCellIndices(cell) < 0) return;
+
+            const Vec2i& ends = tallCellEnds(cell);
+            if (ends[0] < 0 || cell[1] == ends[0] || cell[1] == ends[1])
+            {
+                coarseCellIndices(cell) = coarseCells.size();
+                coarseCells.push_back(cell);
+            }
+        });
+
+        int coarseCellCount = coarseCells.size();
+
+        // Each fine pressure is a linear combination of at most two unknowns: its own or the two ends of its
+        // tall cell.
+        auto forEachProlongationEntry = [&](const Vec3i& cell, auto&& visit) {
+            int coarseIndex = coarseCellIndices(cell);
+
+            if (coarseIndex >= 0)
+                visit(coarseIndex, SolveReal(1));
+            else
+            {
+                const Vec2i& ends = tallCellEnds(cell);
+
+                SolveReal topWeight = SolveReal(cell[1] - ends[0]) / SolveReal(ends[1] - ends[0]);
+
+                visit(coarseCellIndices(Vec3i(cell[0], ends[0], cell[2])), 1. - topWeight);
+                visit(coarseCellIndices(Vec3i(cell[0], ends[1], cell[2])), topWeight);
+            }
+        };
+
+        // Assemble the Galerkin system P^T A P straight from the fine stencil, one coarse row at a time. Row a
+        // sums P(i, a) A(i, j) P(j, b) over the fine cells i that unknown a covers and their stencil neighbours
+        // j. A tall cell end can couple to a whole neighbouring column so rows have no fixed width. Each row
+        // collects its contributions in its own slice of the thread's entries, then sorts the slice and merges
+        // repeated columns in place. The rows are copied into the matrix after.
+        std::vector<int> coarseRowCounts(coarseCellCount);
+        OrderedLocalThreadVectors<std::pair<int, SolveReal>> parallelCoarseEntries;
+
+        parallelFor(KernelClass::LIGHT, 0, coarseCellCount, [&](const tbb::blocked_range<int>& range) {
+            auto& localCoarseEntries = parallelCoarseEntries.local(range.begin());
+
+            for (int coarseIndex = range.begin(); coarseIndex != range.end(); ++coarseIndex)
+            {
+                int rowStart = localCoarseEntries.size();
+
+                auto addEntry = [&](int column, SolveReal value) { localCoarseEntries.emplace_back(column, value); };
+
+                auto addFineRow = [&](const Vec3i& cell, SolveReal rowWeight) {
+                    int liquidIndex = liquidCellIndices(cell);
+
+                    forEachProlongationEntry(cell, [&](int column, SolveReal columnWeight) {
+                        addEntry(column, rowWeight * diagonalVector(liquidIndex) * columnWeight);
+                    });
+
+                    for (int axis : {0, 1, 2})
+                        for (int direction : {0, 1})
+                        {
+                            Vec3i adjacentCell = cellToCell(cell, axis, direction);
+
+                            if (adjacentCell[axis] < 0 || adjacentCell[axis] >= mySurface.size()[axis]) continue;
+
+                            SolveReal weight = myCutCellWeights(cellToFace(cell, axis, direction), axis);
+
+                            if (weight <= 0 || liquidCellIndices(adjacentCell) < 0) continue;
+
+                            forEachProlongationEntry(adjacentCell, [&](int column, SolveReal columnWeight) {
+                                addEntry(column, -rowWeight * weight * columnWeight);
+                            });
+                        }
+                };
+
+                // A fine unknown covers its own cell. A tall cell end covers the whole tall cell, weighted by
+                // how much of each cell's pressure it carries.
+                const Vec3i& coarseCell = coarseCells[coarseIndex];
+                const Vec2i& ends = tallCellEnds(coarseCell);
+
+                if (ends[0] < 0)
+                    addFineRow(coarseCell, 1);
+                else
+                {
+                    bool isBottom = coarseCell[1] == ends[0];
+
+                    for (Vec3i cell = Vec3i(coarseCell[0], ends[0], coarseCell[2]); cell[1] <= ends[1]; ++cell[1])
+                    {
+                        SolveReal topWeight = SolveReal(cell[1] - ends[0]) / SolveReal(ends[1] - ends[0]);
+                        SolveReal rowWeight = isBottom ? 1. - topWeight : topWeight;
+
+                        if (rowWeight > 0) addFineRow(cell, rowWeight);
+                    }
+                }
+
+                std::sort(localCoarseEntries.begin() + rowStart, localCoarseEntries.end(),
+                          [](const auto& x, const auto& y) { return x.first < y.first; });
+
+                // Merge repeated columns into the first entry of each run
+                int rowEnd = rowStart;
+                for (int entryIndex = rowStart; entryIndex < int(localCoarseEntries.size()); ++entryIndex)
+                {
+                    const auto& entry = localCoarseEntries[entryIndex];
+
+                    if (rowEnd > rowStart && localCoarseEntries[rowEnd - 1].first == entry.first)
+                        localCoarseEntries[rowEnd - 1].second += entry.second;
+                    else
+                        localCoarseEntries[rowEnd++] = entry;
+                }
+
+                localCoarseEntries.resize(rowEnd);
+
+                coarseRowCounts[coarseIndex] = rowEnd - rowStart;
+            }
+        });
+
+        std::vector<std::pair<int, SolveReal>> coarseEntries;
+        mergeLocalThreadVectors(coarseEntries, parallelCoarseEntries);
+
+        Eigen::SparseMatrix<SolveReal> coarseMatrix;
+        allocateSparseRows(coarseMatrix, coarseRowCounts);
+
+        parallelFor(KernelClass::LIGHT, 0, int(coarseEntries.size()), [&](const tbb::blocked_range<int>& range) {
+            for (int entryIndex = range.begin(); entryIndex != range.end(); ++entryIndex)
+            {
+                coarseMatrix.innerIndexPtr()[entryIndex] = coarseEntries[entryIndex].first;
+                coarseMatrix.valuePtr()[entryIndex] = coarseEntries[entryIndex].second;
+            }
+        });
+
+        // The right-hand side is restricted with the same weights and the initial guess is injected since
+        // the unknowns sit on liquid cells
+        Vector coarseRhsVector = Vector::Zero(coarseCellCount);
+        Vector coarseInitialGuessVector = Vector::Zero(coarseCellCount);
+
+        forEachVoxelRange(Vec3i(0), coarseCellIndices.size(), [&](const Vec3i& cell) {
+            int liquidIndex = liquidCellIndices(cell);
+            if (liquidIndex < 0) return;
+
+            forEachProlongationEntry(cell, [&](int coarseIndex, SolveReal weight) {
+                coarseRhsVector(coarseIndex) += weight * rhsVector(liquidIndex);
+            });
+
+            int coarseIndex = coarseCellIndices(cell);
+            if (coarseIndex >= 0) coarseInitialGuessVector(coarseIndex) = initialGuessVector(liquidIndex);
+        });
+
+        Vector coarseSolutionVector;
+        // A tall cell stays inside its column so the coarse unknowns inherit the fine components
+        std::vector<int> coarseComponents(coarseCellCount);
+
+        forEachVoxelRange(Vec3i(0), coarseCellIndices.size(), [&](const Vec3i& cell) {
+            int coarseIndex = coarseCellIndices(cell);
+            if (coarseIndex >= 0) coarseComponents[coarseIndex] = liquidComponents[liquidCellIndices(cell)];
+        });
+
+        if (!solveComponents(coarseMatrix, coarseRhsVector, coarseInitialGuessVector, coarseComponents,
+                             componentHasAir, coarseSolutionVector, mySolverIterations))
+            return;
+
+        solutionVector = Vector::Zero(liquidCellCount);
+
+        parallelFor(KernelClass::LIGHT, 0, liquidCellIndices.voxelCount(), [&](const tbb::blocked_range<int>& range) {
+            for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+            {
+                Vec3i cell = liquidCellIndices.unflatten(cellIndex);
+
+                int liquidIndex = liquidCellIndices(cell);
+                if (liquidIndex < 0) continue;
+
+                forEachProlongationEntry(cell, [&](int coarseIndex, SolveReal weight) {
+                    solutionVector(liquidIndex) += weight * coarseSolutionVector(coarseIndex);
+                });
+            }
+        });
+    }
+    else if (useMatrixFree)
+    {
+        // The stencil works on vectors over the liquid cells. Enclosed components get the same treatment
+        // as in solveComponents: the mean is removed from their right-hand side and their first cell is
+        // pinned by leaving it out of the unknowns.
+        int componentCount = componentHasAir.size();
+
+        std::vector<SolveReal> componentRhsMeans(componentCount, 0);
+        std::vector<int> componentSizes(componentCount, 0);
+        std::vector<int> pinnedIndices(componentCount, UNLABELLED_CELL);
+
+        for (int liquidIndex = 0; liquidIndex < liquidCellCount; ++liquidIndex)
+        {
+            int component = liquidComponents[liquidIndex];
+            if (componentHasAir[component]) continue;
+
+            componentRhsMeans[component] += rhsVector(liquidIndex);
+            ++componentSizes[component];
+            if (pinnedIndices[component] < 0) pinnedIndices[component] = liquidIndex;
+        }
+
+        for (int component = 0; component < componentCount; ++component)
+        {
+            if (componentSizes[component] > 0) componentRhsMeans[component] /= componentSizes[component];
+        }
+
+        std::vector<SolveReal> diagonals(liquidCellCount, 0);
+        std::vector<SolveReal> rhs(liquidCellCount, 0);
+        std::vector<SolveReal> solution(liquidCellCount, 0);
+
+        parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+            for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+            {
+                int component = liquidComponents[liquidIndex];
+                if (pinnedIndices[component] == liquidIndex) continue;
+
+                diagonals[liquidIndex] = diagonalVector(liquidIndex);
+                rhs[liquidIndex] = rhsVector(liquidIndex) - componentRhsMeans[component];
+                solution[liquidIndex] = initialGuessVector(liquidIndex);
+            }
+        });
+
+        PressureStencil stencil(myCutCellWeights, liquidCellIndices, std::move(diagonals));
+
+        int& iterations = mySolverIterations;
+        SolveReal error;
+
+        SolverTolerance residualTolerance = myTolerance.scaled(mySurface.dx());
+
+        bool isSolved = myConjugateGradientVariant == ConjugateGradientVariant::PIPELINED
+                            ? solvePipelinedConjugateGradient(stencil, rhs, solution, residualTolerance, iterations,
+                                                              error)
+                            : stencil.solve(rhs, solution, residualTolerance, iterations, error);
+
+        if (!isSolved)
+        {
+            std::cout << "   Solver failed to converge" << std::endl;
+            return;
+        }
+
+        std::cout << "    Solver iterations:     " << iterations << std::endl;
+        std::cout << "    Solver error: " << error << std::endl;
+
+        solutionVector = Eigen::Map<const Vector>(solution.data(), liquidCellCount);
+    }
+    else if (!solveComponents(sparseMatrix, rhsVector, initialGuessVector, liquidComponents, componentHasAir,
+                              solutionVector, mySolverIterations))
+        return;
+
+    // Copy resulting vector to pressure grid
+    parallelFor(KernelClass::LIGHT, 0, liquidCellIndices.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = liquidCellIndices.unflatten(cellIndex);
+
+                        int liquidIndex = liquidCellIndices(cell);
+
+                        if (liquidIndex >= 0)
+                        {
+                            assert(materialCellLabels(cell) == MaterialLabels::LIQUID_CELL);
+                            myPressure(cell) = solutionVector(liquidIndex);
+                        }
+                        else
+                            assert(materialCellLabels(cell) != MaterialLabels::LIQUID_CELL);
+                    }
+                });
+
+    // Build valid faces
+    for (int axis : {0, 1, 2})
+    {
+        BitMaskGrid& validFaces = myValidFaces[axis];
+
+        validFaces.assign([&](int faceIndex) {
+            Vec3i face = validFaces.unflatten(faceIndex);
+
+            if (myCutCellWeights(face, axis) > 0)
+            {
+                Vec3i backwardCell = faceToCell(face, axis, 0);
+                Vec3i forwardCell = faceToCell(face, axis, 1);
+
+                if (!(backwardCell[axis] < 0 || forwardCell[axis] >= mySurface.size()[axis]))
+                {
+                    if (liquidCellIndices(backwardCell) >= 0 || liquidCellIndices(forwardCell) >= 0)
+                    {
+                        assert(materialCellLabels(backwardCell) == MaterialLabels::LIQUID_CELL ||
+                               materialCellLabels(forwardCell) == MaterialLabels::LIQUID_CELL);
+
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        });
+    }
+
+    // Apply pressure update
+    for (int axis : {0, 1, 2})
+    {
+        const BitMaskGrid& validFaces = myValidFaces[axis];
+
+        validFaces.forEachVoxel(true, [&](int faceIndex) {
+            Vec3i face = validFaces.unflatten(faceIndex);
+
+            Vec3i backwardCell = faceToCell(face, axis, 0);
+            Vec3i forwardCell = faceToCell(face, axis, 1);
+
+            assert(myCutCellWeights(face, axis) > 0);
+            assert(backwardCell[axis] >= 0 && forwardCell[axis] <= mySurface.size()[axis]);
+            assert(materialCellLabels(backwardCell) == MaterialLabels::LIQUID_CELL ||
+                   materialCellLabels(forwardCell) == MaterialLabels::LIQUID_CELL);
+
+            SolveReal gradient = myPressure(forwardCell) - myPressure(backwardCell);
+
+            if (materialCellLabels(backwardCell) == MaterialLabels::AIR_CELL ||
+                materialCellLabels(forwardCell) == MaterialLabels::AIR_CELL)
+            {
+                SolveReal theta = myGhostFluidWeights(face, axis);
+                theta = Utilities::clamp(theta, SolveReal(.01), SolveReal(1));
+
+                gradient /= theta;
+            }
+
+            velocity(face, axis) -= gradient;
+        });
+    }
+
+    // The divergence actually left behind, which is what the tolerance aims at
+    myMaxDivergence = parallelReduce(
+        KernelClass::LIGHT, 0, liquidCellIndices.voxelCount(), SolveReal(0),
+        [&](const tbb::blocked_range<int>& range, SolveReal localMax) -> SolveReal {
+            for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+            {
+                Vec3i cell = liquidCellIndices.unflatten(cellIndex);
+                if (liquidCellIndices(cell) >= 0) localMax = std::max(localMax, std::fabs(cellInflow(cell, velocity)));
+            }
+            return localMax;
+        },
+        [](SolveReal x, SolveReal y) -> SolveReal { return std::max(x, y); }) / mySurface.dx();
+
+    std::cout << "    Max divergence: " << myInitialMaxDivergence << " before, " << myMaxDivergence << " after"
+              << std::endl;
+}
+
+bool PressureProjection::solveConjugateGradient(const Eigen::SparseMatrix<SolveReal>& matrix, const Vector& rhs,
+                                                const Vector& guess, Vector& solution, int& iterations,
+                                                SolveReal& error) const
+{
+    SolverTolerance residualTolerance = myTolerance.scaled(mySurface.dx());
+
+    // Eigen's solver only knows the relative rule
+    if (myConjugateGradientVariant == ConjugateGradientVariant::PIPELINED ||
+        residualTolerance.mode() != SolverTolerance::Mode::RELATIVE_RESIDUAL)
+    {
+        solution = guess;
+
+        SymmetricSparseOperator matrixOperator(matrix);
+
+        bool isSolved =
+            myConjugateGradientVariant == ConjugateGradientVariant::PIPELINED
+                ? solvePipelinedConjugateGradient(matrixOperator, rhs, solution, residualTolerance, iterations, error)
+                : solvePreconditionedConjugateGradient(matrixOperator, JacobiPreconditioner(matrixOperator), rhs,
+                                                       solution, residualTolerance, iterations, error);
+
+        if (!isSolved)
+        {
+            std::cout << "   Solver failed to converge" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
 
     Eigen::ConjugateGradient<Eigen::SparseMatrix<SolveReal>, Eigen::Upper | Eigen::Lower> solver;
-    solver.compute(sparseMatrix);
+    solver.compute(matrix);
 
     if (solver.info() != Eigen::Success)
     {
         std::cout << "   Solver failed to build" << std::endl;
-        return;
+        return false;
     }
 
-    solver.setTolerance(1E-3);
+    solver.setTolerance(residualTolerance.tolerance());
 
-    Vector solutionVector = solver.solveWithGuess(rhsVector, initialGuessVector);
+    solution = solver.solveWithGuess(rhs, guess);
 
     if (solver.info() != Eigen::Success)
     {
         std::cout << "   Solver failed to converge" << std::endl;
-        return;
+        return false;
+    }
+
+    iterations = solver.iterations();
+    error = solver.error();
+
+    return true;
+}
+
+void PressureProjection::labelLiquidComponents(const UniformGrid<int>& liquidCellIndices, int liquidCellCount)
+{
+    constexpr int UNLABELLED_CELL = -1;
+
+    // Union-find over the liquid cells. Roots are always linked under smaller roots so every set's root is its
+    // lowest index and the components come out numbered in grid order.
+    std::vector<std::atomic<int>> parents(liquidCellCount);
+
+    auto findRoot = [&parents](int index) {
+        while (true)
+        {
+            int parent = parents[index].load();
+            if (parent == index) return index;
+
+            // Path halving. The grandparent is still in the same set so losing the race is harmless.
+            int grandparent = parents[parent].load();
+            if (grandparent != parent) parents[index].compare_exchange_weak(parent, grandparent);
+
+            index = grandparent;
+        }
+    };
+
+    auto unite = [&](int index0, int index1) {
+        while (true)
+        {
+            index0 = findRoot(index0);
+            index1 = findRoot(index1);
+
+            if (index0 == index1) return;
+            if (index0 < index1) std::swap(index0, index1);
+
+            // Retry if another thread linked the root first
+            int expected = index0;
+            if (parents[index0].compare_exchange_strong(expected, index1)) return;
+        }
+    };
+
+    const Vec3i size = liquidCellIndices.size();
+    const int rowCount = size[0] * size[1];
+
+    auto rowCell = [&size](int row) { return Vec3i(row / size[1], row % size[1], 0); };
+
+    // Runs of connected cells along a z row start out joined to their first cell
+    parallelFor(KernelClass::HEAVY, 0, rowCount, [&](const tbb::blocked_range<int>& range) {
+        for (int row = range.begin(); row != range.end(); ++row)
+        {
+            Vec3i cell = rowCell(row);
+            const int* indices = &liquidCellIndices(cell);
+
+            int runStart = UNLABELLED_CELL;
+
+            for (cell[2] = 0; cell[2] < size[2]; ++cell[2])
+            {
+                int liquidIndex = indices[cell[2]];
+
+                if (liquidIndex < 0)
+                {
+                    runStart = UNLABELLED_CELL;
+                    continue;
+                }
+
+                if (runStart < 0 || myCutCellWeights(cellToFace(cell, 2, 0), 2) <= 0) runStart = liquidIndex;
+
+                parents[liquidIndex].store(runStart);
+            }
+        }
+    });
+
+    // Join the runs across x and y faces and find the cells that touch air
+    tbb::enumerable_thread_specific<std::vector<int>> parallelAirCells;
+
+    parallelFor(KernelClass::HEAVY, 0, rowCount, [&](const tbb::blocked_range<int>& range) {
+        auto& localAirCells = parallelAirCells.local();
+
+        for (int row = range.begin(); row != range.end(); ++row)
+        {
+            Vec3i cell = rowCell(row);
+            const int* indices = &liquidCellIndices(cell);
+
+            for (cell[2] = 0; cell[2] < size[2]; ++cell[2])
+            {
+                int liquidIndex = indices[cell[2]];
+                if (liquidIndex < 0) continue;
+
+                bool isAtAir = false;
+
+                for (int axis : {0, 1, 2})
+                    for (int direction : {0, 1})
+                    {
+                        Vec3i adjacentCell = cellToCell(cell, axis, direction);
+
+                        if (adjacentCell[axis] < 0 || adjacentCell[axis] >= size[axis]) continue;
+                        if (myCutCellWeights(cellToFace(cell, axis, direction), axis) <= 0) continue;
+
+                        int adjacentIndex = liquidCellIndices(adjacentCell);
+
+                        if (adjacentIndex < 0)
+                            isAtAir = true;
+                        else if (axis != 2 && direction == 0)
+                            unite(liquidIndex, adjacentIndex);
+                    }
+
+                if (isAtAir) localAirCells.push_back(liquidIndex);
+            }
+        }
+    });
+
+    // Every cell points at its root once all the unions are done. The roots are then numbered in order and
+    // the numbers are stored in the roots' parent slots.
+    myLiquidComponents.resize(liquidCellCount);
+
+    OrderedLocalThreadVectors<int> parallelRoots;
+
+    parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+        auto& localRoots = parallelRoots.local(range.begin());
+
+        for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+        {
+            int root = findRoot(liquidIndex);
+            myLiquidComponents[liquidIndex] = root;
+
+            if (root == liquidIndex) localRoots.push_back(root);
+        }
+    });
+
+    std::vector<int> roots;
+    mergeLocalThreadVectors(roots, parallelRoots);
+
+    parallelFor(KernelClass::LIGHT, 0, int(roots.size()), [&](const tbb::blocked_range<int>& range) {
+        for (int component = range.begin(); component != range.end(); ++component)
+            parents[roots[component]].store(component);
+    });
+
+    parallelFor(KernelClass::LIGHT, 0, liquidCellCount, [&](const tbb::blocked_range<int>& range) {
+        for (int liquidIndex = range.begin(); liquidIndex != range.end(); ++liquidIndex)
+            myLiquidComponents[liquidIndex] = parents[myLiquidComponents[liquidIndex]].load();
+    });
+
+    std::vector<int> airCells;
+    mergeLocalThreadVectors(airCells, parallelAirCells);
+
+    myComponentHasAir.assign(roots.size(), false);
+    for (int liquidIndex : airCells) myComponentHasAir[myLiquidComponents[liquidIndex]] = true;
+}
+
+bool PressureProjection::solveComponents(const Eigen::SparseMatrix<SolveReal>& matrix, const Vector& rhs,
+                                         const Vector& guess, const std::vector<int>& components,
+                                         const std::vector<bool>& componentHasAir, Vector& solution,
+                                         int& iterations) const
+{
+    // Components below this size are factored instead of iterated
+    constexpr int directSolveSize = 512;
+
+    int componentCount = componentHasAir.size();
+
+    // A single body with a free surface is the common case so it's solved in place
+    if (componentCount == 1 && componentHasAir[0])
+    {
+        SolveReal error;
+
+        if (!solveConjugateGradient(matrix, rhs, guess, solution, iterations, error)) return false;
+
+        std::cout << "    Solver iterations:     " << iterations << std::endl;
+        std::cout << "    Solver error: " << error << std::endl;
+
+        return true;
     }
-    else
+
+    iterations = 0;
+
+    int unknownCount = rhs.size();
+    assert(int(components.size()) == unknownCount);
+
+    if (unknownCount == 0)
     {
-        std::cout << "    Solver iterations:     " << solver.iterations() << std::endl;
-        std::cout << "    Solver error: " << solver.error() << std::endl;
+        solution = Vector::Zero(0);
+        return true;
     }
 
-    // Copy resulting vector to pressure grid
-    tbb::parallel_for(tbb::blocked_range<int>(0, liquidCellIndices.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = liquidCellIndices.unflatten(cellIndex);
-
-                              int liquidIndex = liquidCellIndices(cell);
-
-                              if (liquidIndex >= 0)
-                              {
-                                  assert(materialCellLabels(cell) == MaterialLabels::LIQUID_CELL);
-                                  myPressure(cell) = solutionVector(liquidIndex);
-                              }
-                              else
-                                  assert(materialCellLabels(cell) != MaterialLabels::LIQUID_CELL);
-                          }
-                      });
+    std::vector<int> localIndices(unknownCount);
+    std::vector<int> componentSizes(componentCount, 0);
 
-    // Build valid faces
-    for (int axis : {0, 1, 2})
+    for (int index = 0; index < unknownCount; ++index) localIndices[index] = componentSizes[components[index]]++;
+
+    std::vector<Vector> componentRhs(componentCount), componentGuess(componentCount);
+
+    for (int component = 0; component < componentCount; ++component)
     {
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, myValidFaces.grid(axis).voxelCount(), tbbLightGrainSize),
-            [&](const tbb::blocked_range<int>& range) {
-                for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                {
-                    Vec3i face = myValidFaces.grid(axis).unflatten(faceIndex);
+        componentRhs[component] = Vector::Zero(componentSizes[component]);
+        componentGuess[component] = Vector::Zero(componentSizes[component]);
+    }
+
+    for (int index = 0; index < unknownCount; ++index)
+    {
+        componentRhs[components[index]](localIndices[index]) = rhs(index);
+        componentGuess[components[index]](localIndices[index]) = guess(index);
+    }
+
+    // Split the matrix. There are no couplings between components. An enclosed component has the
+    // constant vector in its null space so its first unknown is pinned to zero. Removing the mean
+    // of its right-hand side first makes the remaining equations consistent.
+    std::vector<std::vector<Eigen::Triplet<SolveReal>>> componentElements(componentCount);
+
+    for (int outerIndex = 0; outerIndex < matrix.outerSize(); ++outerIndex)
+        for (Eigen::SparseMatrix<SolveReal>::InnerIterator it(matrix, outerIndex); it; ++it)
+        {
+            int component = components[it.row()];
+            assert(components[it.col()] == component);
+
+            int localRow = localIndices[it.row()];
+            int localCol = localIndices[it.col()];
+
+            if (!componentHasAir[component] && (localRow == 0 || localCol == 0)) continue;
 
-                    if (myCutCellWeights(face, axis) > 0)
+            componentElements[component].emplace_back(localRow, localCol, it.value());
+        }
+
+    for (int component = 0; component < componentCount; ++component)
+    {
+        if (componentHasAir[component]) continue;
+
+        componentElements[component].emplace_back(0, 0, 1);
+
+        Vector& localRhs = componentRhs[component];
+        localRhs.array() -= localRhs.mean();
+        localRhs(0) = 0;
+        componentGuess[component](0) = 0;
+    }
+
+    // Start the largest components first so they don't end up last on one thread
+    std::vector<int> componentOrder(componentCount);
+    std::iota(componentOrder.begin(), componentOrder.end(), 0);
+    std::stable_sort(componentOrder.begin(), componentOrder.end(),
+                     [&](int a, int b) { return componentSizes[a] > componentSizes[b]; });
+
+    std::vector<Vector> componentSolutions(componentCount);
+    std::vector<int> componentIterations(componentCount, 0);
+    std::vector<SolveReal> componentErrors(componentCount, 0);
+    std::vector<char> componentSolved(componentCount, false);
+
+    parallelFor(KernelClass::HEAVY, tbb::blocked_range<int>(0, componentCount, 1),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int orderIndex = range.begin(); orderIndex != range.end(); ++orderIndex)
                     {
-                        Vec3i backwardCell = faceToCell(face, axis, 0);
-                        Vec3i forwardCell = faceToCell(face, axis, 1);
+                        int component = componentOrder[orderIndex];
+                        int size = componentSizes[component];
+
+                        Eigen::SparseMatrix<SolveReal> localMatrix(size, size);
+                        localMatrix.setFromTriplets(componentElements[component].begin(),
+                                                    componentElements[component].end());
 
-                        if (!(backwardCell[axis] < 0 || forwardCell[axis] >= mySurface.size()[axis]))
+                        if (size <= directSolveSize)
                         {
-                            if (liquidCellIndices(backwardCell) >= 0 || liquidCellIndices(forwardCell) >= 0)
-                            {
-                                assert(materialCellLabels(backwardCell) == MaterialLabels::LIQUID_CELL ||
-                                       materialCellLabels(forwardCell) == MaterialLabels::LIQUID_CELL);
+                            Eigen::SimplicialLDLT<Eigen::SparseMatrix<SolveReal>> solver(localMatrix);
 
-                                myValidFaces(face, axis) = VisitedCellLabels::FINISHED_CELL;
-                            }
-                            else
-                                myValidFaces(face, axis) = VisitedCellLabels::UNVISITED_CELL;
+                            if (solver.info() != Eigen::Success) continue;
+
+                            componentSolutions[component] = solver.solve(componentRhs[component]);
+                            componentSolved[component] = solver.info() == Eigen::Success;
                         }
                         else
-                            myValidFaces(face, axis) = VisitedCellLabels::UNVISITED_CELL;
+                            componentSolved[component] = solveConjugateGradient(
+                                localMatrix, componentRhs[component], componentGuess[component],
+                                componentSolutions[component], componentIterations[component],
+                                componentErrors[component]);
                     }
-                }
-            });
-    }
+                });
 
-    // Apply pressure update
-    for (int axis : {0, 1, 2})
+    int directSolveCount = 0;
+    for (int component = 0; component < componentCount; ++component)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myValidFaces.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = myValidFaces.grid(axis).unflatten(faceIndex);
-
-                                  if (myValidFaces(face, axis) == VisitedCellLabels::FINISHED_CELL)
-                                  {
-                                      Vec3i backwardCell = faceToCell(face, axis, 0);
-                                      Vec3i forwardCell = faceToCell(face, axis, 1);
-
-                                      assert(myCutCellWeights(face, axis) > 0);
-                                      assert(backwardCell[axis] >= 0 && forwardCell[axis] <= mySurface.size()[axis]);
-                                      assert(materialCellLabels(backwardCell) == MaterialLabels::LIQUID_CELL ||
-                                             materialCellLabels(forwardCell) == MaterialLabels::LIQUID_CELL);
-
-                                      SolveReal gradient = myPressure(forwardCell) - myPressure(backwardCell);
-
-                                      if (materialCellLabels(backwardCell) == MaterialLabels::AIR_CELL ||
-                                          materialCellLabels(forwardCell) == MaterialLabels::AIR_CELL)
-                                      {
-                                          SolveReal theta = myGhostFluidWeights(face, axis);
-                                          theta = Utilities::clamp(theta, SolveReal(.01), SolveReal(1));
-
-                                          gradient /= theta;
-                                      }
-
-                                      velocity(face, axis) -= gradient;
-                                  }
-                              }
-                          });
+        if (!componentSolved[component])
+        {
+            std::cout << "   Solver failed on a liquid component of " << componentSizes[component] << " cells"
+                      << std::endl;
+            return false;
+        }
+
+        if (componentSizes[component] <= directSolveSize) ++directSolveCount;
     }
+
+    solution = Vector::Zero(unknownCount);
+    for (int index = 0; index < unknownCount; ++index)
+        solution(index) = componentSolutions[components[index]](localIndices[index]);
+
+    std::cout << "    Liquid components: " << componentCount << " (" << directSolveCount << " direct)" << std::endl;
+    iterations = *std::max_element(componentIterations.begin(), componentIterations.end());
+
+    std::cout << "    Solver iterations:     " << iterations << std::endl;
+    std::cout << "    Solver error: " << *std::max_element(componentErrors.begin(), componentErrors.end())
+              << std::endl;
+
+    return true;
 }
 
 }  // namespace FluidSim3D::SimTools
\ No newline at end of file
@@ -1,9 +1,14 @@
 #ifndef LIBRARY_PRESSURE_PROJECTION_H
 #define LIBRARY_PRESSURE_PROJECTION_H
 
+#include <array>
+#include <vector>
+
 #include <Eigen/Sparse>
 
+#include "ConjugateGradient.h"
 #include "LevelSet.h"
+#include "PackedLabelGrid.h"
 #include "ScalarGrid.h"
 #include "Utilities.h"
 #include "VectorGrid.h"
@@ -16,6 +21,12 @@
 // Variational pressure solve. Allows
 // for moving solids.
 //
+// Disconnected bodies of liquid are solved
+// as separate systems in parallel, so the
+// tolerance is met per body. Small bodies
+// are factored directly and bodies with no
+// free surface have their pressure pinned.
+//
 ////////////////////////////////////
 
 namespace FluidSim3D::SimTools
@@ -34,7 +45,8 @@ public:
 
     void project(VectorGrid<float>& velocity);
 
-    void setInitialGuess(const ScalarGrid<float>& initialGuessPressure)
+    // The guess is only a starting point for the solve so it's stored at half precision
+    void setInitialGuess(const ScalarGrid<Half>& initialGuessPressure)
     {
         assert(mySurface.isGridMatched(initialGuessPressure));
         myUseInitialGuessPressure = true;
@@ -43,24 +55,101 @@ public:
 
     void disableInitialGuess() { myUseInitialGuessPressure = false; }
 
-    ScalarGrid<float> getPressureGrid() { return myPressure; }
+    // Coarsen the pressure unknowns in the deep liquid. Liquid cells further than surfaceBand cells
+    // from air, and off the solid and cut-cell boundaries, are merged along y into tall cells whose
+    // pressure varies linearly between an unknown at each end. The reduced system is the Galerkin
+    // projection of the full system so it stays symmetric positive definite. Velocities are still
+    // updated on every face.
+    void enableTallCells(int surfaceBand = 4)
+    {
+        assert(surfaceBand >= 1);
+        myUseTallCells = true;
+        myTallCellBand = surfaceBand;
+    }
+
+    void disableTallCells() { myUseTallCells = false; }
+
+    // Solve with a matrix-free stencil applied straight from the weight grids instead of an assembled
+    // matrix. Tall cells take precedence.
+    void enableMatrixFreeSolve() { myUseMatrixFreeSolve = true; }
+
+    void disableMatrixFreeSolve() { myUseMatrixFreeSolve = false; }
+
+    // The pipelined variant takes one global reduction per iteration instead of two, which scales better
+    // on many threads. The operator is applied in a separate sweep without a reduction. Small components
+    // are still factored directly.
+    void setConjugateGradientVariant(ConjugateGradientVariant variant) { myConjugateGradientVariant = variant; }
+
+    // When the CG solves stop. MAX_RESIDUAL tolerances are the largest divergence, in 1/s, left in
+    // any liquid cell. RELATIVE_TO_PREVIOUS has to be resolved by the caller.
+    void setTolerance(const SolverTolerance& tolerance)
+    {
+        assert(tolerance.mode() != SolverTolerance::Mode::RELATIVE_TO_PREVIOUS);
+        myTolerance = tolerance;
+    }
+
+    // Results of the last projection. The iterations are the most any one body of liquid took and
+    // the divergences are the largest over the liquid cells, in 1/s.
+    int solverIterations() const { return mySolverIterations; }
+    float initialMaxDivergence() const { return myInitialMaxDivergence; }
+    float maxDivergence() const { return myMaxDivergence; }
 
-    const VectorGrid<VisitedCellLabels>& getValidFaces() { return myValidFaces; }
+    const ScalarGrid<float>& getPressureGrid() const { return myPressure; }
+
+    // Faces the last projection updated, one mask per axis sized like the staggered velocity grids
+    const std::array<BitMaskGrid, 3>& getValidFaces() const { return myValidFaces; }
+
+    // Move the results out instead of copying them. The projection can't project again afterwards.
+    ScalarGrid<float> takePressureGrid() { return std::move(myPressure); }
+    std::array<BitMaskGrid, 3> takeValidFaces() { return std::move(myValidFaces); }
 
 private:
+    // Net inflow through the faces of a cell, including the moving solid faces. This is the
+    // right-hand side of the pressure system; dividing by dx gives the divergence in 1/s.
+    SolveReal cellInflow(const Vec3i& cell, const VectorGrid<float>& velocity) const;
+
+    bool solveConjugateGradient(const Eigen::SparseMatrix<SolveReal>& matrix, const Vector& rhs, const Vector& guess,
+                                Vector& solution, int& iterations, SolveReal& error) const;
+
+    // Label the connected bodies of liquid into myLiquidComponents. A body that touches air anywhere has a
+    // Dirichlet condition; an enclosed one only has solid walls and its pressure is defined up to a constant.
+    void labelLiquidComponents(const UniformGrid<int>& liquidCellIndices, int liquidCellCount);
+
+    // Solve each connected component of the system on its own. components maps every unknown to its
+    // component and componentHasAir flags the components that touch the free surface.
+    bool solveComponents(const Eigen::SparseMatrix<SolveReal>& matrix, const Vector& rhs, const Vector& guess,
+                         const std::vector<int>& components, const std::vector<bool>& componentHasAir,
+                         Vector& solution, int& iterations) const;
+
     const VectorGrid<float>& mySolidVelocity;
     const VectorGrid<float>& myGhostFluidWeights;
     const VectorGrid<float>& myCutCellWeights;
 
     // Store flags for solved faces
-    VectorGrid<VisitedCellLabels> myValidFaces;
+    std::array<BitMaskGrid, 3> myValidFaces;
 
     const LevelSet& mySurface;
 
     ScalarGrid<float> myPressure;
 
-    const ScalarGrid<float>* myInitialGuessPressure;
+    const ScalarGrid<Half>* myInitialGuessPressure;
     bool myUseInitialGuessPressure;
+
+    bool myUseTallCells;
+    int myTallCellBand;
+
+    bool myUseMatrixFreeSolve;
+
+    ConjugateGradientVariant myConjugateGradientVariant;
+
+    SolverTolerance myTolerance;
+
+    // Component of every liquid cell and whether each component touches air
+    std::vector<int> myLiquidComponents;
+    std::vector<bool> myComponentHasAir;
+
+    int mySolverIterations;
+    float myInitialMaxDivergence, myMaxDivergence;
 };
 
 }  // namespace FluidSim3D::SimTools
@@ -0,0 +1,245 @@
+#include "PressureStencil.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FluidSim3D::SimTools
+{
+PressureStencil::PressureStencil(const VectorGrid<float>& cutCellWeights, const UniformGrid<int>& cellIndices,
+                                 std::vector<SolveReal>&& diagonals)
+    : myCutCellWeights(cutCellWeights), myCellIndices(cellIndices), myDiagonals(std::move(diagonals))
+{
+    assert(cutCellWeights.sampleType() == VectorGridSettings::SampleType::STAGGERED);
+
+    mySize = cutCellWeights.size(0);
+    --mySize[0];
+
+    assert(cellIndices.size() == mySize);
+
+    myInverseDiagonals.resize(myDiagonals.size());
+
+    myUnknownCount = 0;
+
+    for (int index = 0; index < int(myDiagonals.size()); ++index)
+    {
+        if (myDiagonals[index] != 0)
+        {
+            myInverseDiagonals[index] = 1. / myDiagonals[index];
+            ++myUnknownCount;
+        }
+        else
+            myInverseDiagonals[index] = 0;
+    }
+
+    for (int row = 0; row < rowCount(); ++row)
+    {
+        const int* indices = &myCellIndices(Vec3i(row / mySize[1], row % mySize[1], 0));
+
+        if (std::any_of(indices, indices + mySize[2], [](int index) { return index >= 0; }))
+            myActiveRows.push_back(row);
+    }
+}
+
+template <typename Body>
+void PressureStencil::forEachEntry(const Body& body) const
+{
+    parallelFor(KernelClass::LIGHT, 0, int(myDiagonals.size()), [&](const tbb::blocked_range<int>& range) {
+        for (int index = range.begin(); index != range.end(); ++index) body(index);
+    });
+}
+
+PressureStencil::SolveReal PressureStencil::applyRow(int i, int j, const std::vector<SolveReal>& vector,
+                                                     std::vector<SolveReal>& product) const
+{
+    const int rowLength = mySize[2];
+
+    const int* indices = &myCellIndices(Vec3i(i, j, 0));
+
+    // Neighbouring rows outside of the grid are stationary grid-aligned walls. Their faces have no
+    // entries to couple to so they're left out by pointing at no row.
+    const int* adjacentIndices[4] = {j > 0 ? &myCellIndices(Vec3i(i, j - 1, 0)) : nullptr,
+                                     j < mySize[1] - 1 ? &myCellIndices(Vec3i(i, j + 1, 0)) : nullptr,
+                                     i > 0 ? &myCellIndices(Vec3i(i - 1, j, 0)) : nullptr,
+                                     i < mySize[0] - 1 ? &myCellIndices(Vec3i(i + 1, j, 0)) : nullptr};
+
+    // Faces of a z row are contiguous in each weight grid. The z faces are shared by neighbouring
+    // cells in the row.
+    const float* adjacentWeights[4] = {&myCutCellWeights(Vec3i(i, j, 0), 1), &myCutCellWeights(Vec3i(i, j + 1, 0), 1),
+                                       &myCutCellWeights(Vec3i(i, j, 0), 0), &myCutCellWeights(Vec3i(i + 1, j, 0), 0)};
+    const float* zWeights = &myCutCellWeights(Vec3i(i, j, 0), 2);
+
+    SolveReal rowDot = 0;
+
+    for (int k = 0; k < rowLength; ++k)
+    {
+        int index = indices[k];
+        if (index < 0) continue;
+
+        // Entries that aren't unknowns stay zero
+        if (myDiagonals[index] == 0)
+        {
+            product[index] = 0;
+            continue;
+        }
+
+        SolveReal value = myDiagonals[index] * vector[index];
+
+        if (k > 0 && indices[k - 1] >= 0) value -= zWeights[k] * vector[indices[k - 1]];
+        if (k < rowLength - 1 && indices[k + 1] >= 0) value -= zWeights[k + 1] * vector[indices[k + 1]];
+
+        for (int adjacent = 0; adjacent < 4; ++adjacent)
+        {
+            if (adjacentIndices[adjacent] == nullptr) continue;
+
+            int adjacentIndex = adjacentIndices[adjacent][k];
+            if (adjacentIndex >= 0) value -= adjacentWeights[adjacent][k] * vector[adjacentIndex];
+        }
+
+        product[index] = value;
+        rowDot += vector[index] * value;
+    }
+
+    return rowDot;
+}
+
+void PressureStencil::apply(const std::vector<SolveReal>& vector, std::vector<SolveReal>& product) const
+{
+    assert(vector.size() == myDiagonals.size() && product.size() == myDiagonals.size());
+
+    // A row is a whole z column of cells so each item is heavy
+    parallelFor(KernelClass::HEAVY, 0, int(myActiveRows.size()), [&](const tbb::blocked_range<int>& range) {
+        for (int rowIndex = range.begin(); rowIndex != range.end(); ++rowIndex)
+        {
+            int row = myActiveRows[rowIndex];
+            applyRow(row / mySize[1], row % mySize[1], vector, product);
+        }
+    });
+}
+
+PressureStencil::SolveReal PressureStencil::applyAndDot(const std::vector<SolveReal>& vector,
+                                                        std::vector<SolveReal>& product) const
+{
+    assert(vector.size() == myDiagonals.size() && product.size() == myDiagonals.size());
+
+    return parallelReduce(
+        KernelClass::HEAVY, 0, int(myActiveRows.size()), SolveReal(0),
+        [&](const tbb::blocked_range<int>& range, SolveReal partialDot) -> SolveReal {
+            for (int rowIndex = range.begin(); rowIndex != range.end(); ++rowIndex)
+            {
+                int row = myActiveRows[rowIndex];
+                partialDot += applyRow(row / mySize[1], row % mySize[1], vector, product);
+            }
+
+            return partialDot;
+        },
+        [](SolveReal x, SolveReal y) -> SolveReal { return x + y; });
+}
+
+PressureStencil::SolveReal PressureStencil::dot(const std::vector<SolveReal>& vector0,
+                                                const std::vector<SolveReal>& vector1) const
+{
+    return parallelReduce(
+        KernelClass::LIGHT, 0, int(vector0.size()), SolveReal(0),
+        [&](const tbb::blocked_range<int>& range, SolveReal partialDot) -> SolveReal {
+            for (int index = range.begin(); index != range.end(); ++index)
+                partialDot += vector0[index] * vector1[index];
+
+            return partialDot;
+        },
+        [](SolveReal x, SolveReal y) -> SolveReal { return x + y; });
+}
+
+bool PressureStencil::solve(const std::vector<SolveReal>& rhs, std::vector<SolveReal>& solution,
+                            const SolverTolerance& tolerance, int& iterations, SolveReal& error) const
+{
+    assert(rhs.size() == myDiagonals.size() && solution.size() == myDiagonals.size());
+
+    const int vectorSize = myDiagonals.size();
+    const int maxIterations = 2 * myUnknownCount;
+
+    iterations = 0;
+    error = 0;
+
+    SolveReal rhsNorm2 = dot(rhs, rhs);
+
+    if (rhsNorm2 == 0)
+    {
+        std::fill(solution.begin(), solution.end(), 0);
+        return true;
+    }
+
+    std::vector<SolveReal> residual(vectorSize), preconditioned(vectorSize);
+    std::vector<SolveReal> direction(vectorSize), matrixDirection(vectorSize);
+
+    apply(solution, residual);
+
+    forEachEntry([&](int index) {
+        residual[index] = rhs[index] - residual[index];
+        direction[index] = myInverseDiagonals[index] * residual[index];
+    });
+
+    ConvergenceTest convergenceTest(tolerance, rhsNorm2);
+
+    // Squared norm and largest entry of the residual
+    Vec2d residualNorms = parallelReduce(
+        KernelClass::LIGHT, 0, vectorSize, Vec2d(0),
+        [&](const tbb::blocked_range<int>& range, Vec2d partialNorms) -> Vec2d {
+            for (int index = range.begin(); index != range.end(); ++index)
+            {
+                partialNorms[0] += residual[index] * residual[index];
+                partialNorms[1] = std::max(partialNorms[1], std::fabs(residual[index]));
+            }
+
+            return partialNorms;
+        },
+        joinNormAndMax);
+
+    SolveReal absNew = dot(residual, direction);
+
+    bool isConverged = convergenceTest.isConverged(residualNorms[0], residualNorms[1]);
+
+    while (!isConverged && iterations < maxIterations && !convergenceTest.isOutOfTime())
+    {
+        SolveReal alpha = absNew / applyAndDot(direction, matrixDirection);
+
+        // Update the solution and residual and precondition in one sweep, with every reduction fused in
+        Vec3d norms = parallelReduce(
+            KernelClass::LIGHT, 0, vectorSize, Vec3d(0),
+            [&](const tbb::blocked_range<int>& range, Vec3d partialNorms) -> Vec3d {
+                for (int index = range.begin(); index != range.end(); ++index)
+                {
+                    solution[index] += alpha * direction[index];
+                    residual[index] -= alpha * matrixDirection[index];
+                    preconditioned[index] = myInverseDiagonals[index] * residual[index];
+
+                    partialNorms[0] += residual[index] * residual[index];
+                    partialNorms[1] += residual[index] * preconditioned[index];
+                    partialNorms[2] = std::max(partialNorms[2], std::fabs(residual[index]));
+                }
+
+                return partialNorms;
+            },
+            [](const Vec3d& x, const Vec3d& y) -> Vec3d {
+                return Vec3d(x[0] + y[0], x[1] + y[1], std::max(x[2], y[2]));
+            });
+
+        residualNorms = Vec2d(norms[0], norms[2]);
+        ++iterations;
+
+        isConverged = convergenceTest.isConverged(residualNorms[0], residualNorms[1]);
+        if (isConverged) break;
+
+        SolveReal absOld = absNew;
+        absNew = norms[1];
+
+        SolveReal beta = absNew / absOld;
+
+        forEachEntry([&](int index) { direction[index] = preconditioned[index] + beta * direction[index]; });
+    }
+
+    error = std::sqrt(residualNorms[0] / rhsNorm2);
+
+    return isConverged || convergenceTest.isOutOfTime();
+}
+
+}  // namespace FluidSim3D::SimTools
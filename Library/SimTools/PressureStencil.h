@@ -0,0 +1,89 @@
+#ifndef LIBRARY_PRESSURE_STENCIL_H
+#define LIBRARY_PRESSURE_STENCIL_H
+
+#include <vector>
+
+#include "ConjugateGradient.h"
+#include "UniformGrid.h"
+#include "Utilities.h"
+#include "Vec.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// PressureStencil.h/cpp
+//
+// Matrix-free form of the pressure Laplacian
+// assembled by PressureProjection. Vectors hold
+// one entry per liquid cell, numbered by the
+// projection's liquid cell index map, so the
+// solver never touches air or solid cells.
+// Off-diagonals come straight from the cut-cell
+// weight grids and neighbours are found through
+// the index map; only the diagonal, which folds
+// in the ghost fluid terms, is stored. Sweeps
+// run along z rows of the grid so the index map
+// and all three face weight grids are read with
+// unit stride. Rows with no liquid cells are
+// never visited.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SimTools
+{
+using namespace Utilities;
+
+class PressureStencil
+{
+public:
+    using SolveReal = double;
+
+    // cellIndices maps cells to vector entries and is negative on cells without an entry. diagonals
+    // holds one value per entry. An entry with a zero diagonal isn't an unknown and stays zero.
+    PressureStencil(const VectorGrid<float>& cutCellWeights, const UniformGrid<int>& cellIndices,
+                    std::vector<SolveReal>&& diagonals);
+
+    // product = A * vector over the unknowns
+    void apply(const std::vector<SolveReal>& vector, std::vector<SolveReal>& product) const;
+
+    // Same as apply but also returns dot(vector, product), taken while each row is in cache
+    SolveReal applyAndDot(const std::vector<SolveReal>& vector, std::vector<SolveReal>& product) const;
+
+    SolveReal dot(const std::vector<SolveReal>& vector0, const std::vector<SolveReal>& vector1) const;
+
+    // Jacobi preconditioned CG. solution holds the initial guess on entry. error is the final relative
+    // residual. Returns false if it runs out of iterations before meeting the tolerance.
+    bool solve(const std::vector<SolveReal>& rhs, std::vector<SolveReal>& solution, const SolverTolerance& tolerance,
+               int& iterations, SolveReal& error) const;
+
+    const Vec3i& size() const { return mySize; }
+
+    int unknownCount() const { return myUnknownCount; }
+
+    // Zero on entries that aren't unknowns
+    SolveReal inverseDiagonal(int index) const { return myInverseDiagonals[index]; }
+
+private:
+    // Rows of the grid along z, indexed by x * size[1] + y
+    int rowCount() const { return mySize[0] * mySize[1]; }
+
+    // Applies the stencil to the entries of one z row and returns their part of dot(vector, product)
+    SolveReal applyRow(int i, int j, const std::vector<SolveReal>& vector, std::vector<SolveReal>& product) const;
+
+    template <typename Body>
+    void forEachEntry(const Body& body) const;
+
+    const VectorGrid<float>& myCutCellWeights;
+    const UniformGrid<int>& myCellIndices;
+    std::vector<SolveReal> myDiagonals, myInverseDiagonals;
+
+    // z rows with at least one entry
+    std::vector<int> myActiveRows;
+
+    Vec3i mySize;
+    int myUnknownCount;
+};
+
+}  // namespace FluidSim3D::SimTools
+
+#endif
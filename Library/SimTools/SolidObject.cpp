@@ -0,0 +1,170 @@
+#include "SolidObject.h"
+
+#include "tbb/tbb.h"
+
+namespace FluidSim3D::SimTools
+{
+SolidObject::SolidObject(const TriMesh& mesh, const Vec3f& rotationCenter, float dx, int bandwidth)
+    : myLocalSurface(Transform(dx, Vec3f(0)), Vec3i(0), bandwidth),
+      myCenter(rotationCenter),
+      myRotation({Vec3f(1, 0, 0), Vec3f(0, 1, 0), Vec3f(0, 0, 1)}),
+      myLinearVelocity(0),
+      myAngularVelocity(0)
+{
+    // Move the mesh into the local frame and scan convert it once. The grid is
+    // resized to fit the mesh so it only covers the solid and its narrow band.
+    std::vector<Vec3f> localVertices(mesh.vertexCount());
+    for (int vertexIndex = 0; vertexIndex < mesh.vertexCount(); ++vertexIndex)
+        localVertices[vertexIndex] = mesh.vertex(vertexIndex).point() - myCenter;
+
+    std::vector<Vec3i> triFaces(mesh.triFaceCount());
+    for (int triFaceIndex = 0; triFaceIndex < mesh.triFaceCount(); ++triFaceIndex)
+        triFaces[triFaceIndex] = mesh.triFace(triFaceIndex).vertices();
+
+    TriMesh localMesh(triFaces, localVertices);
+    myLocalSurface.initFromMesh(localMesh, true);
+}
+
+void SolidObject::advance(float dt)
+{
+    myCenter += dt * myLinearVelocity;
+
+    float angle = dt * mag(myAngularVelocity);
+    if (angle == 0) return;
+
+    // Rodrigues' formula for the incremental rotation about the angular velocity axis
+    Vec3f axis = normalize(myAngularVelocity);
+    float sinAngle = std::sin(angle);
+    float cosAngle = std::cos(angle);
+
+    std::array<Vec3f, 3> incrementalRotation;
+    for (int row : {0, 1, 2})
+        for (int column : {0, 1, 2})
+        {
+            float skew = 0;
+            if (row != column)
+            {
+                int otherAxis = 3 - row - column;
+                float sign = (column == (row + 1) % 3) ? -1 : 1;
+                skew = sign * axis[otherAxis];
+            }
+
+            incrementalRotation[row][column] = (row == column ? cosAngle : 0) + sinAngle * skew +
+                                               (1 - cosAngle) * axis[row] * axis[column];
+        }
+
+    std::array<Vec3f, 3> rotation;
+    for (int row : {0, 1, 2})
+        for (int column : {0, 1, 2})
+        {
+            rotation[row][column] = 0;
+            for (int k : {0, 1, 2}) rotation[row][column] += incrementalRotation[row][k] * myRotation[k][column];
+        }
+
+    // Re-orthonormalize so round-off doesn't accumulate into a shear over many steps
+    rotation[0] = normalize(rotation[0]);
+    rotation[1] = normalize(rotation[1] - dot(rotation[1], rotation[0]) * rotation[0]);
+    rotation[2] = cross(rotation[0], rotation[1]);
+
+    myRotation = rotation;
+}
+
+Vec3f SolidObject::worldToLocal(const Vec3f& worldPoint) const
+{
+    // The inverse rotation is the transpose of the row-wise rotation
+    Vec3f offset = worldPoint - myCenter;
+    return offset[0] * myRotation[0] + offset[1] * myRotation[1] + offset[2] * myRotation[2];
+}
+
+Vec3f SolidObject::localToWorld(const Vec3f& localPoint) const
+{
+    return Vec3f(dot(myRotation[0], localPoint), dot(myRotation[1], localPoint), dot(myRotation[2], localPoint)) +
+           myCenter;
+}
+
+float SolidObject::phi(const Vec3f& worldPoint) const
+{
+    return myLocalSurface.interpOrBackground(worldToLocal(worldPoint));
+}
+
+float CompositeSolid::phi(const Vec3f& worldPoint) const
+{
+    float solidPhi = myStaticSurface.interp(worldPoint);
+
+    for (const SolidObject& solid : mySolids) solidPhi = std::min(solidPhi, solid.phi(worldPoint));
+
+    return solidPhi;
+}
+
+int CompositeSolid::nearestSolid(const Vec3f& worldPoint, float threshold) const
+{
+    int nearestSolidIndex = -1;
+    float nearestPhi = threshold;
+
+    for (int solidIndex = 0; solidIndex < solidCount(); ++solidIndex)
+    {
+        float solidPhi = mySolids[solidIndex].phi(worldPoint);
+        if (solidPhi < nearestPhi)
+        {
+            nearestPhi = solidPhi;
+            nearestSolidIndex = solidIndex;
+        }
+    }
+
+    return nearestSolidIndex;
+}
+
+Vec3f CompositeSolid::velocity(const Vec3f& worldPoint, float threshold) const
+{
+    int solidIndex = nearestSolid(worldPoint, threshold);
+
+    if (solidIndex < 0) return Vec3f(0);
+
+    return mySolids[solidIndex].velocity(worldPoint);
+}
+
+void CompositeSolid::sampleSurface(LevelSet& surface) const
+{
+    assert(surface.isGridMatched(myStaticSurface));
+
+    parallelFor(KernelClass::LIGHT, 0, surface.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = surface.unflatten(cellIndex);
+
+                        float solidPhi = myStaticSurface(cell);
+
+                        Vec3f worldPoint = surface.indexToWorld(Vec3f(cell));
+                        for (const SolidObject& solid : mySolids)
+                            solidPhi = std::min(solidPhi, solid.phi(worldPoint));
+
+                        surface(cell) = solidPhi;
+                    }
+                });
+}
+
+void CompositeSolid::sampleVelocity(VectorGrid<float>& velocity, float threshold) const
+{
+    if (mySolids.empty()) return;
+
+    for (int axis : {0, 1, 2})
+    {
+        parallelFor(KernelClass::LIGHT, 0, velocity.grid(axis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = velocity.grid(axis).unflatten(faceIndex);
+
+                            Vec3f worldPoint = velocity.indexToWorld(Vec3f(face), axis);
+
+                            int solidIndex = nearestSolid(worldPoint, threshold);
+
+                            if (solidIndex >= 0)
+                                velocity(face, axis) = mySolids[solidIndex].velocity(worldPoint)[axis];
+                        }
+                    });
+    }
+}
+
+}  // namespace FluidSim3D::SimTools
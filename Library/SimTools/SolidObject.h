@@ -0,0 +1,128 @@
+#ifndef LIBRARY_SOLID_OBJECT_H
+#define LIBRARY_SOLID_OBJECT_H
+
+#include <array>
+#include <vector>
+
+#include "LevelSet.h"
+#include "TriMesh.h"
+#include "Utilities.h"
+#include "Vec.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// SolidObject.h/cpp
+//
+// A rigid solid that scan converts its mesh
+// once into a level set in its own local frame.
+// Moving the solid only updates its pose, and the
+// signed distance is looked up through the inverse
+// rigid transform. The velocity at any point comes
+// analytically from the linear and angular velocity.
+//
+// CompositeSolid combines a static level set with
+// any number of rigid solids. Nothing is built when
+// objects move; the union is only evaluated when it
+// is sampled onto a simulation grid.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SimTools
+{
+using namespace SurfaceTrackers;
+using namespace Utilities;
+
+class SolidObject
+{
+public:
+    // The mesh is given in world space at its initial pose. The rotation center
+    // becomes the origin of the local frame that the level set is built in.
+    SolidObject(const TriMesh& mesh, const Vec3f& rotationCenter, float dx, int bandwidth = 5);
+
+    void setLinearVelocity(const Vec3f& linearVelocity) { myLinearVelocity = linearVelocity; }
+    void setAngularVelocity(const Vec3f& angularVelocity) { myAngularVelocity = angularVelocity; }
+
+    const Vec3f& linearVelocity() const { return myLinearVelocity; }
+    const Vec3f& angularVelocity() const { return myAngularVelocity; }
+
+    // Move the solid rigidly by its current velocity over dt.
+    void advance(float dt);
+
+    // World space position of the rotation center
+    const Vec3f& center() const { return myCenter; }
+
+    // Signed distance at a world space point. Points outside of the local
+    // level set grid return the narrow band distance.
+    float phi(const Vec3f& worldPoint) const;
+
+    // Rigid body velocity at a world space point
+    Vec3f velocity(const Vec3f& worldPoint) const
+    {
+        return myLinearVelocity + cross(myAngularVelocity, worldPoint - myCenter);
+    }
+
+    Vec3f worldToLocal(const Vec3f& worldPoint) const;
+    Vec3f localToWorld(const Vec3f& localPoint) const;
+
+    const LevelSet& localSurface() const { return myLocalSurface; }
+
+private:
+    LevelSet myLocalSurface;
+
+    // Pose of the local frame. The rotation is stored row-wise and maps local to world.
+    Vec3f myCenter;
+    std::array<Vec3f, 3> myRotation;
+
+    Vec3f myLinearVelocity, myAngularVelocity;
+};
+
+class CompositeSolid
+{
+public:
+    // The static surface is used as the base of the union. It is copied once
+    // and never rebuilt.
+    explicit CompositeSolid(const LevelSet& staticSurface) : myStaticSurface(staticSurface) {}
+
+    // Returns the index of the added solid
+    int addSolid(const SolidObject& solid)
+    {
+        mySolids.push_back(solid);
+        return mySolids.size() - 1;
+    }
+
+    SolidObject& solid(int solidIndex) { return mySolids[solidIndex]; }
+    const SolidObject& solid(int solidIndex) const { return mySolids[solidIndex]; }
+
+    int solidCount() const { return mySolids.size(); }
+
+    void advance(float dt)
+    {
+        for (SolidObject& solid : mySolids) solid.advance(dt);
+    }
+
+    float phi(const Vec3f& worldPoint) const;
+
+    // Velocity of the nearest moving solid if the point is within the threshold of it.
+    // The static surface has zero velocity.
+    Vec3f velocity(const Vec3f& worldPoint, float threshold) const;
+
+    // Evaluate the union at every cell of the surface. The surface must already be
+    // sized to the simulation grid.
+    void sampleSurface(LevelSet& surface) const;
+
+    // Set the rigid velocity at every face that is within the threshold of a moving solid.
+    // Faces away from the moving solids are left untouched.
+    void sampleVelocity(VectorGrid<float>& velocity, float threshold) const;
+
+private:
+    // Index of the moving solid with the smallest distance below the threshold, or -1
+    int nearestSolid(const Vec3f& worldPoint, float threshold) const;
+
+    LevelSet myStaticSurface;
+    std::vector<SolidObject> mySolids;
+};
+
+}  // namespace FluidSim3D::SimTools
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef LIBRARY_SPARSE_MATRIX_ASSEMBLY_H
+#define LIBRARY_SPARSE_MATRIX_ASSEMBLY_H
+
+#include <array>
+#include <vector>
+
+#include <Eigen/Sparse>
+
+#include "Utilities.h"
+
+///////////////////////////////////
+//
+// SparseMatrixAssembly.h
+//
+// Two-pass assembly of symmetric sparse systems
+// straight into Eigen's compressed storage. The
+// first pass counts the entries of every row, the
+// counts are prefix summed into row offsets and
+// the second pass writes each row into its own
+// slice of the arrays. Rows can be built in
+// parallel without triplet buffers or a sort.
+//
+// The systems are symmetric so row i is stored
+// as column i of Eigen's column-major layout.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SimTools
+{
+// The entries of one row kept in column order. Repeated columns are summed in the order they were
+// added. Capacity is the most distinct columns a row of the stencil can touch.
+template <typename Real, int Capacity>
+class SparseRowAccumulator
+{
+public:
+    SparseRowAccumulator() : mySize(0) {}
+
+    void clear() { mySize = 0; }
+
+    void add(int column, Real value)
+    {
+        int position = mySize;
+        while (position > 0 && myColumns[position - 1] > column) --position;
+
+        if (position > 0 && myColumns[position - 1] == column)
+        {
+            myValues[position - 1] += value;
+            return;
+        }
+
+        assert(mySize < Capacity);
+
+        for (int index = mySize; index > position; --index)
+        {
+            myColumns[index] = myColumns[index - 1];
+            myValues[index] = myValues[index - 1];
+        }
+
+        myColumns[position] = column;
+        myValues[position] = value;
+        ++mySize;
+    }
+
+    int size() const { return mySize; }
+
+    int column(int index) const { return myColumns[index]; }
+    Real value(int index) const { return myValues[index]; }
+
+private:
+    std::array<int, Capacity> myColumns;
+    std::array<Real, Capacity> myValues;
+    int mySize;
+};
+
+// Size a square matrix from the number of entries in each row
+template <typename Real>
+void allocateSparseRows(Eigen::SparseMatrix<Real>& matrix, const std::vector<int>& rowCounts)
+{
+    int size = rowCounts.size();
+    matrix.resize(size, size);
+
+    int* offsets = matrix.outerIndexPtr();
+    offsets[0] = 0;
+
+    for (int row = 0; row < size; ++row) offsets[row + 1] = offsets[row] + rowCounts[row];
+
+    matrix.resizeNonZeros(offsets[size]);
+}
+
+// Copy a row into the slice reserved for it. Different rows can be written concurrently.
+template <typename Real, int Capacity>
+void writeSparseRow(Eigen::SparseMatrix<Real>& matrix, int row, const SparseRowAccumulator<Real, Capacity>& entries)
+{
+    int offset = matrix.outerIndexPtr()[row];
+    assert(matrix.outerIndexPtr()[row + 1] - offset == entries.size());
+
+    for (int index = 0; index < entries.size(); ++index)
+    {
+        matrix.innerIndexPtr()[offset + index] = entries.column(index);
+        matrix.valuePtr()[offset + index] = entries.value(index);
+    }
+}
+
+}  // namespace FluidSim3D::SimTools
+
+#endif
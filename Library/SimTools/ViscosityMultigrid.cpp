@@ -0,0 +1,219 @@
+#include "ViscosityMultigrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FluidSim3D::SimTools
+{
+// Levels stop coarsening once the system is small enough to factor cheaply
+constexpr int COARSEST_UNKNOWN_COUNT = 2000;
+constexpr int MAX_LEVEL_COUNT = 10;
+
+// Sweeps before and after the coarse correction. Equal counts keep the cycle symmetric.
+constexpr int SMOOTHING_SWEEPS = 2;
+
+// product = transpose(matrix) * vector, computed a column at a time in parallel. The matrices here
+// are column-major so this is the parallel-friendly product. For the symmetric level matrices it is
+// the regular product.
+static void multiplyTransposed(const Eigen::SparseMatrix<double>& matrix, const Eigen::VectorXd& vector,
+                               Eigen::VectorXd& product)
+{
+    assert(matrix.isCompressed() && vector.size() == matrix.rows());
+
+    product.resize(matrix.cols());
+
+    const int* offsets = matrix.outerIndexPtr();
+    const int* rows = matrix.innerIndexPtr();
+    const double* values = matrix.valuePtr();
+
+    parallelFor(KernelClass::LIGHT, 0, int(matrix.cols()), [&](const tbb::blocked_range<int>& range) {
+        for (int column = range.begin(); column != range.end(); ++column)
+        {
+            double value = 0;
+            for (int entry = offsets[column]; entry < offsets[column + 1]; ++entry)
+                value += values[entry] * vector[rows[entry]];
+
+            product[column] = value;
+        }
+    });
+}
+
+ViscosityMultigrid::ViscosityMultigrid(const Eigen::SparseMatrix<SolveReal>& matrix,
+                                       const VectorGrid<int>& faceIndices)
+    : myFineMatrix(matrix)
+{
+    assert(faceIndices.sampleType() == VectorGridSettings::SampleType::STAGGERED);
+    assert(matrix.rows() == matrix.cols() && matrix.isCompressed());
+
+    VectorGrid<int> fineIndices = faceIndices;
+
+    myLevels.emplace_back();
+
+    for (int level = 0;; ++level)
+    {
+        const Eigen::SparseMatrix<SolveReal>& levelMatrix = this->matrix(level);
+
+        int fineCount = levelMatrix.cols();
+
+        Vec3i fineSize = fineIndices.gridSize();
+
+        if (fineCount <= COARSEST_UNKNOWN_COUNT || level + 1 == MAX_LEVEL_COUNT ||
+            std::min(fineSize[0], std::min(fineSize[1], fineSize[2])) <= 2)
+            break;
+
+        // l1 Jacobi scales the residual by the absolute row sums
+        Vector inverseL1Diagonals(fineCount);
+
+        parallelFor(KernelClass::LIGHT, 0, fineCount, [&](const tbb::blocked_range<int>& range) {
+            for (int row = range.begin(); row != range.end(); ++row)
+            {
+                SolveReal rowSum = 0;
+                for (Eigen::SparseMatrix<SolveReal>::InnerIterator it(levelMatrix, row); it; ++it)
+                    rowSum += std::fabs(it.value());
+
+                inverseL1Diagonals(row) = rowSum > 0 ? 1. / rowSum : 0;
+            }
+        });
+
+        // A coarse face is an unknown if any fine face lying on it is one
+        Vec3i coarseSize;
+        for (int axis : {0, 1, 2}) coarseSize[axis] = (fineSize[axis] + 1) / 2;
+
+        Transform coarseXform(2. * fineIndices.dx(), fineIndices.xform().offset());
+
+        VectorGrid<int> coarseIndices(coarseXform, coarseSize, -1, VectorGridSettings::SampleType::STAGGERED);
+
+        int coarseCount = 0;
+
+        for (int axis : {0, 1, 2})
+        {
+            forEachVoxelRange(Vec3i(0), fineIndices.size(axis), [&](const Vec3i& face) {
+                if (fineIndices(face, axis) >= 0 && face[axis] % 2 == 0) coarseIndices(face / 2, axis) = 0;
+            });
+
+            forEachVoxelRange(Vec3i(0), coarseIndices.size(axis), [&](const Vec3i& face) {
+                if (coarseIndices(face, axis) >= 0) coarseIndices(face, axis) = coarseCount++;
+            });
+        }
+
+        if (coarseCount == 0 || coarseCount >= fineCount) break;
+
+        // Faces on a coarse face take its value. Faces halfway between two coarse faces take the average
+        // of the ones that are unknowns. Every coarse column has an entry of one on a fine face that no
+        // other column touches so the prolongation has full rank and R A P stays positive definite.
+        OrderedLocalThreadVectors<Eigen::Triplet<SolveReal>> parallelProlongationElements;
+
+        for (int axis : {0, 1, 2})
+        {
+            parallelFor(KernelClass::LIGHT, 0, fineIndices.grid(axis).voxelCount(),
+                        [&](const tbb::blocked_range<int>& range) {
+                            auto& localProlongationElements = parallelProlongationElements.local(range.begin(), axis);
+
+                            for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                            {
+                                Vec3i face = fineIndices.grid(axis).unflatten(faceIndex);
+
+                                int fineIndex = fineIndices(face, axis);
+                                if (fineIndex < 0) continue;
+
+                                Vec3i coarseFace = face / 2;
+
+                                if (face[axis] % 2 == 0)
+                                {
+                                    localProlongationElements.emplace_back(fineIndex, coarseIndices(coarseFace, axis),
+                                                                           1);
+                                    continue;
+                                }
+
+                                for (int direction : {0, 1})
+                                {
+                                    Vec3i adjacentFace = coarseFace;
+                                    adjacentFace[axis] += direction;
+
+                                    int coarseIndex = coarseIndices(adjacentFace, axis);
+                                    if (coarseIndex >= 0)
+                                        localProlongationElements.emplace_back(fineIndex, coarseIndex, .5);
+                                }
+                            }
+                        });
+        }
+
+        std::vector<Eigen::Triplet<SolveReal>> prolongationElements;
+        mergeLocalThreadVectors(prolongationElements, parallelProlongationElements);
+
+        Level& fineLevel = myLevels[level];
+
+        fineLevel.myInverseL1Diagonals = std::move(inverseL1Diagonals);
+
+        fineLevel.myProlongation.resize(fineCount, coarseCount);
+        fineLevel.myProlongation.setFromTriplets(prolongationElements.begin(), prolongationElements.end());
+
+        fineLevel.myRestriction = fineLevel.myProlongation.transpose();
+
+        Eigen::SparseMatrix<SolveReal> coarseMatrix = fineLevel.myRestriction * levelMatrix * fineLevel.myProlongation;
+        coarseMatrix.makeCompressed();
+
+        // levelMatrix and fineLevel may move once a level is added
+        myLevels.emplace_back();
+        myLevels.back().myCoarseMatrix = std::move(coarseMatrix);
+
+        fineIndices = std::move(coarseIndices);
+    }
+
+    myCoarsestSolver.compute(this->matrix(levelCount() - 1));
+    assert(myCoarsestSolver.info() == Eigen::Success);
+}
+
+void ViscosityMultigrid::smooth(int level, const Vector& rhs, Vector& solution, Vector& scratch) const
+{
+    const Vector& inverseL1Diagonals = myLevels[level].myInverseL1Diagonals;
+
+    multiplyTransposed(matrix(level), solution, scratch);
+
+    parallelFor(KernelClass::LIGHT, 0, int(solution.size()), [&](const tbb::blocked_range<int>& range) {
+        for (int row = range.begin(); row != range.end(); ++row)
+            scratch(row) = solution(row) + inverseL1Diagonals(row) * (rhs(row) - scratch(row));
+    });
+
+    solution.swap(scratch);
+}
+
+void ViscosityMultigrid::vCycle(int level, const Vector& rhs, Vector& solution) const
+{
+    if (level == levelCount() - 1)
+    {
+        solution = myCoarsestSolver.solve(rhs);
+        return;
+    }
+
+    const Level& fineLevel = myLevels[level];
+
+    // The first sweep from a zero guess is just the scaled right-hand side
+    solution = fineLevel.myInverseL1Diagonals.cwiseProduct(rhs);
+
+    Vector scratch(rhs.size());
+
+    for (int sweep = 1; sweep < SMOOTHING_SWEEPS; ++sweep) smooth(level, rhs, solution, scratch);
+
+    multiplyTransposed(matrix(level), solution, scratch);
+    scratch = rhs - scratch;
+
+    Vector coarseRhs, coarseSolution;
+    multiplyTransposed(fineLevel.myProlongation, scratch, coarseRhs);
+
+    vCycle(level + 1, coarseRhs, coarseSolution);
+
+    multiplyTransposed(fineLevel.myRestriction, coarseSolution, scratch);
+    solution += scratch;
+
+    for (int sweep = 0; sweep < SMOOTHING_SWEEPS; ++sweep) smooth(level, rhs, solution, scratch);
+}
+
+void ViscosityMultigrid::apply(const Vector& rhs, Vector& solution) const
+{
+    assert(rhs.size() == myFineMatrix.cols());
+
+    vCycle(0, rhs, solution);
+}
+
+}  // namespace FluidSim3D::SimTools
@@ -0,0 +1,85 @@
+#ifndef LIBRARY_VISCOSITY_MULTIGRID_H
+#define LIBRARY_VISCOSITY_MULTIGRID_H
+
+#include <vector>
+
+#include <Eigen/Sparse>
+
+#include "Utilities.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// ViscosityMultigrid.h/cpp
+//
+// Geometric multigrid V-cycle for the coupled
+// face velocity system of the viscosity solve,
+// used as a CG preconditioner. Each coarse level
+// is the staggered face grid at twice the
+// spacing. A coarse face is an unknown if any of
+// the fine faces it coincides with is one. Fine
+// velocities are interpolated linearly along
+// the face normal and held constant across the
+// face, and the coarse operators are the
+// Galerkin products R A P so the cut volume
+// weights carry down exactly. Smoothing is l1
+// Jacobi, which converges for any symmetric
+// positive definite system without a damping
+// parameter, and the coarsest level is solved
+// directly.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SimTools
+{
+using namespace Utilities;
+
+class ViscosityMultigrid
+{
+public:
+    using SolveReal = double;
+    using Vector = Eigen::VectorXd;
+
+    // faceIndices holds the row of the matrix for every face in the solve and -1 everywhere else.
+    // The matrix is referenced, not copied, and has to outlive the hierarchy.
+    ViscosityMultigrid(const Eigen::SparseMatrix<SolveReal>& matrix, const VectorGrid<int>& faceIndices);
+
+    // One V-cycle from a zero initial guess. The cycle is a symmetric positive definite operator
+    // so it can precondition CG.
+    void apply(const Vector& rhs, Vector& solution) const;
+
+    int levelCount() const { return myLevels.size(); }
+
+    int unknownCount(int level) const { return matrix(level).cols(); }
+
+private:
+    struct Level
+    {
+        // Coarse matrix of this level. Unused on the finest level.
+        Eigen::SparseMatrix<SolveReal> myCoarseMatrix;
+
+        // Maps the next coarser level onto this one and its transpose, both stored column-major
+        Eigen::SparseMatrix<SolveReal> myProlongation, myRestriction;
+
+        Vector myInverseL1Diagonals;
+    };
+
+    const Eigen::SparseMatrix<SolveReal>& matrix(int level) const
+    {
+        return level == 0 ? myFineMatrix : myLevels[level].myCoarseMatrix;
+    }
+
+    void smooth(int level, const Vector& rhs, Vector& solution, Vector& scratch) const;
+
+    void vCycle(int level, const Vector& rhs, Vector& solution) const;
+
+    const Eigen::SparseMatrix<SolveReal>& myFineMatrix;
+
+    std::vector<Level> myLevels;
+
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<SolveReal>> myCoarsestSolver;
+};
+
+}  // namespace FluidSim3D::SimTools
+
+#endif
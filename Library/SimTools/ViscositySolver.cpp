@@ -1,18 +1,30 @@
 #include "ViscositySolver.h"
 
 #include <Eigen/Sparse>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 #include "ComputeWeights.h"
 #include "LevelSet.h"
+#include "PackedLabelGrid.h"
+#include "SparseMatrixAssembly.h"
+#include "ViscosityMultigrid.h"
 
 namespace FluidSim3D::SimTools
 {
 using SolveReal = double;
 using Vector = Eigen::VectorXd;
 
-void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity, const LevelSet& solidSurface,
-                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity)
+// Assemble the implicit system (M + dt K) u = M u_old + b over the liquid faces. faceMasses holds the
+// diagonal of M and initialGuessVector the old velocities.
+static void buildViscositySystem(float dt, const LevelSet& surface, const VectorGrid<float>& velocity,
+                                 const LevelSet& solidSurface, const VectorGrid<float>& solidVelocity,
+                                 const ScalarGrid<float>& viscosity, VectorGrid<int>& liquidFaceIndices,
+                                 Eigen::SparseMatrix<SolveReal>& sparseMatrix, Vector& rhsVector,
+                                 Vector& initialGuessVector, Vector& faceMasses)
 {
     // For efficiency sake, this should only take in velocity on a staggered grid
     // that matches the center sampled surface and collision
@@ -45,69 +57,66 @@ void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& veloc
         AIR_FACE
     };
 
-    VectorGrid<MaterialLabels> materialFaceLabels(surface.xform(), surface.size(), MaterialLabels::AIR_FACE,
-                                                  VectorGridSettings::SampleType::STAGGERED);
+    std::array<PackedLabelGrid<MaterialLabels, 2>, 3> materialFaceLabels;
 
     // Set material labels for each grid face. We assume faces along the simulation boundary
     // are solid.
 
     for (int faceAxis : {0, 1, 2})
     {
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, materialFaceLabels.grid(faceAxis).voxelCount(), tbbLightGrainSize),
-            [&](const tbb::blocked_range<int>& range) {
-                for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                {
-                    Vec3i face = materialFaceLabels.grid(faceAxis).unflatten(faceIndex);
+        PackedLabelGrid<MaterialLabels, 2>& faceLabels = materialFaceLabels[faceAxis];
 
-                    if (face[faceAxis] == 0 || face[faceAxis] == materialFaceLabels.size(faceAxis)[faceAxis] - 1)
-                        continue;
+        faceLabels.resize(velocity.size(faceAxis));
 
-                    bool isFaceInSolve = false;
+        faceLabels.assign([&](int faceIndex) {
+            Vec3i face = faceLabels.unflatten(faceIndex);
 
-                    for (int direction : {0, 1})
-                    {
-                        Vec3i cell = faceToCell(face, faceAxis, direction);
-                        if (centerVolumes(cell) > 0) isFaceInSolve = true;
-                    }
+            if (face[faceAxis] == 0 || face[faceAxis] == faceLabels.size()[faceAxis] - 1)
+                return MaterialLabels::AIR_FACE;
 
-                    if (!isFaceInSolve)
-                    {
-                        for (int edgeAxis : {0, 1, 2})
-                        {
-                            if (edgeAxis == faceAxis) continue;
+            bool isFaceInSolve = false;
 
-                            for (int direction : {0, 1})
-                            {
-                                Vec3i edge = faceToEdge(face, faceAxis, edgeAxis, direction);
+            for (int direction : {0, 1})
+            {
+                Vec3i cell = faceToCell(face, faceAxis, direction);
+                if (centerVolumes(cell) > 0) isFaceInSolve = true;
+            }
 
-                                if (edgeVolumes(edge, edgeAxis) > 0) isFaceInSolve = true;
-                            }
-                        }
-                    }
+            if (!isFaceInSolve)
+            {
+                for (int edgeAxis : {0, 1, 2})
+                {
+                    if (edgeAxis == faceAxis) continue;
 
-                    if (isFaceInSolve)
+                    for (int direction : {0, 1})
                     {
-                        if (solidSurface.interp(materialFaceLabels.indexToWorld(Vec3f(face), faceAxis)) <= 0.)
-                            materialFaceLabels(face, faceAxis) = MaterialLabels::SOLID_FACE;
-                        else
-                            materialFaceLabels(face, faceAxis) = MaterialLabels::LIQUID_FACE;
+                        Vec3i edge = faceToEdge(face, faceAxis, edgeAxis, direction);
+
+                        if (edgeVolumes(edge, edgeAxis) > 0) isFaceInSolve = true;
                     }
                 }
-            });
+            }
+
+            if (!isFaceInSolve) return MaterialLabels::AIR_FACE;
+
+            if (solidSurface.interp(velocity.indexToWorld(Vec3f(face), faceAxis)) <= 0.)
+                return MaterialLabels::SOLID_FACE;
+
+            return MaterialLabels::LIQUID_FACE;
+        });
     }
 
     int liquidDOFCount = 0;
 
     constexpr int UNLABELLED_CELL = -1;
 
-    VectorGrid<int> liquidFaceIndices(surface.xform(), surface.size(), UNLABELLED_CELL,
-                                      VectorGridSettings::SampleType::STAGGERED);
+    liquidFaceIndices =
+        VectorGrid<int>(surface.xform(), surface.size(), UNLABELLED_CELL, VectorGridSettings::SampleType::STAGGERED);
 
     for (int axis : {0, 1, 2})
     {
-        forEachVoxelRange(Vec3i(0), materialFaceLabels.size(axis), [&](const Vec3i& face) {
-            if (materialFaceLabels(face, axis) == MaterialLabels::LIQUID_FACE)
+        forEachVoxelRange(Vec3i(0), materialFaceLabels[axis].size(), [&](const Vec3i& face) {
+            if (materialFaceLabels[axis](face) == MaterialLabels::LIQUID_FACE)
                 liquidFaceIndices(face, axis) = liquidDOFCount++;
         });
     }
@@ -117,213 +126,405 @@ void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& veloc
     // Pre-scale all the control volumes with coefficients to reduce
     // redundant operations when building the linear system.
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, centerVolumes.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = centerVolumes.unflatten(cellIndex);
+    parallelFor(KernelClass::LIGHT, 0, centerVolumes.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = centerVolumes.unflatten(cellIndex);
 
-                              if (centerVolumes(cell) > 0) centerVolumes(cell) *= 2. * discreteScalar * viscosity(cell);
-                          }
-                      });
+                        if (centerVolumes(cell) > 0) centerVolumes(cell) *= 2. * discreteScalar * viscosity(cell);
+                    }
+                });
 
     for (int edgeAxis : {0, 1, 2})
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, edgeVolumes.grid(edgeAxis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int edgeIndex = range.begin(); edgeIndex != range.end(); ++edgeIndex)
-                              {
-                                  Vec3i edge = edgeVolumes.grid(edgeAxis).unflatten(edgeIndex);
-
-                                  if (edgeVolumes(edge, edgeAxis) > 0)
-                                      edgeVolumes(edge, edgeAxis) *=
-                                          discreteScalar *
-                                          viscosity.interp(edgeVolumes.indexToWorld(Vec3f(edge), edgeAxis));
-                              }
-                          });
+        parallelFor(KernelClass::LIGHT, 0, edgeVolumes.grid(edgeAxis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int edgeIndex = range.begin(); edgeIndex != range.end(); ++edgeIndex)
+                        {
+                            Vec3i edge = edgeVolumes.grid(edgeAxis).unflatten(edgeIndex);
+
+                            if (edgeVolumes(edge, edgeAxis) > 0)
+                                edgeVolumes(edge, edgeAxis) *=
+                                    discreteScalar *
+                                    viscosity.interp(edgeVolumes.indexToWorld(Vec3f(edge), edgeAxis));
+                        }
+                    });
     }
 
-    std::vector<Eigen::Triplet<SolveReal>> sparseElements;
-    Vector initialGuessVector = Vector::Zero(liquidDOFCount);
-    Vector rhsVector = Vector::Zero(liquidDOFCount);
+    initialGuessVector = Vector::Zero(liquidDOFCount);
+    rhsVector = Vector::Zero(liquidDOFCount);
+    faceMasses = Vector::Zero(liquidDOFCount);
 
-    {
-        tbb::enumerable_thread_specific<std::vector<Eigen::Triplet<SolveReal>>> parallelSparseElements;
+    // Build the row for a liquid face. A row couples the face to at most two neighbours through the
+    // cell stresses and twelve through the edge stresses.
+    using RowEntries = SparseRowAccumulator<SolveReal, 16>;
 
-        for (int faceAxis : {0, 1, 2})
+    auto buildFaceRow = [&](const Vec3i& face, int faceAxis, RowEntries& rowEntries, SolveReal& rhs) {
+        int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
+        assert(liquidFaceIndex >= 0);
+
+        rowEntries.clear();
+
+        // Build RHS with volume weights
+        SolveReal localFaceVolume = faceVolumes(face, faceAxis);
+
+        rhs = localFaceVolume * velocity(face, faceAxis);
+
+        // Add volume weight to diagonal
+        SolveReal diagonal = localFaceVolume;
+
+        // Build cell centered stress terms
+        for (int divergenceDirection : {0, 1})
         {
-            tbb::parallel_for(
-                tbb::blocked_range<int>(0, materialFaceLabels.grid(faceAxis).voxelCount(), tbbLightGrainSize),
-                [&](const tbb::blocked_range<int>& range) {
-                    auto& localSparseElements = parallelSparseElements.local();
+            Vec3i cell = faceToCell(face, faceAxis, divergenceDirection);
+
+            assert(cell[faceAxis] >= 0 && cell[faceAxis] < centerVolumes.size()[faceAxis]);
+
+            SolveReal divergenceSign = (divergenceDirection == 0) ? -1 : 1;
+
+            if (centerVolumes(cell) > 0)
+            {
+                for (int gradientDirection : {0, 1})
+                {
+                    Vec3i adjacentFace = cellToFace(cell, faceAxis, gradientDirection);
+
+                    SolveReal gradientSign = (gradientDirection == 0) ? -1. : 1.;
+
+                    SolveReal coefficient = divergenceSign * gradientSign * centerVolumes(cell);
 
-                    for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                    int adjacentFaceIndex = liquidFaceIndices(adjacentFace, faceAxis);
+                    if (adjacentFaceIndex >= 0)
                     {
-                        Vec3i face = materialFaceLabels.grid(faceAxis).unflatten(faceIndex);
+                        if (adjacentFaceIndex == liquidFaceIndex)
+                            diagonal -= coefficient;
+                        else
+                            rowEntries.add(adjacentFaceIndex, -coefficient);
+                    }
+                    else if (materialFaceLabels[faceAxis](adjacentFace) == MaterialLabels::SOLID_FACE)
+                        rhs += coefficient * solidVelocity(adjacentFace, faceAxis);
+                    else
+                        assert(materialFaceLabels[faceAxis](adjacentFace) == MaterialLabels::AIR_FACE);
+                }
+            }
+        }
 
-                        int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
+        for (int edgeAxis : {0, 1, 2})
+        {
+            if (edgeAxis == faceAxis) continue;
 
-                        if (liquidFaceIndex >= 0)
-                        {
-                            assert(materialFaceLabels(face, faceAxis) == MaterialLabels::LIQUID_FACE);
+            for (int divergenceDirection : {0, 1})
+            {
+                Vec3i edge = faceToEdge(face, faceAxis, edgeAxis, divergenceDirection);
 
-                            // Use old velocity as an initial guess since we're solving for a new
-                            // velocity field with viscous forces applied to the old velocity field.
-                            initialGuessVector(liquidFaceIndex) = velocity(face, faceAxis);
+                if (edgeVolumes(edge, edgeAxis) > 0)
+                {
+                    SolveReal divergenceSign = (divergenceDirection == 0) ? -1 : 1;
 
-                            // Build RHS with volume weights
-                            SolveReal localFaceVolume = faceVolumes(face, faceAxis);
+                    for (int gradientAxis : {0, 1, 2})
+                    {
+                        if (gradientAxis == edgeAxis) continue;
 
-                            rhsVector(liquidFaceIndex) = localFaceVolume * velocity(face, faceAxis);
+                        int gradientFaceAxis = 3 - gradientAxis - edgeAxis;
 
-                            // Add volume weight to diagonal
-                            SolveReal diagonal = localFaceVolume;
+                        for (int gradientDirection : {0, 1})
+                        {
+                            SolveReal gradientSign = (gradientDirection == 0) ? -1 : 1;
 
-                            // Build cell centered stress terms
-                            for (int divergenceDirection : {0, 1})
-                            {
-                                Vec3i cell = faceToCell(face, faceAxis, divergenceDirection);
-
-                                assert(cell[faceAxis] >= 0 && cell[faceAxis] < centerVolumes.size()[faceAxis]);
-
-                                SolveReal divergenceSign = (divergenceDirection == 0) ? -1 : 1;
-
-                                if (centerVolumes(cell) > 0)
-                                {
-                                    for (int gradientDirection : {0, 1})
-                                    {
-                                        Vec3i adjacentFace = cellToFace(cell, faceAxis, gradientDirection);
-
-                                        SolveReal gradientSign = (gradientDirection == 0) ? -1. : 1.;
-
-                                        SolveReal coefficient = divergenceSign * gradientSign * centerVolumes(cell);
-
-                                        int adjacentFaceIndex = liquidFaceIndices(adjacentFace, faceAxis);
-                                        if (adjacentFaceIndex >= 0)
-                                        {
-                                            if (adjacentFaceIndex == liquidFaceIndex)
-                                                diagonal -= coefficient;
-                                            else
-                                                localSparseElements.emplace_back(liquidFaceIndex, adjacentFaceIndex,
-                                                                                 -coefficient);
-                                        }
-                                        else if (materialFaceLabels(adjacentFace, faceAxis) ==
-                                                 MaterialLabels::SOLID_FACE)
-                                            rhsVector(liquidFaceIndex) +=
-                                                coefficient * solidVelocity(adjacentFace, faceAxis);
-                                        else
-                                            assert(materialFaceLabels(adjacentFace, faceAxis) ==
-                                                   MaterialLabels::AIR_FACE);
-                                    }
-                                }
-                            }
+                            Vec3i localGradientFace = edgeToFace(edge, edgeAxis, gradientFaceAxis, gradientDirection);
 
-                            for (int edgeAxis : {0, 1, 2})
+                            int gradientFaceIndex = liquidFaceIndices(localGradientFace, gradientFaceAxis);
+
+                            SolveReal coefficient = divergenceSign * gradientSign * edgeVolumes(edge, edgeAxis);
+                            if (gradientFaceIndex >= 0)
                             {
-                                if (edgeAxis == faceAxis) continue;
-
-                                for (int divergenceDirection : {0, 1})
-                                {
-                                    Vec3i edge = faceToEdge(face, faceAxis, edgeAxis, divergenceDirection);
-
-                                    if (edgeVolumes(edge, edgeAxis) > 0)
-                                    {
-                                        SolveReal divergenceSign = (divergenceDirection == 0) ? -1 : 1;
-
-                                        for (int gradientAxis : {0, 1, 2})
-                                        {
-                                            if (gradientAxis == edgeAxis) continue;
-
-                                            int gradientFaceAxis = 3 - gradientAxis - edgeAxis;
-
-                                            for (int gradientDirection : {0, 1})
-                                            {
-                                                SolveReal gradientSign = (gradientDirection == 0) ? -1 : 1;
-
-                                                Vec3i localGradientFace =
-                                                    edgeToFace(edge, edgeAxis, gradientFaceAxis, gradientDirection);
-
-                                                int gradientFaceIndex =
-                                                    liquidFaceIndices(localGradientFace, gradientFaceAxis);
-
-                                                SolveReal coefficient =
-                                                    divergenceSign * gradientSign * edgeVolumes(edge, edgeAxis);
-                                                if (gradientFaceIndex >= 0)
-                                                {
-                                                    if (gradientFaceIndex == liquidFaceIndex)
-                                                        diagonal -= coefficient;
-                                                    else
-                                                        localSparseElements.emplace_back(
-                                                            liquidFaceIndex, gradientFaceIndex, -coefficient);
-                                                }
-                                                else if (materialFaceLabels(localGradientFace, gradientFaceAxis) ==
-                                                         MaterialLabels::SOLID_FACE)
-                                                    rhsVector(liquidFaceIndex) +=
-                                                        coefficient *
-                                                        solidVelocity(localGradientFace, gradientFaceAxis);
-                                                else
-                                                    assert(materialFaceLabels(localGradientFace, gradientFaceAxis) ==
-                                                           MaterialLabels::AIR_FACE);
-                                            }
-                                        }
-                                    }
-                                }
+                                if (gradientFaceIndex == liquidFaceIndex)
+                                    diagonal -= coefficient;
+                                else
+                                    rowEntries.add(gradientFaceIndex, -coefficient);
                             }
-
-                            localSparseElements.emplace_back(liquidFaceIndex, liquidFaceIndex, diagonal);
+                            else if (materialFaceLabels[gradientFaceAxis](localGradientFace) ==
+                                     MaterialLabels::SOLID_FACE)
+                                rhs += coefficient * solidVelocity(localGradientFace, gradientFaceAxis);
+                            else
+                                assert(materialFaceLabels[gradientFaceAxis](localGradientFace) ==
+                                       MaterialLabels::AIR_FACE);
                         }
-                        else
-                            assert(materialFaceLabels(face, faceAxis) != MaterialLabels::LIQUID_FACE);
                     }
-                });
+                }
+            }
         }
 
-        mergeLocalThreadVectors(sparseElements, parallelSparseElements);
+        rowEntries.add(liquidFaceIndex, diagonal);
+    };
+
+    // First pass counts the entries of each row, the second writes them into the reserved slices
+    std::vector<int> rowCounts(liquidDOFCount);
+
+    for (int faceAxis : {0, 1, 2})
+    {
+        parallelFor(KernelClass::LIGHT, 0, materialFaceLabels[faceAxis].voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        RowEntries rowEntries;
+                        SolveReal rhs;
+
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = materialFaceLabels[faceAxis].unflatten(faceIndex);
+
+                            int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
+                            if (liquidFaceIndex < 0) continue;
+
+                            buildFaceRow(face, faceAxis, rowEntries, rhs);
+                            rowCounts[liquidFaceIndex] = rowEntries.size();
+                        }
+                    });
     }
 
-    Eigen::SparseMatrix<SolveReal> sparseMatrix(liquidDOFCount, liquidDOFCount);
-    sparseMatrix.setFromTriplets(sparseElements.begin(), sparseElements.end());
+    allocateSparseRows(sparseMatrix, rowCounts);
+
+    for (int faceAxis : {0, 1, 2})
+    {
+        parallelFor(KernelClass::LIGHT, 0, materialFaceLabels[faceAxis].voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        RowEntries rowEntries;
+
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = materialFaceLabels[faceAxis].unflatten(faceIndex);
+
+                            int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
+
+                            if (liquidFaceIndex >= 0)
+                            {
+                                assert(materialFaceLabels[faceAxis](face) == MaterialLabels::LIQUID_FACE);
 
-    Eigen::ConjugateGradient<Eigen::SparseMatrix<SolveReal>, Eigen::Upper | Eigen::Lower> solver;
-    solver.compute(sparseMatrix);
-    solver.setTolerance(1E-3);
+                                // Use old velocity as an initial guess since we're solving for a new
+                                // velocity field with viscous forces applied to the old velocity field.
+                                initialGuessVector(liquidFaceIndex) = velocity(face, faceAxis);
+                                faceMasses(liquidFaceIndex) = faceVolumes(face, faceAxis);
 
-    if (solver.info() != Eigen::Success)
+                                buildFaceRow(face, faceAxis, rowEntries, rhsVector(liquidFaceIndex));
+                                writeSparseRow(sparseMatrix, liquidFaceIndex, rowEntries);
+                            }
+                            else
+                                assert(materialFaceLabels[faceAxis](face) != MaterialLabels::LIQUID_FACE);
+                        }
+                    });
+    }
+}
+
+// Copy the solved face velocities back onto the grid
+static void applyViscositySolution(VectorGrid<float>& velocity, const VectorGrid<int>& liquidFaceIndices,
+                                   const Vector& solutionVector)
+{
+    for (int faceAxis : {0, 1, 2})
     {
-        std::cout << "   Solver failed to build" << std::endl;
-        return;
+        parallelFor(KernelClass::LIGHT, 0, liquidFaceIndices.grid(faceAxis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = liquidFaceIndices.grid(faceAxis).unflatten(faceIndex);
+
+                            int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
+                            if (liquidFaceIndex >= 0) velocity(face, faceAxis) = solutionVector(liquidFaceIndex);
+                        }
+                    });
     }
+}
+
+void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity, const LevelSet& solidSurface,
+                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity,
+                     ConjugateGradientVariant variant, ViscosityPreconditioner preconditioner,
+                     const SolverTolerance& tolerance)
+{
+    VectorGrid<int> liquidFaceIndices;
+    Eigen::SparseMatrix<SolveReal> sparseMatrix;
+    Vector rhsVector, initialGuessVector, faceMasses;
+
+    buildViscositySystem(dt, surface, velocity, solidSurface, solidVelocity, viscosity, liquidFaceIndices,
+                         sparseMatrix, rhsVector, initialGuessVector, faceMasses);
+
+    Vector solutionVector;
+
+    if (preconditioner == ViscosityPreconditioner::MULTIGRID)
+    {
+        ViscosityMultigrid multigrid(sparseMatrix, liquidFaceIndices);
+
+        std::cout << "    Multigrid levels: " << multigrid.levelCount() << ", coarsest unknowns: "
+                  << multigrid.unknownCount(multigrid.levelCount() - 1) << std::endl;
+
+        solutionVector = initialGuessVector;
 
-    Vector solutionVector = solver.solveWithGuess(rhsVector, initialGuessVector);
+        int iterations;
+        double error;
 
-    if (solver.info() != Eigen::Success)
+        if (!solvePreconditionedConjugateGradient(SymmetricSparseOperator(sparseMatrix), multigrid, rhsVector,
+                                                  solutionVector, tolerance, iterations, error))
+        {
+            std::cout << "   Solver failed to converge" << std::endl;
+            return;
+        }
+
+        std::cout << "    Solver iterations:     " << iterations << std::endl;
+        std::cout << "    Solver error: " << error << std::endl;
+    }
+    // Eigen's solver only knows the relative rule
+    else if (variant == ConjugateGradientVariant::PIPELINED ||
+             tolerance.mode() != SolverTolerance::Mode::RELATIVE_RESIDUAL)
     {
-        std::cout << "   Solver failed to converge" << std::endl;
-        return;
+        solutionVector = initialGuessVector;
+
+        int iterations;
+        double error;
+
+        SymmetricSparseOperator matrixOperator(sparseMatrix);
+
+        bool isSolved = variant == ConjugateGradientVariant::PIPELINED
+                            ? solvePipelinedConjugateGradient(matrixOperator, rhsVector, solutionVector, tolerance,
+                                                              iterations, error)
+                            : solvePreconditionedConjugateGradient(matrixOperator, JacobiPreconditioner(matrixOperator),
+                                                                   rhsVector, solutionVector, tolerance, iterations,
+                                                                   error);
+
+        if (!isSolved)
+        {
+            std::cout << "   Solver failed to converge" << std::endl;
+            return;
+        }
+
+        std::cout << "    Solver iterations:     " << iterations << std::endl;
+        std::cout << "    Solver error: " << error << std::endl;
     }
     else
     {
-        std::cout << "    Solver iterations:     " << solver.iterations() << std::endl;
-        std::cout << "    Solver error: " << solver.error() << std::endl;
+        Eigen::ConjugateGradient<Eigen::SparseMatrix<SolveReal>, Eigen::Upper | Eigen::Lower> solver;
+        solver.compute(sparseMatrix);
+        solver.setTolerance(tolerance.tolerance());
+
+        if (solver.info() != Eigen::Success)
+        {
+            std::cout << "   Solver failed to build" << std::endl;
+            return;
+        }
+
+        solutionVector = solver.solveWithGuess(rhsVector, initialGuessVector);
+
+        if (solver.info() != Eigen::Success)
+        {
+            std::cout << "   Solver failed to converge" << std::endl;
+            return;
+        }
+        else
+        {
+            std::cout << "    Solver iterations:     " << solver.iterations() << std::endl;
+            std::cout << "    Solver error: " << solver.error() << std::endl;
+        }
+    }
+
+    applyViscositySolution(velocity, liquidFaceIndices, solutionVector);
+}
+
+float viscousDiffusionNumber(float dt, const ScalarGrid<float>& viscosity)
+{
+    float maxViscosity = parallelReduce(
+        KernelClass::LIGHT, 0, viscosity.voxelCount(), 0.f,
+        [&](const tbb::blocked_range<int>& range, float localMax) -> float {
+            for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                localMax = std::max(localMax, viscosity(viscosity.unflatten(cellIndex)));
+            return localMax;
+        },
+        [](float x, float y) -> float { return std::max(x, y); });
+
+    return maxViscosity * dt / sqr(viscosity.dx());
+}
+
+int ExplicitViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity,
+                            const LevelSet& solidSurface, const VectorGrid<float>& solidVelocity,
+                            const ScalarGrid<float>& viscosity, int maxSubsteps)
+{
+    assert(maxSubsteps > 0);
+
+    VectorGrid<int> liquidFaceIndices;
+    Eigen::SparseMatrix<SolveReal> sparseMatrix;
+    Vector rhsVector, initialGuessVector, faceMasses;
+
+    buildViscositySystem(dt, surface, velocity, solidSurface, solidVelocity, viscosity, liquidFaceIndices,
+                         sparseMatrix, rhsVector, initialGuessVector, faceMasses);
+
+    int liquidDOFCount = faceMasses.size();
+
+    if (liquidDOFCount == 0) return 0;
+
+    // Gershgorin bound on the eigenvalues of dt M^-1 K, where the matrix is M + dt K. Forward Euler is
+    // stable while a substep keeps them at or below two. Faces with no liquid volume have no mass to
+    // step so they can't be updated explicitly at all.
+    SolveReal maxRate = parallelReduce(
+        KernelClass::LIGHT, 0, liquidDOFCount, SolveReal(0),
+        [&](const tbb::blocked_range<int>& range, SolveReal localMax) -> SolveReal {
+            for (int row = range.begin(); row != range.end(); ++row)
+            {
+                if (faceMasses(row) <= 0) return std::numeric_limits<SolveReal>::infinity();
+
+                SolveReal rowSum = 0;
+                for (Eigen::SparseMatrix<SolveReal>::InnerIterator it(sparseMatrix, row); it; ++it)
+                    rowSum += std::fabs(it.row() == row ? it.value() - faceMasses(row) : it.value());
+
+                localMax = std::max(localMax, rowSum / faceMasses(row));
+            }
+            return localMax;
+        },
+        [](SolveReal x, SolveReal y) -> SolveReal { return std::max(x, y); });
+
+    // Counted in floating point since small cut faces can push it past the range of an int
+    SolveReal requiredSubsteps = std::max(std::ceil(maxRate / 2.), SolveReal(1));
+
+    if (!(requiredSubsteps <= maxSubsteps))
+    {
+        std::cout << "    Explicit viscosity needs " << requiredSubsteps << " substeps. Solving implicitly"
+                  << std::endl;
+        return 0;
     }
 
-    for (int faceAxis : {0, 1, 2})
+    int substeps = int(requiredSubsteps);
+
+    // The right-hand side is M u_old + dt b, where b comes from the moving solid faces
+    Vector solidTerms = rhsVector - faceMasses.cwiseProduct(initialGuessVector);
+
+    SymmetricSparseOperator stressOperator(sparseMatrix);
+
+    Vector solutionVector = initialGuessVector;
+    Vector product(liquidDOFCount);
+
+    for (int substep = 0; substep < substeps; ++substep)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, materialFaceLabels.grid(faceAxis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = materialFaceLabels.grid(faceAxis).unflatten(faceIndex);
-
-                                  int liquidFaceIndex = liquidFaceIndices(face, faceAxis);
-                                  if (liquidFaceIndex >= 0)
-                                  {
-                                      assert(materialFaceLabels(face, faceAxis) == MaterialLabels::LIQUID_FACE);
-                                      velocity(face, faceAxis) = solutionVector(liquidFaceIndex);
-                                  }
-                              }
-                          });
+        stressOperator.apply(solutionVector, product);
+
+        parallelFor(KernelClass::LIGHT, 0, liquidDOFCount, [&](const tbb::blocked_range<int>& range) {
+            for (int row = range.begin(); row != range.end(); ++row)
+            {
+                SolveReal stressForce = solidTerms(row) - (product(row) - faceMasses(row) * solutionVector(row));
+                solutionVector(row) += stressForce / (substeps * faceMasses(row));
+            }
+        });
     }
+
+    std::cout << "    Explicit viscosity substeps: " << substeps << std::endl;
+
+    applyViscositySolution(velocity, liquidFaceIndices, solutionVector);
+
+    return substeps;
+}
+
+void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity, const LevelSet& solidSurface,
+                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity,
+                     const ExecutionContext& context, ConjugateGradientVariant variant,
+                     ViscosityPreconditioner preconditioner, const SolverTolerance& tolerance)
+{
+    context.execute([&] {
+        ViscositySolver(dt, surface, velocity, solidSurface, solidVelocity, viscosity, variant, preconditioner,
+                        tolerance);
+    });
 }
 
 }  // namespace FluidSim3D::SimTools
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef LIBRARY_VISCOSITY_SOLVER_H
 #define LIBRARY_VISCOSITY_SOLVER_H
 
+#include "ConjugateGradient.h"
 #include "LevelSet.h"
 #include "ScalarGrid.h"
 #include "Utilities.h"
@@ -24,8 +25,44 @@ namespace FluidSim3D::SimTools
 using namespace SurfaceTrackers;
 using namespace Utilities;
 
+// MULTIGRID preconditions CG with a V-cycle of ViscosityMultigrid. It always uses the standard CG
+// recurrences, whatever the variant.
+enum class ViscosityPreconditioner
+{
+    JACOBI,
+    MULTIGRID
+};
+
+// MAX_RESIDUAL tolerances are in units of velocity times the liquid volume fraction of the face.
+// RELATIVE_TO_PREVIOUS has to be resolved by the caller.
+void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity, const LevelSet& solidSurface,
+                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity,
+                     ConjugateGradientVariant variant = ConjugateGradientVariant::STANDARD,
+                     ViscosityPreconditioner preconditioner = ViscosityPreconditioner::JACOBI,
+                     const SolverTolerance& tolerance = SolverTolerance());
+
 void ViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity, const LevelSet& solidSurface,
-                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity);
+                     const VectorGrid<float>& solidVelocity, const ScalarGrid<float>& viscosity,
+                     const ExecutionContext& context,
+                     ConjugateGradientVariant variant = ConjugateGradientVariant::STANDARD,
+                     ViscosityPreconditioner preconditioner = ViscosityPreconditioner::JACOBI,
+                     const SolverTolerance& tolerance = SolverTolerance());
+
+// Largest viscosity * dt / dx^2 on the grid. A face fully inside the liquid couples to its two cells
+// with weight 2 and to its four edges with weight 1 times this number, which gives a Gershgorin row
+// sum of 24 times the number. The explicit solver needs half that many substeps, so at least twelve
+// times the number, and faces only partly inside the liquid need more.
+float viscousDiffusionNumber(float dt, const ScalarGrid<float>& viscosity);
+
+// Explicit update with the same stress discretisation and volume weights as ViscositySolver. The step
+// is split into as many forward Euler substeps as the stress operator needs to stay stable with the
+// actual face masses and no linear system is solved. Small cut faces can need far more substeps than
+// a full face and faces with no liquid volume can't be stepped at all, so if the step needs more than
+// maxSubsteps the velocity is left untouched and zero is returned for the caller to solve implicitly.
+// Otherwise returns the number of substeps taken.
+int ExplicitViscositySolver(float dt, const LevelSet& surface, VectorGrid<float>& velocity,
+                            const LevelSet& solidSurface, const VectorGrid<float>& solidVelocity,
+                            const ScalarGrid<float>& viscosity, int maxSubsteps);
 }  // namespace FluidSim3D::SimTools
 
 #endif
\ No newline at end of file
@@ -91,18 +91,18 @@ TriMesh makeSphereMesh(const Vec3f& center, float radius, float dx)
 
     LevelSet sphereSDF(xform, gridSize);
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, sphereSDF.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = sphereSDF.unflatten(cellIndex);
-                              Vec3f worldPoint = sphereSDF.indexToWorld(Vec3f(cell));
-                              float phi = sqrt(sqr(worldPoint[0] - center[0]) + sqr(worldPoint[1] - center[1]) +
-                                               sqr(worldPoint[2] - center[2])) -
-                                          radius;
-                              sphereSDF(cell) = phi;
-                          }
-                      });
+    parallelFor(KernelClass::LIGHT, 0, sphereSDF.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = sphereSDF.unflatten(cellIndex);
+                        Vec3f worldPoint = sphereSDF.indexToWorld(Vec3f(cell));
+                        float phi = sqrt(sqr(worldPoint[0] - center[0]) + sqr(worldPoint[1] - center[1]) +
+                                         sqr(worldPoint[2] - center[2])) -
+                                    radius;
+                        sphereSDF(cell) = phi;
+                    }
+                });
 
     return sphereSDF.buildMesh();
 }
@@ -8,201 +8,6 @@
 
 namespace FluidSim3D::SurfaceTrackers
 {
-// Helper function to project a point to a triangle in 3-D
-Vec3f pointToTriangleProjection(const Vec3f& point, const Vec3f& vertex0, const Vec3f& vertex1, const Vec3f& vertex2)
-{
-    // Normal form
-    Vec3f E0 = vertex1 - vertex0, E1 = vertex2 - vertex0;
-
-    Vec3f D = vertex0 - point;
-
-    float a = dot(E0, E0), b = dot(E0, E1), c = dot(E1, E1);
-    float d = dot(E0, D), e = dot(E1, D), f = dot(D, D);
-
-    // TODO: check on abs with determinant incase of sign inversion
-    float det = std::fabs(a * c - b * b);
-    float s = b * e - c * d;
-    float t = b * d - a * e;
-
-    // Logic tree to account for the point projection into the various regions.
-    // Method borrowed from https://www.geometrictools.com/Documentation/DistancePoint3Triangle3.pdf
-    // 	and https://www.mathworks.com/matlabcentral/fileexchange/22857-distance-between-a-point-and-a-triangle-in-3d
-    //
-    //  \      |
-    //	 \reg2 |
-    //	  \    |
-    //	   \   |
-    //	    \  |
-    //	     \ |
-    //	      *P2
-    //	       |\
-	//	       | \
-	//	  reg3 |  \ reg1
-    //	       |   \
-	//	       |reg0\
-	// 	       |     \
-	//         |      \ P1
-    //  -------*-------*------->s
-    //	       | P0     \
-	//    reg4 | reg5    \ reg6
-
-    if (s + t <= det)
-    {
-        if (s < 0)
-        {
-            if (t < 0)  // region 4
-            {
-                if (d < 0)
-                {
-                    t = 0;
-                    if (-d >= a)
-                        s = 1;
-                    else
-                        s = -d / a;
-                }
-                else
-                {
-                    s = 0;
-                    if (e >= 0)
-                        t = 0;
-                    else
-                    {
-                        if (-e >= c)
-                            t = 1;
-                        else
-                            t = -e / c;
-                    }
-                }
-            }
-            else  // region 3
-            {
-                s = 0;
-                if (e >= 0)
-                    t = 0;
-                else
-                {
-                    if (-e >= c)
-                        t = 1;
-                    else
-                        t = -e / c;
-                }
-            }
-        }
-        else if (t < 0)  // region 5
-        {
-            t = 0;
-            if (d >= 0)
-                s = 0;
-            else
-            {
-                if (-d >= a)
-                    s = 1;
-                else
-                    s = -d / a;
-            }
-        }
-        else  // region 0
-        {
-            s = s / det;
-            t = t / det;
-        }
-    }
-    else
-    {
-        if (s < 0)  // region 2
-        {
-            float tmp0 = b + d;
-            float tmp1 = c + e;
-            if (tmp1 > tmp0)
-            {
-                float numer = tmp1 - tmp0;
-                float denom = a - 2. * b + c;
-                if (numer >= denom)
-                {
-                    s = 1;
-                    t = 0;
-                }
-                else
-                {
-                    s = numer / denom;
-                    t = 1 - s;
-                }
-            }
-            else
-            {
-                s = 0;
-                if (tmp1 <= 0)
-                    t = 1;
-                else
-                {
-                    if (e >= 0)
-                        t = 0;
-                    else
-                        t = -e / c;
-                }
-            }
-        }
-        else if (t < 0)  // region 6
-        {
-            float tmp0 = b + e;
-            float tmp1 = a + d;
-            if (tmp1 > tmp0)
-            {
-                float numer = tmp1 - tmp0;
-                float denom = a - 2. * b + c;
-                if (numer >= denom)
-                {
-                    t = 1;
-                    s = 0;
-                }
-                else
-                {
-                    t = numer / denom;
-                    s = 1 - t;
-                }
-            }
-            else
-            {
-                t = 0;
-                if (tmp1 <= 0)
-                    s = 1;
-                else
-                {
-                    if (d >= 0)
-                        s = 0;
-                    else
-                        s = -d / a;
-                }
-            }
-        }
-        else  // region 1
-        {
-            float numer = c + e - b - d;
-            if (numer <= 0)
-            {
-                s = 0;
-                t = 1;
-            }
-            else
-            {
-                float denom = a - 2. * b + c;
-                if (numer >= denom)
-                {
-                    s = 1;
-                    t = 0;
-                }
-                else
-                {
-                    s = numer / denom;
-                    t = 1 - s;
-                }
-            }
-        }
-    }
-
-    return Vec3f(vertex0 + s * E0 + t * E1);
-}
-
 void LevelSet::drawGrid(Renderer& renderer, bool doOnlyNarrowBand) const
 {
     if (doOnlyNarrowBand)
@@ -303,59 +108,72 @@ Vec3f LevelSet::findSurfaceIndex(const Vec3f& indexPoint, int iterationLimit) co
 
 void LevelSet::reinit()
 {
-    ScalarGrid<float> tempPhiGrid = myPhiGrid;
-
     UniformGrid<VisitedCellLabels> reinitializedCells(size(), VisitedCellLabels::UNVISITED_CELL);
 
-    // Find zero crossings
-    tbb::parallel_for(tbb::blocked_range<int>(0, myPhiGrid.voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = myPhiGrid.unflatten(cellIndex);
+    // Find zero crossings. findSurface reads the whole grid so the new distances wait in a list until
+    // every crossing is found. Only cells at the interface are stored instead of a second full grid.
+    using CellDistance = std::pair<int, float>;
+    tbb::enumerable_thread_specific<std::vector<CellDistance>> parallelInterfaceDistances;
 
-                              bool isAtZeroCrossing = false;
-                              for (int axis = 0; axis < 3 && !isAtZeroCrossing; ++axis)
-                                  for (int direction : {0, 1})
-                                  {
-                                      Vec3i adjacentCell = cellToCell(cell, axis, direction);
+    parallelFor(KernelClass::LIGHT, 0, myPhiGrid.voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    auto& localInterfaceDistances = parallelInterfaceDistances.local();
 
-                                      if (adjacentCell[axis] < 0 || adjacentCell[axis] >= size()[axis]) continue;
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = myPhiGrid.unflatten(cellIndex);
 
-                                      if ((myPhiGrid(cell) <= 0 && myPhiGrid(adjacentCell) > 0) ||
-                                          (myPhiGrid(cell) > 0 && myPhiGrid(adjacentCell) <= 0))
-                                      {
-                                          isAtZeroCrossing = true;
+                        bool isAtZeroCrossing = false;
+                        for (int axis = 0; axis < 3 && !isAtZeroCrossing; ++axis)
+                            for (int direction : {0, 1})
+                            {
+                                Vec3i adjacentCell = cellToCell(cell, axis, direction);
 
-                                          Vec3f worldPoint = indexToWorld(Vec3f(cell));
-                                          Vec3f interfacePoint = findSurface(worldPoint, 5);
+                                if (adjacentCell[axis] < 0 || adjacentCell[axis] >= size()[axis]) continue;
 
-                                          float distance = dist(worldPoint, interfacePoint);
+                                if ((myPhiGrid(cell) <= 0 && myPhiGrid(adjacentCell) > 0) ||
+                                    (myPhiGrid(cell) > 0 && myPhiGrid(adjacentCell) <= 0))
+                                {
+                                    isAtZeroCrossing = true;
 
-                                          tempPhiGrid(cell) = myPhiGrid(cell) < 0. ? -distance : distance;
-                                          reinitializedCells(cell) = VisitedCellLabels::FINISHED_CELL;
+                                    Vec3f worldPoint = indexToWorld(Vec3f(cell));
+                                    Vec3f interfacePoint = findSurface(worldPoint, 5);
 
-                                          break;
-                                      }
-                                  }
+                                    float distance = dist(worldPoint, interfacePoint);
+
+                                    localInterfaceDistances.emplace_back(cellIndex,
+                                                                         myPhiGrid(cell) < 0. ? -distance : distance);
+                                    reinitializedCells(cell) = VisitedCellLabels::FINISHED_CELL;
+
+                                    break;
+                                }
+                            }
+                    }
+                });
 
-                              // Set unvisited grid cells to background value, using old grid for inside/outside sign
-                              if (!isAtZeroCrossing)
-                              {
-                                  assert(reinitializedCells(cell) == VisitedCellLabels::UNVISITED_CELL);
-                                  tempPhiGrid(cell) = myPhiGrid(cell) < 0. ? -myNarrowBand : myNarrowBand;
-                              }
-                          }
-                      });
+    // Set every grid cell to the background value, using the old value for inside/outside sign, and then
+    // put the interface distances back
+    float narrowBand = myNarrowBand;
+    mapGrids(
+        myPhiGrid, [narrowBand](float phi) { return phi < 0. ? -narrowBand : narrowBand; }, myPhiGrid);
+
+    std::vector<CellDistance> interfaceDistances;
+    mergeLocalThreadVectors(interfaceDistances, parallelInterfaceDistances);
+
+    parallelFor(KernelClass::LIGHT, 0, int(interfaceDistances.size()), [&](const tbb::blocked_range<int>& range) {
+        for (int index = range.begin(); index != range.end(); ++index)
+        {
+            const CellDistance& interfaceDistance = interfaceDistances[index];
+            myPhiGrid(myPhiGrid.unflatten(interfaceDistance.first)) = interfaceDistance.second;
+        }
+    });
 
-    std::swap(myPhiGrid, tempPhiGrid);
     reinitFastMarching(reinitializedCells);
 }
 
-void LevelSet::initFromMesh(const TriMesh& initialMesh, bool doResizeGrid)
+void LevelSet::scanConvertMesh(const TriMesh& initialMesh, bool doResizeGrid,
+                               UniformGrid<VisitedCellLabels>& reinitializedCells, UniformGrid<int>& meshCellParities)
 {
-    // TODO: make parallel!!
-
     if (doResizeGrid)
     {
         // Determine the bounding box of the mesh to build the underlying grids
@@ -383,70 +201,101 @@ void LevelSet::initFromMesh(const TriMesh& initialMesh, bool doResizeGrid)
 
     // We want to track which cells in the level set contain valid distance information.
     // The first pass will set cells close to the mesh as FINISHED.
-    UniformGrid<VisitedCellLabels> reinitializedCells(size(), VisitedCellLabels::UNVISITED_CELL);
-    UniformGrid<int> meshCellParities(size(), 0);
+    reinitializedCells = UniformGrid<VisitedCellLabels>(size(), VisitedCellLabels::UNVISITED_CELL);
+    meshCellParities = UniformGrid<int>(size(), 0);
+
+    // The edge crossing tests only read the mesh, so triangles are tested in parallel
+    // and the resulting parity changes are applied afterwards. This keeps the crossing
+    // count in each z-column independent of the order the triangles are visited in.
+    std::vector<std::pair<Vec3i, int>> parityChanges;
+    std::vector<Vec3i> onMeshCells;
 
-    for (const auto& triFace : initialMesh.triFaces())
     {
-        // It's easier to work in our index space and just scale the distance later.
-        std::array<Vec3f, 3> triVertices;
-        for (int localVertexIndex : {0, 1, 2})
-            triVertices[localVertexIndex] = worldToIndex(initialMesh.vertex(triFace.vertex(localVertexIndex)).point());
+        tbb::enumerable_thread_specific<std::vector<std::pair<Vec3i, int>>> parallelParityChanges;
+        tbb::enumerable_thread_specific<std::vector<Vec3i>> parallelOnMeshCells;
 
-        // Degerate check
-        for (int localVertexIndex : {0, 1, 2})
-        {
-            if (triVertices[localVertexIndex] == triVertices[(localVertexIndex + 1) % 3]) continue;
-        }
+        parallelFor(
+            KernelClass::HEAVY, 0, initialMesh.triFaceCount(),
+            [&](const tbb::blocked_range<int>& range) {
+                auto& localParityChanges = parallelParityChanges.local();
+                auto& localOnMeshCells = parallelOnMeshCells.local();
 
-        // Record mesh-grid intersections between cell nodes (i.e. on grid edges)
-        // Since we only cast rays *left-to-right* for inside/outside checking, we don't
-        // need to know if the mesh intersects y-aligned grid edges
-        Vec3f minVertexBB(triVertices[0]), maxVertexBB(triVertices[0]);
+                for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
+                {
+                    const TriFace& triFace = initialMesh.triFace(triFaceIndex);
 
-        for (int localVertexIndex : {1, 2}) updateMinAndMax(minVertexBB, maxVertexBB, triVertices[localVertexIndex]);
+                    // It's easier to work in our index space and just scale the distance later.
+                    std::array<Vec3f, 3> triVertices;
+                    for (int localVertexIndex : {0, 1, 2})
+                        triVertices[localVertexIndex] =
+                            worldToIndex(initialMesh.vertex(triFace.vertex(localVertexIndex)).point());
 
-        Vec3i ceilMin = Vec3i(ceil(minVertexBB));
-        Vec3i floorMin = Vec3i(floor(minVertexBB)) - Vec3i(1);
-        Vec3i floorMax = Vec3i(floor(maxVertexBB));
+                    // Record mesh-grid intersections between cell nodes (i.e. on grid edges)
+                    // Since we only cast rays *left-to-right* for inside/outside checking, we don't
+                    // need to know if the mesh intersects y-aligned grid edges
+                    Vec3f minVertexBB(triVertices[0]), maxVertexBB(triVertices[0]);
 
-        // Z-axis intersection tests. Iterate along an aligned set of grid edges
-        // in decsending order, checking for intersections at each edge.
-        // If an intersection is found then we can stop searching along the set.
-        for (int i = ceilMin[0]; i <= floorMax[0]; ++i)
-            for (int j = ceilMin[1]; j <= floorMax[1]; ++j)
-                for (int k = floorMax[2]; k >= floorMin[2]; --k)
-                {
-                    Vec3f gridPoint(i, j, k);
-                    IntersectionLabels intersectionResult =
-                        exactTriIntersect(gridPoint, triVertices[0], triVertices[1], triVertices[2], Axis::ZAXIS);
+                    for (int localVertexIndex : {1, 2})
+                        updateMinAndMax(minVertexBB, maxVertexBB, triVertices[localVertexIndex]);
 
-                    if (intersectionResult == IntersectionLabels::NO) continue;
+                    Vec3i ceilMin = Vec3i(ceil(minVertexBB));
+                    Vec3i floorMin = Vec3i(floor(minVertexBB)) - Vec3i(1);
+                    Vec3i floorMax = Vec3i(floor(maxVertexBB));
 
-                    int parityChange = 0;
-                    float qrs = orient2d(triVertices[0].data(), triVertices[1].data(), triVertices[2].data());
-                    if (qrs < 0)
-                        parityChange = 1;
-                    else
+                    // Only the columns inside the grid are tracked. This lets a mesh that extends past the
+                    // grid along x or y (such as the global mesh over a slab of the domain) be scan converted.
+                    for (int axis : {0, 1})
                     {
-                        assert(qrs > 0);
-                        parityChange = -1;
+                        ceilMin[axis] = std::max(ceilMin[axis], 0);
+                        floorMax[axis] = std::min(floorMax[axis], size()[axis] - 1);
                     }
 
-                    if (intersectionResult == IntersectionLabels::YES) meshCellParities(i, j, k + 1) += parityChange;
-                    // If the grid node is explicitly on the mesh-edge, set distance to zero
-                    // since it might not be exactly zero due to floating point error above.
-                    else
-                    {
-                        assert(intersectionResult == IntersectionLabels::ON);
+                    // The winding of the projected triangle doesn't depend on the grid edge
+                    int qrs = orient2dSign(triVertices[0].data(), triVertices[1].data(), triVertices[2].data());
 
-                        reinitializedCells(i, j, k) = VisitedCellLabels::FINISHED_CELL;
-                        myPhiGrid(i, j, k) = 0.;
-                        meshCellParities(i, j, k) += parityChange;
-                    }
+                    // Z-axis intersection tests. Iterate along an aligned set of grid edges
+                    // in decsending order, checking for intersections at each edge.
+                    // If an intersection is found then we can stop searching along the set.
+                    for (int i = ceilMin[0]; i <= floorMax[0]; ++i)
+                        for (int j = ceilMin[1]; j <= floorMax[1]; ++j)
+                            for (int k = floorMax[2]; k >= floorMin[2]; --k)
+                            {
+                                Vec3f gridPoint(i, j, k);
+                                IntersectionLabels intersectionResult = exactTriIntersect(
+                                    gridPoint, triVertices[0], triVertices[1], triVertices[2], Axis::ZAXIS);
+
+                                if (intersectionResult == IntersectionLabels::NO) continue;
+
+                                assert(qrs != 0);
+                                int parityChange = qrs < 0 ? 1 : -1;
+
+                                if (intersectionResult == IntersectionLabels::YES)
+                                    localParityChanges.emplace_back(Vec3i(i, j, k + 1), parityChange);
+                                // If the grid node is explicitly on the mesh-edge, set distance to zero
+                                // since it might not be exactly zero due to floating point error above.
+                                else
+                                {
+                                    assert(intersectionResult == IntersectionLabels::ON);
 
-                    break;
+                                    localOnMeshCells.emplace_back(i, j, k);
+                                    localParityChanges.emplace_back(Vec3i(i, j, k), parityChange);
+                                }
+
+                                break;
+                            }
                 }
+            });
+
+        mergeLocalThreadVectors(parityChanges, parallelParityChanges);
+        mergeLocalThreadVectors(onMeshCells, parallelOnMeshCells);
+    }
+
+    for (const auto& parityChange : parityChanges) meshCellParities(parityChange.first) += parityChange.second;
+
+    for (const Vec3i& cell : onMeshCells)
+    {
+        reinitializedCells(cell) = VisitedCellLabels::FINISHED_CELL;
+        myPhiGrid(cell) = 0.;
     }
 
     // Now that all the z-axis edge crossings have been found, we can compile the parity changes
@@ -484,6 +333,14 @@ void LevelSet::initFromMesh(const TriMesh& initialMesh, bool doResizeGrid)
                 if (isCellInside != isAdjacentCellInside) reinitializedCells(cell) = VisitedCellLabels::FINISHED_CELL;
             }
     });
+}
+
+void LevelSet::initFromMesh(const TriMesh& initialMesh, bool doResizeGrid)
+{
+    UniformGrid<VisitedCellLabels> reinitializedCells;
+    UniformGrid<int> meshCellParities;
+
+    scanConvertMesh(initialMesh, doResizeGrid, reinitializedCells, meshCellParities);
 
     // Loop over all the triangles in the mesh. Level set grid cells labelled as FINISHED will be
     // updated with the distance to the surface if it happens to be shorter than the current
@@ -526,6 +383,38 @@ void LevelSet::initFromMesh(const TriMesh& initialMesh, bool doResizeGrid)
     reinitFastMarching(reinitializedCells);
 }
 
+void LevelSet::initFromMesh(const TriMeshBVH& meshBVH, bool doResizeGrid)
+{
+    UniformGrid<VisitedCellLabels> reinitializedCells;
+    UniformGrid<int> meshCellParities;
+
+    scanConvertMesh(meshBVH.mesh(), doResizeGrid, reinitializedCells, meshCellParities);
+
+    // Each cell at the interface queries the hierarchy for its nearest triangle instead of
+    // every triangle stamping its bounding box. Cells are independent so this is done in parallel.
+    parallelFor(KernelClass::HEAVY, 0, voxelCount(), [&](const tbb::blocked_range<int>& range) {
+        for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+        {
+            Vec3i cell = unflatten(cellIndex);
+
+            if (reinitializedCells(cell) == VisitedCellLabels::UNVISITED_CELL) continue;
+
+            Vec3f worldPoint = indexToWorld(Vec3f(cell));
+
+            Vec3f nearestPoint;
+            if (meshBVH.nearestTriFace(worldPoint, std::fabs(myPhiGrid(cell)), nearestPoint) >= 0)
+            {
+                float surfaceDistance = dist(worldPoint, nearestPoint);
+
+                // If the parity says the node is inside, set it to be negative
+                myPhiGrid(cell) = (meshCellParities(cell) > 0) ? -surfaceDistance : surfaceDistance;
+            }
+        }
+    });
+
+    reinitFastMarching(reinitializedCells);
+}
+
 Vec3f LevelSet::interpolateInterface(const Vec3i& startPoint, const Vec3i& endPoint) const
 {
     assert((myPhiGrid(startPoint) <= 0 && myPhiGrid(endPoint) > 0) ||
@@ -543,19 +432,22 @@ void LevelSet::unionSurface(const LevelSet& unionPhi)
 {
     assert(isGridMatched(unionPhi));
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int index = range.begin(); index != range.end(); ++index)
-                          {
-                              Vec3i cell = myPhiGrid.unflatten(index);
-                              if (unionPhi(cell) < 2 * unionPhi.dx())
-                                  myPhiGrid(cell) = std::min(myPhiGrid(cell), unionPhi(cell));
-                          }
-                      });
+    float unionBand = 2 * unionPhi.dx();
+
+    mapGrids(
+        myPhiGrid,
+        [unionBand](float phi, float addedPhi) { return addedPhi < unionBand ? std::min(phi, addedPhi) : phi; },
+        myPhiGrid, unionPhi.myPhiGrid);
 
     reinitMesh();
 }
 
+void LevelSet::stampSurface(const LevelSet& sourceSurface)
+{
+    stampSurface(sourceSurface.worldMin(), sourceSurface.worldMax(),
+                 [&](const Vec3f& worldPoint) { return sourceSurface.interpOrBackground(worldPoint); });
+}
+
 TriMesh LevelSet::buildMesh() const
 {
     // Create grid to store index to dual contouring point. Note that phi is
@@ -566,87 +458,87 @@ TriMesh LevelSet::buildMesh() const
 
     // Build list of dual contouring points
     {
-        tbb::enumerable_thread_specific<std::vector<std::pair<Vec3i, Vec3f>>> parallelDCPoints;
-
-        tbb::parallel_for(tbb::blocked_range<int>(0, dcPointIndices.voxelCount(), tbbHeavyGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              auto& localDCPoints = parallelDCPoints.local();
-
-                              for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                              {
-                                  Vec3i cell = dcPointIndices.unflatten(cellIndex);
-
-                                  std::vector<Vec3f> qefPoints;
-                                  std::vector<Vec3f> qefNormals;
-
-                                  for (int edgeAxis : {0, 1, 2})
-                                      for (int edgeIndex = 0; edgeIndex < 4; ++edgeIndex)
-                                      {
-                                          Vec3i edge = cellToEdge(cell, edgeAxis, edgeIndex);
-
-                                          Vec3i backwardNode = edgeToNode(edge, edgeAxis, 0);
-                                          Vec3i forwardNode = edgeToNode(edge, edgeAxis, 1);
-
-                                          // Look for zero crossings.
-                                          // Note that nodes for the DC grid fall exactly on the cell centers
-                                          // of the level set grid.
-                                          if ((myPhiGrid(backwardNode) <= 0 && myPhiGrid(forwardNode) > 0) ||
-                                              (myPhiGrid(backwardNode) > 0 && myPhiGrid(forwardNode) <= 0))
-                                          {
-                                              // Find interface point
-                                              Vec3f interfacePoint = interpolateInterface(backwardNode, forwardNode);
-                                              qefPoints.push_back(interfacePoint);
-
-                                              // Find associated surface normal
-                                              Vec3f surfaceNormal = normal(indexToWorld(interfacePoint));
-                                              qefNormals.push_back(surfaceNormal);
-                                          }
-                                      }
-
-                                  if (qefPoints.size() > 0)
-                                  {
-                                      assert(qefPoints.size() > 2);
-
-                                      Eigen::MatrixXd A(qefPoints.size(), 3);
-                                      Eigen::VectorXd b(qefPoints.size());
-                                      Eigen::VectorXd pointCOM = Eigen::VectorXd::Zero(3);
-
-                                      for (int pointIndex = 0; pointIndex < qefPoints.size(); ++pointIndex)
-                                      {
-                                          for (int axis : {0, 1, 2})
-                                          {
-                                              A(pointIndex, axis) = qefNormals[pointIndex][axis];
-                                              pointCOM[axis] += qefPoints[pointIndex][axis];
-                                          }
-
-                                          b(pointIndex) = dot(qefNormals[pointIndex], qefPoints[pointIndex]);
-                                      }
-
-                                      pointCOM /= double(qefPoints.size());
-
-                                      // TODO: clamp singular values?
-                                      Eigen::JacobiSVD<Eigen::MatrixXd> svd(A,
-                                                                            Eigen::ComputeThinU | Eigen::ComputeThinV);
-                                      svd.setThreshold(1E-2);
-
-                                      Eigen::VectorXd dcPoint = pointCOM + svd.solve(b - A * pointCOM);
-
-                                      Vec3d vecCOM(pointCOM[0], pointCOM[1], pointCOM[2]);
-
-                                      // Because we set the DC point indices is a seperate loop, the DC points must
-                                      // remain in their own cell to properly index.
-                                      Vec3d boundingBoxMin = Vec3d(cell);
-                                      Vec3d boundingBoxMax = Vec3d(cell) + Vec3d(1);
-
-                                      if (dcPoint[0] < boundingBoxMin[0] || dcPoint[1] < boundingBoxMin[1] ||
-                                          dcPoint[2] < boundingBoxMin[2] || dcPoint[0] >= boundingBoxMax[0] ||
-                                          dcPoint[1] >= boundingBoxMax[1] || dcPoint[2] >= boundingBoxMax[2])
-                                          dcPoint = pointCOM;
-
-                                      localDCPoints.emplace_back(cell, Vec3f(dcPoint[0], dcPoint[1], dcPoint[2]));
-                                  }
-                              }
-                          });
+        OrderedLocalThreadVectors<std::pair<Vec3i, Vec3f>> parallelDCPoints;
+
+        parallelFor(KernelClass::HEAVY, 0, dcPointIndices.voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        auto& localDCPoints = parallelDCPoints.local(range.begin());
+
+                        for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                        {
+                            Vec3i cell = dcPointIndices.unflatten(cellIndex);
+
+                            std::vector<Vec3f> qefPoints;
+                            std::vector<Vec3f> qefNormals;
+
+                            for (int edgeAxis : {0, 1, 2})
+                                for (int edgeIndex = 0; edgeIndex < 4; ++edgeIndex)
+                                {
+                                    Vec3i edge = cellToEdge(cell, edgeAxis, edgeIndex);
+
+                                    Vec3i backwardNode = edgeToNode(edge, edgeAxis, 0);
+                                    Vec3i forwardNode = edgeToNode(edge, edgeAxis, 1);
+
+                                    // Look for zero crossings.
+                                    // Note that nodes for the DC grid fall exactly on the cell centers
+                                    // of the level set grid.
+                                    if ((myPhiGrid(backwardNode) <= 0 && myPhiGrid(forwardNode) > 0) ||
+                                        (myPhiGrid(backwardNode) > 0 && myPhiGrid(forwardNode) <= 0))
+                                    {
+                                        // Find interface point
+                                        Vec3f interfacePoint = interpolateInterface(backwardNode, forwardNode);
+                                        qefPoints.push_back(interfacePoint);
+
+                                        // Find associated surface normal
+                                        Vec3f surfaceNormal = normal(indexToWorld(interfacePoint));
+                                        qefNormals.push_back(surfaceNormal);
+                                    }
+                                }
+
+                            if (qefPoints.size() > 0)
+                            {
+                                assert(qefPoints.size() > 2);
+
+                                Eigen::MatrixXd A(qefPoints.size(), 3);
+                                Eigen::VectorXd b(qefPoints.size());
+                                Eigen::VectorXd pointCOM = Eigen::VectorXd::Zero(3);
+
+                                for (int pointIndex = 0; pointIndex < qefPoints.size(); ++pointIndex)
+                                {
+                                    for (int axis : {0, 1, 2})
+                                    {
+                                        A(pointIndex, axis) = qefNormals[pointIndex][axis];
+                                        pointCOM[axis] += qefPoints[pointIndex][axis];
+                                    }
+
+                                    b(pointIndex) = dot(qefNormals[pointIndex], qefPoints[pointIndex]);
+                                }
+
+                                pointCOM /= double(qefPoints.size());
+
+                                // TODO: clamp singular values?
+                                Eigen::JacobiSVD<Eigen::MatrixXd> svd(A,
+                                                                      Eigen::ComputeThinU | Eigen::ComputeThinV);
+                                svd.setThreshold(1E-2);
+
+                                Eigen::VectorXd dcPoint = pointCOM + svd.solve(b - A * pointCOM);
+
+                                Vec3d vecCOM(pointCOM[0], pointCOM[1], pointCOM[2]);
+
+                                // Because we set the DC point indices is a seperate loop, the DC points must
+                                // remain in their own cell to properly index.
+                                Vec3d boundingBoxMin = Vec3d(cell);
+                                Vec3d boundingBoxMax = Vec3d(cell) + Vec3d(1);
+
+                                if (dcPoint[0] < boundingBoxMin[0] || dcPoint[1] < boundingBoxMin[1] ||
+                                    dcPoint[2] < boundingBoxMin[2] || dcPoint[0] >= boundingBoxMax[0] ||
+                                    dcPoint[1] >= boundingBoxMax[1] || dcPoint[2] >= boundingBoxMax[2])
+                                    dcPoint = pointCOM;
+
+                                localDCPoints.emplace_back(cell, Vec3f(dcPoint[0], dcPoint[1], dcPoint[2]));
+                            }
+                        }
+                    });
 
         mergeLocalThreadVectors(dcPointPair, parallelDCPoints);
     }
@@ -655,19 +547,19 @@ TriMesh LevelSet::buildMesh() const
 
     // Set DC point index for direct look up when building mesh and
     // convert points to world space.
-    tbb::parallel_for(tbb::blocked_range<int>(0, dcPointPair.size(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int index = range.begin(); index != range.end(); ++index)
-                          {
-                              const Vec3i& cell = dcPointPair[index].first;
+    parallelFor(KernelClass::LIGHT, 0, dcPointPair.size(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int index = range.begin(); index != range.end(); ++index)
+                    {
+                        const Vec3i& cell = dcPointPair[index].first;
 
-                              assert(dcPointIndices(cell) == -1);
-                              dcPointIndices(cell) = index;
+                        assert(dcPointIndices(cell) == -1);
+                        dcPointIndices(cell) = index;
 
-                              const Vec3f& point = dcPointPair[index].second;
-                              vertices[index] = indexToWorld(point);
-                          }
-                      });
+                        const Vec3f& point = dcPointPair[index].second;
+                        vertices[index] = indexToWorld(point);
+                    }
+                });
 
     // Build triangle mesh using dual contouring points
 
@@ -681,14 +573,15 @@ TriMesh LevelSet::buildMesh() const
 
         Vec3i end(dcPointIndices.size());
 
-        tbb::enumerable_thread_specific<std::vector<Vec3i>> parallelTriFaces;
+        OrderedLocalThreadVectors<Vec3i> parallelTriFaces;
 
+        int grain = grainSize3D(KernelClass::LIGHT);
         auto loopRange3d =
-            tbb::blocked_range3d<int>(start[0], end[0], std::cbrt(tbbLightGrainSize), start[1], end[1],
-                                      std::cbrt(tbbLightGrainSize), start[2], end[2], std::cbrt(tbbLightGrainSize));
+            tbb::blocked_range3d<int>(start[0], end[0], grain, start[1], end[1], grain, start[2], end[2], grain);
 
-        tbb::parallel_for(loopRange3d, [&](const tbb::blocked_range3d<int>& range) {
-            auto& localTriFaces = parallelTriFaces.local();
+        parallelFor(KernelClass::LIGHT, loopRange3d, [&](const tbb::blocked_range3d<int>& range) {
+            Vec3i rangeStart(range.pages().begin(), range.rows().begin(), range.cols().begin());
+            auto& localTriFaces = parallelTriFaces.local(dcPointIndices.flatten(rangeStart));
 
             Vec3i edge;
             for (edge[0] = range.pages().begin(); edge[0] != range.pages().end(); ++edge[0])
@@ -1,12 +1,15 @@
 #ifndef LIBRARY_LEVEL_SET_H
 #define LIBRARY_LEVEL_SET_H
 
+#include "tbb/blocked_range3d.h"
+
 #include "FieldAdvector.h"
 #include "Predicates.h"
 #include "Renderer.h"
 #include "ScalarGrid.h"
 #include "Transform.h"
 #include "TriMesh.h"
+#include "TriMeshBVH.h"
 #include "Utilities.h"
 #include "Vec.h"
 #include "VectorGrid.h"
@@ -50,6 +53,10 @@ public:
 
     void initFromMesh(const TriMesh& initialMesh, bool resizeGrid = true);
 
+    // Same as above but distances near the interface come from nearest-triangle queries
+    // on the hierarchy rather than stamping every triangle's bounding box into the grid.
+    void initFromMesh(const TriMeshBVH& meshBVH, bool resizeGrid = true);
+
     void reinit();
     void reinitFIM();
     void reinitMesh()
@@ -65,7 +72,8 @@ public:
         return true;
     }
 
-    bool isGridMatched(const ScalarGrid<float>& grid) const
+    template <typename T>
+    bool isGridMatched(const ScalarGrid<T>& grid) const
     {
         if (grid.sampleType() != ScalarGridSettings::SampleType::CENTER) return false;
         if (size() != grid.size()) return false;
@@ -75,6 +83,20 @@ public:
 
     void unionSurface(const LevelSet& unionPhi);
 
+    // Union the source into this level set over only the cells covered by the source grid.
+    // Unlike unionSurface, there is no dense pass or redistancing so the cost scales with
+    // the size of the source rather than the size of this grid.
+    void stampSurface(const LevelSet& sourceSurface);
+
+    // Union an implicit surface into the cells overlapping the world space box. The sampler
+    // must return a signed distance for any world point in the box.
+    template <typename SurfaceSampler>
+    void stampSurface(const Vec3f& worldMin, const Vec3f& worldMax, const SurfaceSampler& sampler);
+
+    // World space positions of the first and last sample points
+    Vec3f worldMin() const { return indexToWorld(Vec3f(0)); }
+    Vec3f worldMax() const { return indexToWorld(Vec3f(size() - Vec3i(1))); }
+
     bool isBackgroundNegative() const { return myIsBackgroundNegative; }
     void setBackgroundNegative() { myIsBackgroundNegative = true; }
 
@@ -107,7 +129,25 @@ public:
     Vec3f indexToWorld(const Vec3f& indexPoint) const { return myPhiGrid.indexToWorld(indexPoint); }
     Vec3f worldToIndex(const Vec3f& worldPoint) const { return myPhiGrid.worldToIndex(worldPoint); }
 
-    float interp(const Vec3f& worldPoint) const { return myPhiGrid.interp(worldPoint); }
+    // The distance grid is always cell centered and clamped at the border
+    float interp(const Vec3f& worldPoint) const
+    {
+        return myPhiGrid.interp<ScalarGridSettings::SampleType::CENTER, ScalarGridSettings::BorderType::CLAMP>(
+            worldPoint);
+    }
+
+    // Points outside of the grid return the narrow band distance with the sign of the background
+    float interpOrBackground(const Vec3f& worldPoint) const
+    {
+        Vec3f indexPoint = worldToIndex(worldPoint);
+        for (int axis : {0, 1, 2})
+        {
+            if (indexPoint[axis] < 0 || indexPoint[axis] > float(size()[axis] - 1))
+                return myIsBackgroundNegative ? -myNarrowBand : myNarrowBand;
+        }
+
+        return interp(worldPoint);
+    }
 
     float& operator()(int i, int j, int k) { return myPhiGrid(i, j, k); }
     float& operator()(const Vec3i& cell) { return myPhiGrid(cell); }
@@ -115,6 +155,10 @@ public:
     const float& operator()(int i, int j, int k) const { return myPhiGrid(i, j, k); }
     const float& operator()(const Vec3i& cell) const { return myPhiGrid(cell); }
 
+    // The samples as a grid, for fused sweeps with mapGrids. Callers mustn't resize it.
+    ScalarGrid<float>& grid() { return myPhiGrid; }
+    const ScalarGrid<float>& grid() const { return myPhiGrid; }
+
     int voxelCount() const { return myPhiGrid.voxelCount(); }
     Vec3i unflatten(int cellIndex) const { return myPhiGrid.unflatten(cellIndex); }
 
@@ -138,6 +182,11 @@ public:
     void drawSurface(Renderer& renderer, const Vec3f& colour = Vec3f(0.), float lineWidth = 1) const;
 
 private:
+    // Resize the grid to the mesh (if requested), set the sign of every cell from the
+    // z-column crossing parity and label the cells adjacent to a sign change.
+    void scanConvertMesh(const TriMesh& initialMesh, bool doResizeGrid, UniformGrid<VisitedCellLabels>& reinitializedCells,
+                         UniformGrid<int>& meshCellParities);
+
     void reinitFastMarching(UniformGrid<VisitedCellLabels>& interfaceCells);
     void reinitFastIterative(UniformGrid<VisitedCellLabels>& interfaceCells);
 
@@ -151,6 +200,34 @@ private:
     bool myIsBackgroundNegative;
 };
 
+template <typename SurfaceSampler>
+void LevelSet::stampSurface(const Vec3f& worldMin, const Vec3f& worldMax, const SurfaceSampler& sampler)
+{
+    Vec3i cellMin = maxUnion(Vec3i(ceil(worldToIndex(worldMin))), Vec3i(0));
+    Vec3i cellMax = minUnion(Vec3i(floor(worldToIndex(worldMax))) + Vec3i(1), size());
+
+    for (int axis : {0, 1, 2})
+    {
+        if (cellMin[axis] >= cellMax[axis]) return;
+    }
+
+    int grain = grainSize3D(KernelClass::LIGHT);
+    tbb::blocked_range3d<int> cellRange(cellMin[0], cellMax[0], grain, cellMin[1], cellMax[1], grain, cellMin[2],
+                                        cellMax[2], grain);
+
+    parallelFor(KernelClass::LIGHT, cellRange, [&](const tbb::blocked_range3d<int>& range) {
+        Vec3i cell;
+
+        for (cell[0] = range.pages().begin(); cell[0] != range.pages().end(); ++cell[0])
+            for (cell[1] = range.rows().begin(); cell[1] != range.rows().end(); ++cell[1])
+                for (cell[2] = range.cols().begin(); cell[2] != range.cols().end(); ++cell[2])
+                {
+                    float sourcePhi = sampler(indexToWorld(Vec3f(cell)));
+                    myPhiGrid(cell) = std::min(myPhiGrid(cell), sourcePhi);
+                }
+    });
+}
+
 }  // namespace FluidSim3D::SurfaceTrackers
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "LevelSetCSG.h"
+
+namespace FluidSim3D::SurfaceTrackers
+{
+LevelSetCSG::LevelSetCSG(const LevelSet& surface)
+{
+    // A negative background fills all of space so there is no finite box to stamp over.
+    assert(!surface.isBackgroundNegative());
+
+    myOperands.push_back(Operand{&surface, Operation::UNION});
+
+    myWorldMin = surface.worldMin();
+    myWorldMax = surface.worldMax();
+}
+
+void LevelSetCSG::addSurface(const LevelSet& surface, Operation operation)
+{
+    assert(!surface.isBackgroundNegative());
+
+    myOperands.push_back(Operand{&surface, operation});
+
+    // Differences can only shrink the shape so the box is left as is.
+    if (operation == Operation::UNION)
+    {
+        myWorldMin = minUnion(myWorldMin, surface.worldMin());
+        myWorldMax = maxUnion(myWorldMax, surface.worldMax());
+    }
+    else if (operation == Operation::INTERSECTION)
+    {
+        myWorldMin = maxUnion(myWorldMin, surface.worldMin());
+        myWorldMax = minUnion(myWorldMax, surface.worldMax());
+    }
+}
+
+float LevelSetCSG::phi(const Vec3f& worldPoint) const
+{
+    float combinedPhi = myOperands[0].mySurface->interpOrBackground(worldPoint);
+
+    for (int operandIndex = 1; operandIndex < int(myOperands.size()); ++operandIndex)
+    {
+        const Operand& operand = myOperands[operandIndex];
+        float operandPhi = operand.mySurface->interpOrBackground(worldPoint);
+
+        if (operand.myOperation == Operation::UNION)
+            combinedPhi = std::min(combinedPhi, operandPhi);
+        else if (operand.myOperation == Operation::INTERSECTION)
+            combinedPhi = std::max(combinedPhi, operandPhi);
+        else
+        {
+            assert(operand.myOperation == Operation::DIFFERENCE);
+            combinedPhi = std::max(combinedPhi, -operandPhi);
+        }
+    }
+
+    return combinedPhi;
+}
+
+void LevelSetCSG::stampInto(LevelSet& surface) const
+{
+    if (isEmpty()) return;
+
+    surface.stampSurface(myWorldMin, myWorldMax, [&](const Vec3f& worldPoint) { return phi(worldPoint); });
+}
+
+}  // namespace FluidSim3D::SurfaceTrackers
@@ -0,0 +1,81 @@
+#ifndef LIBRARY_LEVEL_SET_CSG_H
+#define LIBRARY_LEVEL_SET_CSG_H
+
+#include <vector>
+
+#include "LevelSet.h"
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// LevelSetCSG.h/cpp
+//
+// Lazy constructive solid geometry over
+// level sets. Operands are held by reference
+// and combined left to right only when the
+// result is sampled, so no dense temporary
+// grids are built. Stamping the result into
+// a level set only touches the cells inside
+// the bounding box of the combined shape.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SurfaceTrackers
+{
+using namespace Utilities;
+
+class LevelSetCSG
+{
+public:
+    enum class Operation
+    {
+        UNION,
+        INTERSECTION,
+        DIFFERENCE
+    };
+
+    // The operands must outlive the combiner.
+    explicit LevelSetCSG(const LevelSet& surface);
+
+    void addSurface(const LevelSet& surface, Operation operation);
+
+    void unionSurface(const LevelSet& surface) { addSurface(surface, Operation::UNION); }
+    void intersectSurface(const LevelSet& surface) { addSurface(surface, Operation::INTERSECTION); }
+    void subtractSurface(const LevelSet& surface) { addSurface(surface, Operation::DIFFERENCE); }
+
+    // Signed distance estimate of the combined shape. Exact outside of any overlap
+    // but only a bound where operands overlap, as usual for min/max CSG.
+    float phi(const Vec3f& worldPoint) const;
+
+    // World space box that contains the negative region of the combined shape
+    const Vec3f& worldMin() const { return myWorldMin; }
+    const Vec3f& worldMax() const { return myWorldMax; }
+
+    bool isEmpty() const
+    {
+        for (int axis : {0, 1, 2})
+        {
+            if (myWorldMin[axis] > myWorldMax[axis]) return true;
+        }
+        return false;
+    }
+
+    // Union the combined shape into the surface over the bounding box only.
+    void stampInto(LevelSet& surface) const;
+
+private:
+    struct Operand
+    {
+        const LevelSet* mySurface;
+        Operation myOperation;
+    };
+
+    std::vector<Operand> myOperands;
+
+    Vec3f myWorldMin, myWorldMax;
+};
+
+}  // namespace FluidSim3D::SurfaceTrackers
+
+#endif
@@ -117,6 +117,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <mutex>
 #ifdef CPU86
 #include <float.h>
 #endif /* CPU86 */
@@ -137,11 +138,11 @@ bool zCastIntersection(const Vec3R& a, const Vec3R& q, const Vec3R& r, const Vec
     // adjusted qrs to be CCW itself, so "a" should give CCW for each edge pair as well
 
     // If any of the three tests give CW winding, then the edge does not intersect the triangle
-    REAL pqr = orient2d(a.data(), q.data(), r.data());
+    int pqr = orient2dSign(a.data(), q.data(), r.data());
     if (pqr < 0) return false;
-    REAL prs = orient2d(a.data(), r.data(), s.data());
+    int prs = orient2dSign(a.data(), r.data(), s.data());
     if (prs < 0) return false;
-    REAL psq = orient2d(a.data(), s.data(), q.data());
+    int psq = orient2dSign(a.data(), s.data(), q.data());
     if (psq < 0) return false;
 
     // If "a" projection falls strictly inside the triangle, it easily intersects
@@ -232,7 +233,7 @@ IntersectionLabels exactTriIntersect(Vec3R a, Vec3R q, Vec3R r, Vec3R s, Axis ax
     // testing against is z-axis aligned, we can project qrs onto an xy-plane and test
     // the winding order -- this is done simply by only passing the x,y values
     // to orient2d
-    REAL qrs = orient2d(q.data(), r.data(), s.data());
+    int qrs = orient2dSign(q.data(), r.data(), s.data());
 
     if (qrs == 0)
         return IntersectionLabels::NO;  // qrs and z-axis edge are co-planar so no intersection
@@ -247,7 +248,7 @@ IntersectionLabels exactTriIntersect(Vec3R a, Vec3R q, Vec3R r, Vec3R s, Axis ax
     // Check that grid point is below the triangle's plane.
     // If it's above, there is no intersection.
     // If it is on the plane, we need to decide if it should proceed.
-    REAL pqrs = orient3d(a.data(), q.data(), r.data(), s.data());
+    int pqrs = orient3dSign(a.data(), q.data(), r.data(), s.data());
 
     if (pqrs > 0)
         return IntersectionLabels::NO;
@@ -784,11 +785,8 @@ float uniformfloatrand()
 /*  Don't change this routine unless you fully understand it.                */
 /*                                                                           */
 /*****************************************************************************/
-static bool hasInit = false;
-REAL exactinit()
+static void initErrorBounds()
 {
-    if (hasInit) return epsilon;
-
     REAL half;
     REAL check, lastcheck;
     int every_other;
@@ -855,8 +853,14 @@ REAL exactinit()
     isperrboundA = (16.0 + 224.0 * epsilon) * epsilon;
     isperrboundB = (5.0 + 72.0 * epsilon) * epsilon;
     isperrboundC = (71.0 + 1408.0 * epsilon) * epsilon * epsilon;
+}
 
-    hasInit = true;
+// Every LevelSet calls this on construction, possibly from several threads at once,
+// so the error bounds are only ever written by the first caller.
+static std::once_flag initFlag;
+REAL exactinit()
+{
+    std::call_once(initFlag, initErrorBounds);
 
     return epsilon; /* Added by H. Si 30 Juli, 2004. */
 }
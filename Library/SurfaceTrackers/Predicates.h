@@ -1,6 +1,9 @@
 #ifndef LIBRARY_PREDICATES_H
 #define LIBRARY_PREDICATES_H
 
+#include <cmath>
+#include <limits>
+
 #include "GridUtilities.h"
 #include "Vec.h"
 
@@ -21,6 +24,65 @@ REAL incircle(const REAL* pa, const REAL* pb, const REAL* pc, const REAL* pd);
 
 REAL insphere(const REAL* pa, const REAL* pb, const REAL* pc, const REAL* pd, const REAL* pe);
 
+// Statically filtered orientation tests. Since REAL is float, every input is exactly
+// representable in double and the determinant can be evaluated in double precision
+// against a fixed forward error bound (Shewchuk's "A" bounds with the double epsilon).
+// Only when the sign can't be certified do we fall back to the adaptive exact arithmetic.
+// These only return the sign (-1, 0, 1) and hold no state, so they're safe to call from
+// multiple threads once exactinit() has run.
+namespace PredicateFilters
+{
+constexpr double epsilon = .5 * std::numeric_limits<double>::epsilon();
+constexpr double orient2dErrorBound = (3. + 16. * epsilon) * epsilon;
+constexpr double orient3dErrorBound = (7. + 56. * epsilon) * epsilon;
+}  // namespace PredicateFilters
+
+inline int orient2dSign(const REAL* pa, const REAL* pb, const REAL* pc)
+{
+    double detLeft = (double(pa[0]) - double(pc[0])) * (double(pb[1]) - double(pc[1]));
+    double detRight = (double(pa[1]) - double(pc[1])) * (double(pb[0]) - double(pc[0]));
+    double det = detLeft - detRight;
+
+    double errorBound = PredicateFilters::orient2dErrorBound * (std::fabs(detLeft) + std::fabs(detRight));
+
+    if (det > errorBound) return 1;
+    if (det < -errorBound) return -1;
+
+    REAL exactDet = orient2d(pa, pb, pc);
+    return (exactDet > 0) - (exactDet < 0);
+}
+
+inline int orient3dSign(const REAL* pa, const REAL* pb, const REAL* pc, const REAL* pd)
+{
+    double adx = double(pa[0]) - double(pd[0]);
+    double bdx = double(pb[0]) - double(pd[0]);
+    double cdx = double(pc[0]) - double(pd[0]);
+    double ady = double(pa[1]) - double(pd[1]);
+    double bdy = double(pb[1]) - double(pd[1]);
+    double cdy = double(pc[1]) - double(pd[1]);
+    double adz = double(pa[2]) - double(pd[2]);
+    double bdz = double(pb[2]) - double(pd[2]);
+    double cdz = double(pc[2]) - double(pd[2]);
+
+    double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady, adxcdy = adx * cdy;
+    double adxbdy = adx * bdy, bdxady = bdx * ady;
+
+    double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+
+    double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * std::fabs(adz) +
+                       (std::fabs(cdxady) + std::fabs(adxcdy)) * std::fabs(bdz) +
+                       (std::fabs(adxbdy) + std::fabs(bdxady)) * std::fabs(cdz);
+
+    double errorBound = PredicateFilters::orient3dErrorBound * permanent;
+
+    if (det > errorBound) return 1;
+    if (det < -errorBound) return -1;
+
+    REAL exactDet = orient3d(pa, pb, pc, pd);
+    return (exactDet > 0) - (exactDet < 0);
+}
+
 enum class IntersectionLabels
 {
     YES,
@@ -5,13 +5,207 @@
 
 namespace FluidSim3D::SurfaceTrackers
 {
+// Helper function to project a point to a triangle in 3-D
+Vec3f pointToTriangleProjection(const Vec3f& point, const Vec3f& vertex0, const Vec3f& vertex1, const Vec3f& vertex2)
+{
+    // Normal form
+    Vec3f E0 = vertex1 - vertex0, E1 = vertex2 - vertex0;
+
+    Vec3f D = vertex0 - point;
+
+    float a = dot(E0, E0), b = dot(E0, E1), c = dot(E1, E1);
+    float d = dot(E0, D), e = dot(E1, D), f = dot(D, D);
+
+    // TODO: check on abs with determinant incase of sign inversion
+    float det = std::fabs(a * c - b * b);
+    float s = b * e - c * d;
+    float t = b * d - a * e;
+
+    // Logic tree to account for the point projection into the various regions.
+    // Method borrowed from https://www.geometrictools.com/Documentation/DistancePoint3Triangle3.pdf
+    // 	and https://www.mathworks.com/matlabcentral/fileexchange/22857-distance-between-a-point-and-a-triangle-in-3d
+    //
+    //  \      |
+    //	 \reg2 |
+    //	  \    |
+    //	   \   |
+    //	    \  |
+    //	     \ |
+    //	      *P2
+    //	       |\
+	//	       | \
+	//	  reg3 |  \ reg1
+    //	       |   \
+	//	       |reg0\
+	// 	       |     \
+	//         |      \ P1
+    //  -------*-------*------->s
+    //	       | P0     \
+	//    reg4 | reg5    \ reg6
+
+    if (s + t <= det)
+    {
+        if (s < 0)
+        {
+            if (t < 0)  // region 4
+            {
+                if (d < 0)
+                {
+                    t = 0;
+                    if (-d >= a)
+                        s = 1;
+                    else
+                        s = -d / a;
+                }
+                else
+                {
+                    s = 0;
+                    if (e >= 0)
+                        t = 0;
+                    else
+                    {
+                        if (-e >= c)
+                            t = 1;
+                        else
+                            t = -e / c;
+                    }
+                }
+            }
+            else  // region 3
+            {
+                s = 0;
+                if (e >= 0)
+                    t = 0;
+                else
+                {
+                    if (-e >= c)
+                        t = 1;
+                    else
+                        t = -e / c;
+                }
+            }
+        }
+        else if (t < 0)  // region 5
+        {
+            t = 0;
+            if (d >= 0)
+                s = 0;
+            else
+            {
+                if (-d >= a)
+                    s = 1;
+                else
+                    s = -d / a;
+            }
+        }
+        else  // region 0
+        {
+            s = s / det;
+            t = t / det;
+        }
+    }
+    else
+    {
+        if (s < 0)  // region 2
+        {
+            float tmp0 = b + d;
+            float tmp1 = c + e;
+            if (tmp1 > tmp0)
+            {
+                float numer = tmp1 - tmp0;
+                float denom = a - 2. * b + c;
+                if (numer >= denom)
+                {
+                    s = 1;
+                    t = 0;
+                }
+                else
+                {
+                    s = numer / denom;
+                    t = 1 - s;
+                }
+            }
+            else
+            {
+                s = 0;
+                if (tmp1 <= 0)
+                    t = 1;
+                else
+                {
+                    if (e >= 0)
+                        t = 0;
+                    else
+                        t = -e / c;
+                }
+            }
+        }
+        else if (t < 0)  // region 6
+        {
+            float tmp0 = b + e;
+            float tmp1 = a + d;
+            if (tmp1 > tmp0)
+            {
+                float numer = tmp1 - tmp0;
+                float denom = a - 2. * b + c;
+                if (numer >= denom)
+                {
+                    t = 1;
+                    s = 0;
+                }
+                else
+                {
+                    t = numer / denom;
+                    s = 1 - t;
+                }
+            }
+            else
+            {
+                t = 0;
+                if (tmp1 <= 0)
+                    s = 1;
+                else
+                {
+                    if (d >= 0)
+                        s = 0;
+                    else
+                        s = -d / a;
+                }
+            }
+        }
+        else  // region 1
+        {
+            float numer = c + e - b - d;
+            if (numer <= 0)
+            {
+                s = 0;
+                t = 1;
+            }
+            else
+            {
+                float denom = a - 2. * b + c;
+                if (numer >= denom)
+                {
+                    s = 1;
+                    t = 0;
+                }
+                else
+                {
+                    s = numer / denom;
+                    t = 1 - s;
+                }
+            }
+        }
+    }
+
+    return Vec3f(vertex0 + s * E0 + t * E1);
+}
 
 void TriMesh::initialize(const std::vector<Vec3i>& triFaces, const std::vector<Vec3f>& vertices)
 {
     std::vector<std::pair<int, int>> vertexFacePairs(3 * triFaces.size());
 
     myTriFaces.resize(triFaces.size());
-    tbb::parallel_for(tbb::blocked_range<int>(0, triFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, triFaces.size(), [&](const tbb::blocked_range<int>& range) {
         for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
         {
             myTriFaces[triFaceIndex] = TriFace(triFaces[triFaceIndex]);
@@ -23,14 +217,14 @@ void TriMesh::initialize(const std::vector<Vec3i>& triFaces, const std::vector<V
 
     myVertices.resize(vertices.size());
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, vertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, vertices.size(), [&](const tbb::blocked_range<int>& range) {
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex) myVertices[vertexIndex] = Vertex(vertices[vertexIndex]);
     });
 
     tbb::parallel_sort(vertexFacePairs.begin(), vertexFacePairs.end(),
                         [&](const std::pair<int, int>& pair0, const std::pair<int, int>& pair1) { return pair0.first < pair1.first; });
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, vertexFacePairs.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, vertexFacePairs.size(), [&](const tbb::blocked_range<int>& range) {
         // Advance to next new vertex
         int vertexPairIndex = range.begin();
         if (vertexPairIndex > 0)
@@ -62,7 +256,7 @@ void TriMesh::insertMesh(const TriMesh& mesh)
     myTriFaces.insert(myTriFaces.end(), mesh.myTriFaces.begin(), mesh.myTriFaces.end());
 
     // Update vertices to new tris
-    tbb::parallel_for(tbb::blocked_range<int>(vertexCount, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, vertexCount, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
             for (int neighbourTriFaceIndex = 0; neighbourTriFaceIndex < myVertices[vertexIndex].valence(); ++neighbourTriFaceIndex)
             {
@@ -73,7 +267,7 @@ void TriMesh::insertMesh(const TriMesh& mesh)
             }
     });
 
-    tbb::parallel_for(tbb::blocked_range<int>(triFaceCount, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, triFaceCount, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
         for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
             for (int localVertexIndex : {0, 1, 2})
             {
@@ -88,7 +282,7 @@ std::vector<Vec3f> TriMesh::vertexNormals() const
 {
     std::vector<Vec3f> triFaceWeightedNormals(myTriFaces.size());
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range)
+    parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range)
     {
         for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
         {
@@ -102,7 +296,7 @@ std::vector<Vec3f> TriMesh::vertexNormals() const
 
     std::vector<Vec3f> vertexNormals(myVertices.size());
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
         {
             Vec3f localVertexNormal(0);
@@ -138,7 +332,7 @@ void TriMesh::drawMesh(Renderer& renderer, bool doRenderTriFaces, Vec3f triFaceC
     std::vector<Vec3f> vertexNormals(myVertices.size(), Vec3f(0));
     std::vector<Vec3i> triFaces(myTriFaces.size());
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
         for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
         {
             weightedTriNormals[triFaceIndex] = scaledNormal(triFaceIndex);
@@ -149,7 +343,7 @@ void TriMesh::drawMesh(Renderer& renderer, bool doRenderTriFaces, Vec3f triFaceC
 
     // Accumulate area-weight triangle normals to each vertex and normalize.
     // Set vertex points.
-    tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
         {
             for (int neighbourTriFaceIndex = 0; neighbourTriFaceIndex < myVertices[vertexIndex].valence(); ++neighbourTriFaceIndex)
@@ -172,7 +366,7 @@ void TriMesh::drawMesh(Renderer& renderer, bool doRenderTriFaces, Vec3f triFaceC
         std::vector<Vec3f> startPoints(myTriFaces.size());
         std::vector<Vec3f> endPoints(myTriFaces.size());
 
-        tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+        parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
             for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
             {
                 Vec3f localNormalStart(0);
@@ -198,7 +392,7 @@ void TriMesh::drawMesh(Renderer& renderer, bool doRenderTriFaces, Vec3f triFaceC
         std::vector<Vec3f> startPoints(3 * myTriFaces.size());
         std::vector<Vec3f> endPoints(3 * myTriFaces.size());
 
-        tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+        parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
             for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
                 for (int localStartVertexIndex : {0, 1, 2})
                 {
@@ -241,7 +435,7 @@ bool TriMesh::unitTestMesh() const
 {
     tbb::enumerable_thread_specific<std::vector<Vec2i>> parallelFailedMeshPairs;
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         auto& localFailedMeshPairs = parallelFailedMeshPairs.local();
 
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
@@ -267,7 +461,7 @@ bool TriMesh::unitTestMesh() const
     parallelFailedMeshPairs.clear();
     failedMeshPairs.clear();
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
         auto& localFailedMeshPairs = parallelFailedMeshPairs.local();
 
         for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
@@ -291,7 +485,7 @@ bool TriMesh::unitTestMesh() const
 
     tbb::enumerable_thread_specific<std::vector<int>> parallelNanVertices;
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         auto& localNanVertices = parallelNanVertices.local();
 
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
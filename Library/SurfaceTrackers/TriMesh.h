@@ -204,21 +204,21 @@ public:
     // Reverse winding order
     void reverse()
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myTriFaces.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+        parallelFor(KernelClass::LIGHT, 0, myTriFaces.size(), [&](const tbb::blocked_range<int>& range) {
             for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex) myTriFaces[triFaceIndex].reverse();
         });
     }
 
     void scale(float s)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+        parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
             for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex) myVertices[vertexIndex] *= s;
         });
     }
 
     void translate(const Vec3f& t)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+        parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
             for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex) myVertices[vertexIndex] += t;
         });
     }
@@ -249,10 +249,13 @@ private:
     std::vector<Vertex> myVertices;
 };
 
+// Helper function to project a point to a triangle in 3-D
+Vec3f pointToTriangleProjection(const Vec3f& point, const Vec3f& vertex0, const Vec3f& vertex1, const Vec3f& vertex2);
+
 template <typename VelocityField>
 void TriMesh::advectMesh(float dt, const VelocityField& velocity, IntegrationOrder order)
 {
-    tbb::parallel_for(tbb::blocked_range<int>(0, myVertices.size(), tbbLightGrainSize), [&](const tbb::blocked_range<int>& range) {
+    parallelFor(KernelClass::LIGHT, 0, myVertices.size(), [&](const tbb::blocked_range<int>& range) {
         for (int vertexIndex = range.begin(); vertexIndex != range.end(); ++vertexIndex)
             myVertices[vertexIndex].setPoint(Integrator(dt, myVertices[vertexIndex].point(), velocity, order));
     });
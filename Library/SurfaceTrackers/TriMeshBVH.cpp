@@ -0,0 +1,311 @@
+#include "TriMeshBVH.h"
+
+#include <algorithm>
+#include <array>
+
+#include "tbb/tbb.h"
+
+namespace FluidSim3D::SurfaceTrackers
+{
+// Spread the lower 10 bits of the value so there are two zero bits between each of them
+static unsigned expandBits(unsigned value)
+{
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// 30-bit Morton code for a point in the unit cube
+static unsigned mortonCode(const Vec3f& unitPoint)
+{
+    unsigned code = 0;
+    for (int axis : {0, 1, 2})
+    {
+        unsigned quantized = unsigned(clamp(unitPoint[axis] * 1024.f, 0.f, 1023.f));
+        code |= expandBits(quantized) << (2 - axis);
+    }
+    return code;
+}
+
+static float boxDistanceSquared(const Vec3f& point, const Vec3f& boxMin, const Vec3f& boxMax)
+{
+    float distanceSquared = 0;
+    for (int axis : {0, 1, 2})
+    {
+        float delta = std::max(std::max(boxMin[axis] - point[axis], point[axis] - boxMax[axis]), 0.f);
+        distanceSquared += delta * delta;
+    }
+    return distanceSquared;
+}
+
+// Largest range of triangles that is split serially rather than as parallel tasks
+static constexpr int serialBuildSize = 1000;
+
+// The build splits on Morton bits and falls back to a median split, so the depth is bounded
+// by the 30 code bits plus the log of the largest run of equal codes.
+static constexpr int maxStackSize = 128;
+
+TriMeshBVH::TriMeshBVH(const TriMesh& mesh) : myMesh(mesh)
+{
+    int triFaceCount = myMesh.triFaceCount();
+
+    mySortedTriFaces.resize(triFaceCount);
+    myNodes.resize(std::max(2 * triFaceCount - 1, 0));
+
+    if (triFaceCount == 0) return;
+
+    // Determine the bounding box of the mesh to quantize the Morton codes
+    Vec3f minBoundingBox(std::numeric_limits<float>::max());
+    Vec3f maxBoundingBox(std::numeric_limits<float>::lowest());
+
+    for (const auto& vertex : myMesh.vertices()) updateMinAndMax(minBoundingBox, maxBoundingBox, vertex.point());
+
+    Vec3f boxScale = maxBoundingBox - minBoundingBox;
+    for (int axis : {0, 1, 2}) boxScale[axis] = boxScale[axis] > 0 ? 1.f / boxScale[axis] : 0.f;
+
+    std::vector<std::pair<unsigned, int>> sortedCodes(triFaceCount);
+
+    parallelFor(KernelClass::LIGHT, 0, triFaceCount, [&](const tbb::blocked_range<int>& range) {
+        for (int triFaceIndex = range.begin(); triFaceIndex != range.end(); ++triFaceIndex)
+        {
+            const TriFace& triFace = myMesh.triFace(triFaceIndex);
+
+            Vec3f centroid(0);
+            for (int localVertexIndex : {0, 1, 2}) centroid += myMesh.vertex(triFace.vertex(localVertexIndex)).point();
+            centroid /= 3.f;
+
+            sortedCodes[triFaceIndex] = std::make_pair(mortonCode((centroid - minBoundingBox) * boxScale), triFaceIndex);
+        }
+    });
+
+    // Sorting on the (code, index) pair keeps the layout independent of thread scheduling
+    tbb::parallel_sort(sortedCodes.begin(), sortedCodes.end());
+
+    std::vector<unsigned> mortonCodes(triFaceCount);
+    parallelFor(KernelClass::LIGHT, 0, triFaceCount, [&](const tbb::blocked_range<int>& range) {
+        for (int sortedIndex = range.begin(); sortedIndex != range.end(); ++sortedIndex)
+        {
+            mortonCodes[sortedIndex] = sortedCodes[sortedIndex].first;
+            mySortedTriFaces[sortedIndex] = sortedCodes[sortedIndex].second;
+        }
+    });
+
+    buildNode(0, 0, triFaceCount, mortonCodes);
+}
+
+void TriMeshBVH::buildNode(int nodeIndex, int begin, int end, const std::vector<unsigned>& mortonCodes)
+{
+    assert(end > begin);
+
+    Node& node = myNodes[nodeIndex];
+
+    if (end - begin == 1)
+    {
+        node.myRightChild = -1;
+        node.myTriFace = mySortedTriFaces[begin];
+        setLeafBox(node);
+        return;
+    }
+
+    // Split at the highest bit that differs across the range. Since the codes are sorted,
+    // every code with that bit cleared comes before every code with it set.
+    int split;
+    unsigned differingBits = mortonCodes[begin] ^ mortonCodes[end - 1];
+    if (differingBits == 0)
+        split = begin + (end - begin) / 2;
+    else
+    {
+        unsigned highestBit = 1u << 31;
+        while (!(differingBits & highestBit)) highestBit >>= 1;
+
+        split = std::partition_point(mortonCodes.begin() + begin, mortonCodes.begin() + end,
+                                     [highestBit](unsigned code) { return !(code & highestBit); }) -
+                mortonCodes.begin();
+    }
+
+    assert(split > begin && split < end);
+
+    // The left subtree covers (split - begin) triangles and therefore 2 * (split - begin) - 1 nodes
+    int leftChild = nodeIndex + 1;
+    int rightChild = nodeIndex + 2 * (split - begin);
+
+    node.myRightChild = rightChild;
+    node.myTriFace = -1;
+
+    if (end - begin > serialBuildSize)
+    {
+        tbb::parallel_invoke([&] { buildNode(leftChild, begin, split, mortonCodes); },
+                             [&] { buildNode(rightChild, split, end, mortonCodes); });
+    }
+    else
+    {
+        buildNode(leftChild, begin, split, mortonCodes);
+        buildNode(rightChild, split, end, mortonCodes);
+    }
+
+    setInteriorBox(nodeIndex);
+}
+
+void TriMeshBVH::refit()
+{
+    if (myNodes.empty()) return;
+
+    refitNode(0, myNodes.size());
+}
+
+void TriMeshBVH::refitNode(int nodeIndex, int subtreeNodeCount)
+{
+    Node& node = myNodes[nodeIndex];
+
+    if (node.myRightChild < 0)
+    {
+        setLeafBox(node);
+        return;
+    }
+
+    int leftChild = nodeIndex + 1;
+    int leftNodeCount = node.myRightChild - leftChild;
+    int rightNodeCount = subtreeNodeCount - 1 - leftNodeCount;
+
+    if (subtreeNodeCount > 2 * serialBuildSize)
+    {
+        tbb::parallel_invoke([&] { refitNode(leftChild, leftNodeCount); },
+                             [&] { refitNode(node.myRightChild, rightNodeCount); });
+    }
+    else
+    {
+        refitNode(leftChild, leftNodeCount);
+        refitNode(node.myRightChild, rightNodeCount);
+    }
+
+    setInteriorBox(nodeIndex);
+}
+
+void TriMeshBVH::setLeafBox(Node& node) const
+{
+    const TriFace& triFace = myMesh.triFace(node.myTriFace);
+
+    node.myBoxMin = node.myBoxMax = myMesh.vertex(triFace.vertex(0)).point();
+    for (int localVertexIndex : {1, 2})
+        updateMinAndMax(node.myBoxMin, node.myBoxMax, myMesh.vertex(triFace.vertex(localVertexIndex)).point());
+}
+
+void TriMeshBVH::setInteriorBox(int nodeIndex)
+{
+    Node& node = myNodes[nodeIndex];
+    const Node& leftNode = myNodes[nodeIndex + 1];
+    const Node& rightNode = myNodes[node.myRightChild];
+
+    node.myBoxMin = minUnion(leftNode.myBoxMin, rightNode.myBoxMin);
+    node.myBoxMax = maxUnion(leftNode.myBoxMax, rightNode.myBoxMax);
+}
+
+int TriMeshBVH::nearestTriFace(const Vec3f& point, float maxDistance, Vec3f& nearestPoint) const
+{
+    if (myNodes.empty()) return -1;
+
+    float bestDistanceSquared = maxDistance * maxDistance;
+    int bestTriFace = -1;
+
+    std::array<int, maxStackSize> nodeStack;
+    int stackSize = 0;
+    nodeStack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        int nodeIndex = nodeStack[--stackSize];
+        const Node& node = myNodes[nodeIndex];
+
+        if (boxDistanceSquared(point, node.myBoxMin, node.myBoxMax) >= bestDistanceSquared) continue;
+
+        if (node.myRightChild < 0)
+        {
+            const TriFace& triFace = myMesh.triFace(node.myTriFace);
+
+            Vec3f projectedPoint = pointToTriangleProjection(point, myMesh.vertex(triFace.vertex(0)).point(),
+                                                             myMesh.vertex(triFace.vertex(1)).point(),
+                                                             myMesh.vertex(triFace.vertex(2)).point());
+
+            float distanceSquared = dist2(point, projectedPoint);
+            if (distanceSquared < bestDistanceSquared)
+            {
+                bestDistanceSquared = distanceSquared;
+                bestTriFace = node.myTriFace;
+                nearestPoint = projectedPoint;
+            }
+        }
+        else
+        {
+            // Push the farther child first so the nearer child is visited first
+            // and tightens the search radius sooner.
+            int leftChild = nodeIndex + 1;
+            int rightChild = node.myRightChild;
+
+            float leftDistance = boxDistanceSquared(point, myNodes[leftChild].myBoxMin, myNodes[leftChild].myBoxMax);
+            float rightDistance = boxDistanceSquared(point, myNodes[rightChild].myBoxMin, myNodes[rightChild].myBoxMax);
+
+            if (leftDistance < rightDistance) std::swap(leftChild, rightChild);
+
+            assert(stackSize + 2 <= maxStackSize);
+            nodeStack[stackSize++] = leftChild;
+            nodeStack[stackSize++] = rightChild;
+        }
+    }
+
+    return bestTriFace;
+}
+
+int TriMeshBVH::rayCastParity(const Vec3f& point) const
+{
+    if (myNodes.empty()) return 0;
+
+    int parity = 0;
+
+    std::array<int, maxStackSize> nodeStack;
+    int stackSize = 0;
+    nodeStack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        int nodeIndex = nodeStack[--stackSize];
+        const Node& node = myNodes[nodeIndex];
+
+        // The ray only travels upwards so the box must straddle the point in x and y
+        // and reach at least as high as the point.
+        if (point[0] < node.myBoxMin[0] || point[0] > node.myBoxMax[0] || point[1] < node.myBoxMin[1] ||
+            point[1] > node.myBoxMax[1] || point[2] > node.myBoxMax[2])
+            continue;
+
+        if (node.myRightChild < 0)
+        {
+            const TriFace& triFace = myMesh.triFace(node.myTriFace);
+
+            Vec3f q = myMesh.vertex(triFace.vertex(0)).point();
+            Vec3f r = myMesh.vertex(triFace.vertex(1)).point();
+            Vec3f s = myMesh.vertex(triFace.vertex(2)).point();
+
+            IntersectionLabels intersectionResult = exactTriIntersect(point, q, r, s, Axis::ZAXIS);
+
+            if (intersectionResult == IntersectionLabels::ON) return 1;
+
+            if (intersectionResult == IntersectionLabels::YES)
+            {
+                int qrs = orient2dSign(q.data(), r.data(), s.data());
+                assert(qrs != 0);
+                parity += qrs < 0 ? -1 : 1;
+            }
+        }
+        else
+        {
+            assert(stackSize + 2 <= maxStackSize);
+            nodeStack[stackSize++] = nodeIndex + 1;
+            nodeStack[stackSize++] = node.myRightChild;
+        }
+    }
+
+    return parity;
+}
+
+}  // namespace FluidSim3D::SurfaceTrackers
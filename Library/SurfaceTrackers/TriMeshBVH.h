@@ -0,0 +1,86 @@
+#ifndef LIBRARY_TRI_MESH_BVH_H
+#define LIBRARY_TRI_MESH_BVH_H
+
+#include <vector>
+
+#include "Predicates.h"
+#include "TriMesh.h"
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// TriMeshBVH.h/cpp
+//
+// Bounding volume hierarchy over the
+// triangles of a TriMesh. Built in parallel
+// as a linear BVH: triangle centroids are
+// sorted by Morton code and each node is split
+// at the highest differing bit of its range.
+// Supports nearest-triangle queries and
+// ray-cast parity (inside/outside) queries.
+//
+// The hierarchy holds a reference to the mesh.
+// If the mesh vertices move but the connectivity
+// doesn't change, refit() updates the bounding
+// boxes without rebuilding the tree.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::SurfaceTrackers
+{
+using namespace Utilities;
+
+class TriMeshBVH
+{
+public:
+    explicit TriMeshBVH(const TriMesh& mesh);
+
+    // Recompute node bounding boxes after the mesh vertices have moved.
+    void refit();
+
+    const TriMesh& mesh() const { return myMesh; }
+
+    // Returns the index of the nearest triangle to the point that is strictly closer
+    // than maxDistance. The projection onto that triangle is written to nearestPoint.
+    // If no triangle is close enough, -1 is returned and nearestPoint is untouched.
+    int nearestTriFace(const Vec3f& point, float maxDistance, Vec3f& nearestPoint) const;
+
+    // Cast a ray in the positive z-direction from the point and accumulate the
+    // winding of each triangle hit. Uses the same convention as the level set
+    // scan conversion so that a positive parity means the point is inside the mesh.
+    // A point that lies exactly on the mesh is treated as inside.
+    int rayCastParity(const Vec3f& point) const;
+
+    int nodeCount() const { return myNodes.size(); }
+
+private:
+    struct Node
+    {
+        Vec3f myBoxMin, myBoxMax;
+
+        // Interior nodes store their right child (the left child always immediately
+        // follows the parent). Leaves store -1 and the triangle index instead.
+        int myRightChild;
+        int myTriFace;
+    };
+
+    void buildNode(int nodeIndex, int begin, int end, const std::vector<unsigned>& mortonCodes);
+    void refitNode(int nodeIndex, int subtreeNodeCount);
+
+    void setLeafBox(Node& node) const;
+    void setInteriorBox(int nodeIndex);
+
+    const TriMesh& myMesh;
+
+    // Triangle indices sorted by the Morton code of their centroid
+    std::vector<int> mySortedTriFaces;
+
+    // A range of n triangles uses exactly 2n - 1 nodes so children can be placed
+    // without any shared allocation during the parallel build.
+    std::vector<Node> myNodes;
+};
+
+}  // namespace FluidSim3D::SurfaceTrackers
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LIBRARY_EXECUTION_CONTEXT_H
+#define LIBRARY_EXECUTION_CONTEXT_H
+
+#include <assert.h>
+
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "tbb/task_arena.h"
+#include "tbb/task_scheduler_observer.h"
+
+///////////////////////////////////
+//
+// ExecutionContext.h
+//
+// Where parallel work is allowed to run.
+// The default context runs in whatever arena
+// the caller is already in. An isolated context
+// owns a task arena with its own concurrency
+// limit and can optionally pin the threads that
+// work in it to a set of cores, so several
+// simulations on one node don't compete for
+// the same threads. Copies share the arena.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Utilities
+{
+class ExecutionContext
+{
+public:
+    ExecutionContext() = default;
+
+    // At most maxConcurrency threads (including the calling thread) work in the arena.
+    // If cpus is not empty, threads are pinned to those logical cpus while they work in
+    // the arena and get their old affinity back when they leave. Pinning is Linux only.
+    explicit ExecutionContext(int maxConcurrency, const std::vector<int>& cpus = {})
+        : myArena(std::make_shared<Arena>(maxConcurrency, cpus))
+    {
+    }
+
+    bool isIsolated() const { return bool(myArena); }
+
+    int maxConcurrency() const
+    {
+        return myArena ? myArena->myTaskArena.max_concurrency() : tbb::this_task_arena::max_concurrency();
+    }
+
+    // Run the function, and any parallel work it spawns, inside the context.
+    // Nested calls from inside the same arena run directly.
+    template <typename Function>
+    auto execute(const Function& function) const -> decltype(function())
+    {
+        if (!myArena) return function();
+        return myArena->myTaskArena.execute(function);
+    }
+
+private:
+    class ThreadPinner : public tbb::task_scheduler_observer
+    {
+    public:
+        ThreadPinner(tbb::task_arena& arena, const std::vector<int>& cpus)
+            : tbb::task_scheduler_observer(arena), myCpus(cpus)
+        {
+            observe(true);
+        }
+
+        ~ThreadPinner() { observe(false); }
+
+        void on_scheduler_entry(bool) override
+        {
+#ifdef __linux__
+            cpu_set_t oldCpuSet;
+            CPU_ZERO(&oldCpuSet);
+            pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &oldCpuSet);
+            savedCpuSets().push_back(oldCpuSet);
+
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            for (int cpu : myCpus) CPU_SET(cpu, &cpuSet);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#endif
+        }
+
+        void on_scheduler_exit(bool) override
+        {
+#ifdef __linux__
+            // A thread can leave an arena that it entered before pinning was switched on
+            if (savedCpuSets().empty()) return;
+
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &savedCpuSets().back());
+            savedCpuSets().pop_back();
+#endif
+        }
+
+    private:
+#ifdef __linux__
+        // Threads can work in nested arenas so the old affinities are kept as a stack
+        static std::vector<cpu_set_t>& savedCpuSets()
+        {
+            static thread_local std::vector<cpu_set_t> cpuSets;
+            return cpuSets;
+        }
+#endif
+
+        std::vector<int> myCpus;
+    };
+
+    struct Arena
+    {
+        Arena(int maxConcurrency, const std::vector<int>& cpus) : myTaskArena(maxConcurrency)
+        {
+            assert(maxConcurrency > 0);
+            myTaskArena.initialize();
+
+            if (!cpus.empty()) myPinner = std::make_unique<ThreadPinner>(myTaskArena, cpus);
+        }
+
+        // The pinner must stop observing before the arena goes away
+        tbb::task_arena myTaskArena;
+        std::unique_ptr<ThreadPinner> myPinner;
+    };
+
+    std::shared_ptr<Arena> myArena;
+};
+
+}  // namespace FluidSim3D::Utilities
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef LIBRARY_HALF_H
+#define LIBRARY_HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+///////////////////////////////////
+//
+// Half.h
+//
+// IEEE binary16 storage type for grids of
+// secondary values that don't need float
+// precision. It holds about three significant
+// digits and magnitudes up to 65504; larger
+// values become infinite. Half converts to and
+// from float implicitly and has no arithmetic
+// of its own, so values are always computed in
+// float. By default the conversions are done
+// in software. The USE_F16C build option, off
+// by default since the binary then needs a CPU
+// with F16C, makes them single instructions and
+// the bulk conversions do eight values at a
+// time, with the same round-to-nearest-even
+// result.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Utilities
+{
+inline std::uint16_t floatToHalfBits(float value)
+{
+#ifdef __F16C__
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+
+    std::uint16_t sign = (bits >> 16) & 0x8000;
+    std::uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    // Infinity and NaN, keeping NaNs quiet
+    if (magnitude >= 0x7F800000) return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+
+    // Rounds past the largest half
+    if (magnitude >= 0x477FF000) return sign | 0x7C00;
+
+    // Normal halves. Rebias the exponent from 127 to 15 and round off the low 13 bits of the mantissa.
+    if (magnitude >= 0x38800000)
+    {
+        std::uint32_t half = (magnitude - 0x38000000) >> 13;
+        std::uint32_t remainder = magnitude & 0x1FFF;
+
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;
+
+        return sign | half;
+    }
+
+    // Rounds to zero
+    if (magnitude < 0x33000000) return sign;
+
+    // Subnormal halves count in units of 2^-24
+    std::uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    int shift = 126 - int(magnitude >> 23);
+
+    std::uint32_t half = mantissa >> shift;
+    std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+    std::uint32_t halfway = 1u << (shift - 1);
+
+    if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+
+    return sign | half;
+#endif
+}
+
+inline float halfBitsToFloat(std::uint16_t half)
+{
+#ifdef __F16C__
+    return _cvtsh_ss(half);
+#else
+    std::uint32_t sign = std::uint32_t(half & 0x8000) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1F;
+    std::uint32_t mantissa = half & 0x3FF;
+
+    std::uint32_t bits;
+
+    if (exponent == 0x1F)
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else
+    {
+        // Zero and subnormals are exact in float
+        float value = float(mantissa) * (1.f / 16777216.f);
+        return sign ? -value : value;
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
+#endif
+}
+
+class Half
+{
+public:
+    Half() : myBits(0) {}
+
+    Half(float value) : myBits(floatToHalfBits(value)) {}
+
+    operator float() const { return halfBitsToFloat(myBits); }
+
+    std::uint16_t bits() const { return myBits; }
+
+private:
+    std::uint16_t myBits;
+};
+
+static_assert(sizeof(Half) == 2, "Half has to pack into arrays without padding");
+
+// Bulk conversions for whole grids and rows
+inline void convertValues(const Half* source, float* destination, int count)
+{
+    int index = 0;
+
+#ifdef __F16C__
+    for (; index + 8 <= count; index += 8)
+    {
+        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        _mm256_storeu_ps(destination + index, _mm256_cvtph_ps(halves));
+    }
+#endif
+
+    for (; index < count; ++index) destination[index] = source[index];
+}
+
+inline void convertValues(const float* source, Half* destination, int count)
+{
+    int index = 0;
+
+#ifdef __F16C__
+    for (; index + 8 <= count; index += 8)
+    {
+        __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + index), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), halves);
+    }
+#endif
+
+    for (; index < count; ++index) destination[index] = source[index];
+}
+
+}  // namespace FluidSim3D::Utilities
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef LIBRARY_PACKED_LABEL_GRID_H
+#define LIBRARY_PACKED_LABEL_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// PackedLabelGrid.h
+//
+// Compact alternative to UniformGrid for small
+// enum labels and masks. Each voxel takes
+// BitsPerVoxel bits of a 64-bit word, in the
+// same flattened order as UniformGrid, so a
+// two-state mask is 32x smaller than an enum
+// grid and a three-state label 16x smaller.
+//
+// Reads are plain. A write touches the whole
+// word, so voxels that share a word can't be
+// written from different threads. Parallel
+// writers should go through assign, which
+// hands whole words to each task. Sweeps over
+// one label test a word at a time and skip
+// words without a match.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Utilities
+{
+inline int countTrailingZeros(std::uint64_t word)
+{
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int count = 0;
+    for (; !(word & 1); word >>= 1) ++count;
+    return count;
+#endif
+}
+
+inline int countSetBits(std::uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word; word &= word - 1) ++count;
+    return count;
+#endif
+}
+
+template <typename Label, int BitsPerVoxel>
+class PackedLabelGrid
+{
+    static_assert(BitsPerVoxel == 1 || BitsPerVoxel == 2 || BitsPerVoxel == 4,
+                  "Voxels can't straddle words so the bit count has to divide 64");
+
+public:
+    using Word = std::uint64_t;
+
+    static constexpr int VOXELS_PER_WORD = 64 / BitsPerVoxel;
+
+    PackedLabelGrid() : mySize(Vec3i(0)) {}
+
+    PackedLabelGrid(const Vec3i& size, Label label = Label(0)) { resize(size, label); }
+
+    Label operator()(int i, int j, int k) const { return (*this)(Vec3i(i, j, k)); }
+
+    Label operator()(const Vec3i& coord) const
+    {
+#if !defined(NDEBUG)
+        for (int axis : {0, 1, 2}) assert(coord[axis] >= 0 && coord[axis] < mySize[axis]);
+#endif
+
+        return get(flatten(coord));
+    }
+
+    Label get(int index) const
+    {
+        assert(index >= 0 && index < voxelCount());
+
+        return Label((myWords[wordIndex(index)] >> bitOffset(index)) & VOXEL_MASK);
+    }
+
+    // Not thread safe between voxels in the same word
+    void set(const Vec3i& coord, Label label)
+    {
+#if !defined(NDEBUG)
+        for (int axis : {0, 1, 2}) assert(coord[axis] >= 0 && coord[axis] < mySize[axis]);
+#endif
+
+        set(flatten(coord), label);
+    }
+
+    void set(int index, Label label)
+    {
+        assert(index >= 0 && index < voxelCount());
+
+        Word& word = myWords[wordIndex(index)];
+        word = (word & ~(VOXEL_MASK << bitOffset(index))) | (toBits(label) << bitOffset(index));
+    }
+
+    // Sets every voxel to labelAt(index) in parallel. Each task builds whole words so nothing is shared.
+    template <typename LabelFunctor>
+    void assign(const LabelFunctor& labelAt)
+    {
+        parallelFor(KernelClass::LIGHT, 0, wordCount(), [&](const tbb::blocked_range<int>& range) {
+            for (int wordIndex = range.begin(); wordIndex != range.end(); ++wordIndex)
+            {
+                int begin = wordIndex * VOXELS_PER_WORD;
+                int end = std::min(begin + VOXELS_PER_WORD, voxelCount());
+
+                Word word = 0;
+                for (int index = begin; index != end; ++index)
+                    word |= toBits(labelAt(index)) << ((index - begin) * BitsPerVoxel);
+
+                myWords[wordIndex] = word;
+            }
+        });
+    }
+
+    // Calls body(index) in flattened order for every voxel labelled label in words [wordBegin, wordEnd)
+    template <typename Body>
+    void forEachVoxel(Label label, int wordBegin, int wordEnd, const Body& body) const
+    {
+        assert(wordBegin >= 0 && wordEnd <= wordCount());
+
+        for (int wordIndex = wordBegin; wordIndex != wordEnd; ++wordIndex)
+        {
+            for (Word matches = matchingVoxels(wordIndex, label); matches; matches &= matches - 1)
+                body(wordIndex * VOXELS_PER_WORD + countTrailingZeros(matches) / BitsPerVoxel);
+        }
+    }
+
+    // Parallel over words. body must not write to this grid.
+    template <typename Body>
+    void forEachVoxel(Label label, const Body& body) const
+    {
+        parallelFor(KernelClass::LIGHT, 0, wordCount(), [&](const tbb::blocked_range<int>& range) {
+            forEachVoxel(label, range.begin(), range.end(), body);
+        });
+    }
+
+    int count(Label label) const
+    {
+        return parallelReduce(
+            KernelClass::LIGHT, 0, wordCount(), 0,
+            [&](const tbb::blocked_range<int>& range, int localCount) -> int {
+                for (int wordIndex = range.begin(); wordIndex != range.end(); ++wordIndex)
+                    localCount += countSetBits(matchingVoxels(wordIndex, label));
+
+                return localCount;
+            },
+            [](int count0, int count1) -> int { return count0 + count1; });
+    }
+
+    void clear()
+    {
+        mySize = Vec3i(0);
+        myWords.clear();
+    }
+
+    bool empty() const { return myWords.empty(); }
+
+    void resize(const Vec3i& newSize, Label label = Label(0))
+    {
+#if !defined(NDEBUG)
+        for (int axis : {0, 1, 2}) assert(newSize[axis] >= 0);
+#endif
+
+        mySize = newSize;
+
+        Word filledWord = 0;
+        for (int voxel = 0; voxel < VOXELS_PER_WORD; ++voxel) filledWord |= toBits(label) << (voxel * BitsPerVoxel);
+
+        myWords.assign((voxelCount() + VOXELS_PER_WORD - 1) / VOXELS_PER_WORD, filledWord);
+    }
+
+    const Vec3i& size() const { return mySize; }
+    int voxelCount() const { return mySize[0] * mySize[1] * mySize[2]; }
+    int wordCount() const { return myWords.size(); }
+
+    // Voxels with the same word index share storage
+    int wordIndex(int index) const { return index / VOXELS_PER_WORD; }
+
+    int flatten(const Vec3i& coord) const { return coord[2] + mySize[2] * coord[1] + mySize[2] * mySize[1] * coord[0]; }
+
+    Vec3i unflatten(int index) const
+    {
+        assert(index >= 0 && index < voxelCount());
+
+        Vec3i coord;
+        coord[2] = index % mySize[2];
+
+        index /= mySize[2];
+
+        coord[1] = index % mySize[1];
+        coord[0] = index / mySize[1];
+
+        return coord;
+    }
+
+private:
+    static constexpr Word VOXEL_MASK = (Word(1) << BitsPerVoxel) - 1;
+
+    // The lowest bit of every voxel in a word
+    static constexpr Word LOW_BITS = ~Word(0) / VOXEL_MASK;
+
+    static Word toBits(Label label)
+    {
+        assert((Word(label) & ~VOXEL_MASK) == 0);
+        return Word(label);
+    }
+
+    static int bitOffset(int index) { return (index % VOXELS_PER_WORD) * BitsPerVoxel; }
+
+    // Sets the lowest bit of every voxel in the word that holds label. The bits past the last voxel of the
+    // grid are left clear.
+    Word matchingVoxels(int wordIndex, Label label) const
+    {
+        // Voxels that match are zero after the xor. Folding each voxel's bits down into its lowest bit
+        // leaves that bit clear only for the matches.
+        Word difference = myWords[wordIndex] ^ (toBits(label) * LOW_BITS);
+        for (int shift = 1; shift < BitsPerVoxel; shift *= 2) difference |= difference >> shift;
+
+        Word matches = ~difference & LOW_BITS;
+
+        int voxelsInWord = voxelCount() - wordIndex * VOXELS_PER_WORD;
+        if (voxelsInWord < VOXELS_PER_WORD) matches &= (Word(1) << (voxelsInWord * BitsPerVoxel)) - 1;
+
+        return matches;
+    }
+
+    std::vector<Word> myWords;
+    Vec3i mySize;
+};
+
+// Two-state mask, set voxels are true
+using BitMaskGrid = PackedLabelGrid<bool, 1>;
+
+}  // namespace FluidSim3D::Utilities
+
+#endif
@@ -2,6 +2,7 @@
 #define LIBRARY_SCALAR_GRID_H
 
 #include "GridUtilities.h"
+#include "Half.h"
 #include "Renderer.h"
 #include "Transform.h"
 #include "UniformGrid.h"
@@ -21,6 +22,10 @@
 // too specific for a generic templated
 // grid.
 //
+// Compact storage types like Half are loaded
+// and interpolated in a wider value type (see
+// ScalarGridValue) so only storage shrinks.
+//
 ////////////////////////////////////
 
 namespace FluidSim3D::Utilities
@@ -49,8 +54,53 @@ enum class SampleType
     ZEDGE,
     NODE
 };
+
+// Index space position of the sample inside its cell
+constexpr float sampleOffset(SampleType sampleType, int axis)
+{
+    switch (sampleType)
+    {
+        case SampleType::CENTER:
+            return .5;
+        case SampleType::XFACE:
+            return axis == 0 ? 0 : .5;
+        case SampleType::YFACE:
+            return axis == 1 ? 0 : .5;
+        case SampleType::ZFACE:
+            return axis == 2 ? 0 : .5;
+        case SampleType::XEDGE:
+            return axis == 0 ? .5 : 0;
+        case SampleType::YEDGE:
+            return axis == 1 ? .5 : 0;
+        case SampleType::ZEDGE:
+            return axis == 2 ? .5 : 0;
+        default:
+            return 0;
+    }
+}
 }  // namespace ScalarGridSettings
 
+// Type that samples are loaded, interpolated and reduced in
+template <typename T>
+struct ScalarGridValue
+{
+    using Type = T;
+};
+
+template <>
+struct ScalarGridValue<Half>
+{
+    using Type = float;
+};
+
+// Element-wise conversion between storage types. Half and float have vectorised overloads in Half.h.
+template <typename S, typename T>
+void convertValues(const S* source, T* destination, int count)
+{
+    for (int index = 0; index < count; ++index)
+        destination[index] = T(typename ScalarGridValue<S>::Type(source[index]));
+}
+
 template <typename T>
 class ScalarGrid : public UniformGrid<T>
 {
@@ -58,6 +108,8 @@ class ScalarGrid : public UniformGrid<T>
     using SampleType = ScalarGridSettings::SampleType;
 
 public:
+    using Value = typename ScalarGridValue<T>::Type;
+
     ScalarGrid() : myXform(1., Vec3f(0.)), myGridSize(Vec3i(0)), UniformGrid<T>() {}
 
     ScalarGrid(const Transform& xform, const Vec3i& size, SampleType sampleType = SampleType::CENTER,
@@ -74,43 +126,53 @@ public:
                SampleType sampleType = SampleType::CENTER, BorderType borderType = BorderType::CLAMP)
         : myXform(xform), mySampleType(sampleType), myBorderType(borderType), myGridSize(size)
     {
+        for (int axis : {0, 1, 2}) myCellOffset[axis] = ScalarGridSettings::sampleOffset(sampleType, axis);
+
         switch (sampleType)
         {
             case SampleType::CENTER:
-                myCellOffset = Vec3f(.5);
                 this->resize(size, initialValue);
                 break;
             case SampleType::XFACE:
-                myCellOffset = Vec3f(.0, .5, .5);
                 this->resize(size + Vec3i(1, 0, 0), initialValue);
                 break;
             case SampleType::YFACE:
-                myCellOffset = Vec3f(.5, .0, .5);
                 this->resize(size + Vec3i(0, 1, 0), initialValue);
                 break;
             case SampleType::ZFACE:
-                myCellOffset = Vec3f(.5, .5, .0);
                 this->resize(size + Vec3i(0, 0, 1), initialValue);
                 break;
             case SampleType::XEDGE:
-                myCellOffset = Vec3f(.5, .0, .0);
                 this->resize(size + Vec3i(0, 1, 1), initialValue);
                 break;
             case SampleType::YEDGE:
-                myCellOffset = Vec3f(.0, .5, .0);
                 this->resize(size + Vec3i(1, 0, 1), initialValue);
                 break;
             case SampleType::ZEDGE:
-                myCellOffset = Vec3f(.0, .0, .5);
                 this->resize(size + Vec3i(1, 1, 0), initialValue);
                 break;
             case SampleType::NODE:
-                myCellOffset = Vec3f(.0);
                 this->resize(size + Vec3i(1), initialValue);
         }
     }
 
+    // Copy of a grid with another storage type, e.g. to store a float grid as Half
+    template <typename S>
+    explicit ScalarGrid(const ScalarGrid<S>& grid)
+        : ScalarGrid(grid.xform(), grid.gridSize(), grid.sampleType(), grid.borderType())
+    {
+        assert(this->size() == grid.size());
+
+        parallelFor(KernelClass::LIGHT, 0, this->voxelCount(), [&](const tbb::blocked_range<int>& range) {
+            convertValues(grid.data() + range.begin(), this->data() + range.begin(), range.end() - range.begin());
+        });
+    }
+
     SampleType sampleType() const { return mySampleType; }
+    BorderType borderType() const { return myBorderType; }
+
+    // Number of grid cells, as opposed to size() which counts samples
+    Vec3i gridSize() const { return myGridSize; }
 
     // Check that the two grids are of the same size,
     // positioned at the same spot, have the same grid
@@ -125,64 +187,56 @@ public:
     }
 
     // Global multiply operator
-    void operator*(const T& scalar)
+    void operator*(const Value& scalar)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, this->myGrid.size(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int index = range.begin(); index != range.end(); ++index)
-                                  this->myGrid[index] *= scalar;
-                          });
+        mapGrids(*this, [scalar](const T& value) { return T(Value(value) * scalar); }, *this);
     }
 
     // Global add operator
-    void operator+(const T& scalar)
+    void operator+(const Value& scalar)
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, this->myGrid.size(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int index = range.begin(); index != range.end(); ++index)
-                                  this->myGrid[index] += scalar;
-                          });
+        mapGrids(*this, [scalar](const T& value) { return T(Value(value) + scalar); }, *this);
     }
 
-    T maxValue() const
+    Value maxValue() const
     {
-        return tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, this->myGrid.size(), tbbLightGrainSize), std::numeric_limits<T>::lowest(),
-            [&](const tbb::blocked_range<int>& range, T maxValue) -> T {
+        return parallelReduce(
+            KernelClass::LIGHT, 0, this->voxelCount(), std::numeric_limits<Value>::lowest(),
+            [&](const tbb::blocked_range<int>& range, Value maxValue) -> Value {
                 for (int index = range.begin(); index != range.end(); ++index)
-                    maxValue = std::max(maxValue, this->myGrid[index]);
+                    maxValue = std::max(maxValue, Value(this->myGrid[index]));
                 return maxValue;
             },
-            [](T x, T y) -> T { return std::max(x, y); });
+            [](Value x, Value y) -> Value { return std::max(x, y); });
     }
 
-    T minValue() const
+    Value minValue() const
     {
-        return tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, this->myGrid.size(), tbbLightGrainSize), std::numeric_limits<T>::max(),
-            [&](const tbb::blocked_range<int>& range, T minValue) -> T {
+        return parallelReduce(
+            KernelClass::LIGHT, 0, this->voxelCount(), std::numeric_limits<Value>::max(),
+            [&](const tbb::blocked_range<int>& range, Value minValue) -> Value {
                 for (int index = range.begin(); index != range.end(); ++index)
-                    minValue = std::min(minValue, this->myGrid[index]);
+                    minValue = std::min(minValue, Value(this->myGrid[index]));
                 return minValue;
             },
-            [](T x, T y) -> T { return std::min(x, y); });
+            [](Value x, Value y) -> Value { return std::min(x, y); });
     }
 
-    std::pair<T, T> minAndMaxValue() const
+    std::pair<Value, Value> minAndMaxValue() const
     {
-        using MinMaxPair = std::pair<T, T>;
+        using MinMaxPair = std::pair<Value, Value>;
 
-        MinMaxPair result = tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, this->voxelCount(), tbbLightGrainSize),
-            MinMaxPair(std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest()),
+        MinMaxPair result = parallelReduce(
+            KernelClass::LIGHT, 0, this->voxelCount(),
+            MinMaxPair(std::numeric_limits<Value>::max(), std::numeric_limits<Value>::lowest()),
             [&](const tbb::blocked_range<int>& range, MinMaxPair valuePair) -> MinMaxPair {
-                T localMin = valuePair.first;
-                T localMax = valuePair.second;
+                Value localMin = valuePair.first;
+                Value localMax = valuePair.second;
 
                 for (int index = range.begin(); index != range.end(); ++index)
                 {
-                    localMin = std::min(localMin, this->myGrid[index]);
-                    localMax = std::max(localMax, this->myGrid[index]);
+                    localMin = std::min(localMin, Value(this->myGrid[index]));
+                    localMax = std::max(localMax, Value(this->myGrid[index]));
                 }
                 return MinMaxPair(localMin, localMax);
             },
@@ -190,14 +244,32 @@ public:
                 return MinMaxPair(std::min(x.first, y.first), std::max(x.second, y.second));
             });
 
-        return std::pair<T, T>(result.first, result.second);
+        return std::pair<Value, Value>(result.first, result.second);
     }
 
-    T interp(float x, float y, float z, bool isIndexSpace = false) const
+    Value interp(float x, float y, float z, bool isIndexSpace = false) const
     {
         return interp(Vec3f(x, y, z), isIndexSpace);
     }
-    T interp(const Vec3f& samplePoint, bool isIndexSpace = false) const;
+    Value interp(const Vec3f& samplePoint, bool isIndexSpace = false) const;
+
+    // Same as interp with the sample and border types fixed at compile time. They have to match the grid's.
+    // The cell offset and border handling become constants so the lookup inlines into the caller's loop.
+    template <SampleType Sample, BorderType Border>
+    Value interp(const Vec3f& samplePoint, bool isIndexSpace = false) const
+    {
+        assert(mySampleType == Sample && myBorderType == Border);
+
+        Vec3f indexPoint = samplePoint;
+
+        if (!isIndexSpace)
+        {
+            indexPoint = myXform.worldToIndex(samplePoint);
+            for (int axis : {0, 1, 2}) indexPoint[axis] -= ScalarGridSettings::sampleOffset(Sample, axis);
+        }
+
+        return interpBorder<Border>(indexPoint);
+    }
 
     // Converters between world space and local index space
     Vec3f indexToWorld(const Vec3f& indexPoint) const { return myXform.indexToWorld(indexPoint + myCellOffset); }
@@ -205,20 +277,20 @@ public:
     Vec3f worldToIndex(const Vec3f& worldPoint) const { return myXform.worldToIndex(worldPoint) - myCellOffset; }
 
     // Gradient operators
-    Vec<3, T> gradient(const Vec3f& worldPoint, bool isIndexSpace = false) const
+    Vec<3, Value> gradient(const Vec3f& worldPoint, bool isIndexSpace = false) const
     {
         constexpr float indexSpaceOffset(1E-1);
 
         float offset = isIndexSpace ? indexSpaceOffset : indexSpaceOffset * myXform.dx();
 
-        T dTdx = interp(worldPoint + Vec3f(offset, 0., 0.), isIndexSpace) -
+        Value dTdx = interp(worldPoint + Vec3f(offset, 0., 0.), isIndexSpace) -
                  interp(worldPoint - Vec3f(offset, 0., 0.), isIndexSpace);
-        T dTdy = interp(worldPoint + Vec3f(0., offset, 0.), isIndexSpace) -
+        Value dTdy = interp(worldPoint + Vec3f(0., offset, 0.), isIndexSpace) -
                  interp(worldPoint - Vec3f(0., offset, 0.), isIndexSpace);
-        T dTdz = interp(worldPoint + Vec3f(0., 0., offset), isIndexSpace) -
+        Value dTdz = interp(worldPoint + Vec3f(0., 0., offset), isIndexSpace) -
                  interp(worldPoint - Vec3f(0., 0., offset), isIndexSpace);
 
-        Vec<3, T> grad(dTdx, dTdy, dTdz);
+        Vec<3, Value> grad(dTdx, dTdy, dTdz);
         return grad / (2. * offset);
     }
 
@@ -248,8 +320,12 @@ public:
                                   float length = .25) const;
 
 private:
+    // Applies the border handling to an index space point and interpolates
+    template <BorderType Border>
+    Value interpBorder(Vec3f indexPoint) const;
+
     // The main interpolation call after the template specialized clamping passes
-    T interpLocal(const Vec3f& pos) const;
+    Value interpLocal(const Vec3f& pos) const;
 
     // Store the actual grid size. The mySize member of UniformGrid represents the
     // underlying sample grid. The actual grid doesn't change based on sample
@@ -271,32 +347,42 @@ private:
 };
 
 template <typename T>
-T ScalarGrid<T>::interp(const Vec3f& samplePoint, bool isIndexSpace) const
+typename ScalarGrid<T>::Value ScalarGrid<T>::interp(const Vec3f& samplePoint, bool isIndexSpace) const
 {
     Vec3f indexPoint = isIndexSpace ? samplePoint : worldToIndex(samplePoint);
 
     switch (myBorderType)
     {
         case BorderType::ZERO:
-
-            for (int axis : {0, 1, 2})
-            {
-                if (indexPoint[axis] < 0 || indexPoint[axis] > float(this->mySize[axis] - 1)) return T(0);
-            }
-
-            break;
-
+            return interpBorder<BorderType::ZERO>(indexPoint);
         case BorderType::CLAMP:
+            return interpBorder<BorderType::CLAMP>(indexPoint);
+        default:
+            return interpBorder<BorderType::ASSERT>(indexPoint);
+    }
+}
 
-            for (int axis : {0, 1, 2})
-                indexPoint[axis] = clamp(indexPoint[axis], float(0), float(this->mySize[axis] - 1));
-
-            break;
-
+template <typename T>
+template <ScalarGridSettings::BorderType Border>
+typename ScalarGrid<T>::Value ScalarGrid<T>::interpBorder(Vec3f indexPoint) const
+{
+    if constexpr (Border == BorderType::ZERO)
+    {
+        for (int axis : {0, 1, 2})
+        {
+            if (indexPoint[axis] < 0 || indexPoint[axis] > float(this->mySize[axis] - 1)) return Value(0);
+        }
+    }
+    else if constexpr (Border == BorderType::CLAMP)
+    {
+        for (int axis : {0, 1, 2})
+            indexPoint[axis] = clamp(indexPoint[axis], float(0), float(this->mySize[axis] - 1));
+    }
+    else
+    {
         // Useful debug check. Equivalent to "NONE" for release mode
-        case BorderType::ASSERT:
-            for (int axis : {0, 1, 2}) assert(indexPoint[axis] >= 0 && indexPoint[axis] <= float(this->mySize[0] - 1));
-            break;
+        for (int axis : {0, 1, 2})
+            assert(indexPoint[axis] >= 0 && indexPoint[axis] <= float(this->mySize[axis] - 1));
     }
 
     return interpLocal(indexPoint);
@@ -305,7 +391,7 @@ T ScalarGrid<T>::interp(const Vec3f& samplePoint, bool isIndexSpace) const
 // The local interp applies tri-linear interpolation on the UniformGrid. The
 // templated type must have operators for basic add/mult arithmetic.
 template <typename T>
-T ScalarGrid<T>::interpLocal(const Vec3f& indexPoint) const
+typename ScalarGrid<T>::Value ScalarGrid<T>::interpLocal(const Vec3f& indexPoint) const
 {
     Vec3f floorPoint = floor(indexPoint);
     Vec3i baseSampleCell = Vec3i(floorPoint);
@@ -316,17 +402,17 @@ T ScalarGrid<T>::interpLocal(const Vec3f& indexPoint) const
     }
 
     // Use base grid class operator
-    T v000 = (*this)(baseSampleCell[0], baseSampleCell[1], baseSampleCell[2]);
-    T v100 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1], baseSampleCell[2]);
+    Value v000 = (*this)(baseSampleCell[0], baseSampleCell[1], baseSampleCell[2]);
+    Value v100 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1], baseSampleCell[2]);
 
-    T v010 = (*this)(baseSampleCell[0], baseSampleCell[1] + 1, baseSampleCell[2]);
-    T v110 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1] + 1, baseSampleCell[2]);
+    Value v010 = (*this)(baseSampleCell[0], baseSampleCell[1] + 1, baseSampleCell[2]);
+    Value v110 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1] + 1, baseSampleCell[2]);
 
-    T v001 = (*this)(baseSampleCell[0], baseSampleCell[1], baseSampleCell[2] + 1);
-    T v101 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1], baseSampleCell[2] + 1);
+    Value v001 = (*this)(baseSampleCell[0], baseSampleCell[1], baseSampleCell[2] + 1);
+    Value v101 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1], baseSampleCell[2] + 1);
 
-    T v011 = (*this)(baseSampleCell[0], baseSampleCell[1] + 1, baseSampleCell[2] + 1);
-    T v111 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1] + 1, baseSampleCell[2] + 1);
+    Value v011 = (*this)(baseSampleCell[0], baseSampleCell[1] + 1, baseSampleCell[2] + 1);
+    Value v111 = (*this)(baseSampleCell[0] + 1, baseSampleCell[1] + 1, baseSampleCell[2] + 1);
 
     Vec3f dx = indexPoint - floorPoint;
 
@@ -424,19 +510,19 @@ void ScalarGrid<T>::drawSamplePoints(Renderer& renderer, const Vec3f& colour, fl
 {
     tbb::enumerable_thread_specific<std::vector<Vec3f>> parallelSamplePoints;
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, this->myGrid.size(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          auto& localSamplePoints = parallelSamplePoints.local();
+    parallelFor(KernelClass::LIGHT, 0, this->voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    auto& localSamplePoints = parallelSamplePoints.local();
 
-                          for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
-                          {
-                              Vec3i sampleCoord = this->unflatten(sampleIndex);
+                    for (int sampleIndex = range.begin(); sampleIndex != range.end(); ++sampleIndex)
+                    {
+                        Vec3i sampleCoord = this->unflatten(sampleIndex);
 
-                              Vec3f worldPoint = indexToWorld(Vec3f(sampleCoord));
+                        Vec3f worldPoint = indexToWorld(Vec3f(sampleCoord));
 
-                              localSamplePoints.push_back(worldPoint);
-                          }
-                      });
+                        localSamplePoints.push_back(worldPoint);
+                    }
+                });
 
     std::vector<Vec3f> samplePoints;
     mergeLocalThreadVectors(samplePoints, parallelSamplePoints);
@@ -532,9 +618,9 @@ template <typename T>
 void ScalarGrid<T>::drawSupersampledValues(Renderer& renderer, const Vec3f& start, const Vec3f& end,
                                            const Vec3f& sampleRadius, int samples, float sampleSize) const
 {
-    std::pair<T, T> minMaxPair = minAndMaxValue();
-    T minSample = minMaxPair.first;
-    T maxSample = minMaxPair.second;
+    std::pair<Value, Value> minMaxPair = minAndMaxValue();
+    Value minSample = minMaxPair.first;
+    Value maxSample = minMaxPair.second;
 
     Vec3i startIndex(ceil(start));
     Vec3i endIndex(floor(end));
@@ -551,7 +637,7 @@ void ScalarGrid<T>::drawSupersampledValues(Renderer& renderer, const Vec3f& star
                     Vec3f samplePoint = indexPoint + sampleOffset;
                     Vec3f worldPoint = indexToWorld(samplePoint);
 
-                    T value = (interp(worldPoint) - minSample) / (maxSample - minSample);
+                    Value value = (interp(worldPoint) - minSample) / (maxSample - minSample);
 
                     renderer.addPoint(worldPoint, Vec3f(value, value, 0), sampleSize);
                 }
@@ -640,7 +726,7 @@ void ScalarGrid<T>::drawSampleGradientsPlane(Renderer& renderer, Axis planeAxis,
         Vec3f worldPoint = indexToWorld(Vec3f(cell));
         samplePoints.push_back(worldPoint);
 
-        Vec<3, T> gradVector = gradient(worldPoint);
+        Vec<3, Value> gradVector = gradient(worldPoint);
         Vec3f vectorEnd = worldPoint + length * gradVector;
         gradientPoints.push_back(vectorEnd);
     });
@@ -0,0 +1,277 @@
+#ifndef LIBRARY_SCHEDULING_POLICY_H
+#define LIBRARY_SCHEDULING_POLICY_H
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include "tbb/tbb.h"
+
+///////////////////////////////////
+//
+// SchedulingPolicy.h
+//
+// Runtime TBB scheduling policy for each
+// class of parallel loop. LIGHT loops do a few
+// flops per item (grid sweeps, interpolation),
+// HEAVY loops do a lot of work per item
+// (mesh intersection, cut-cell volumes).
+// Each class has its own grain size and
+// partitioner so they can be tuned for the
+// host. Policies can be autotuned by timing
+// real kernels and saved to a file.
+//
+// Policies should be set before any parallel
+// work starts; they are read without locking.
+//
+// Deterministic mode overrides the partitioner
+// so that every loop is split the same way on
+// every run, and reductions are joined in a
+// fixed order. Results then don't depend on the
+// thread count or on scheduling.
+//
+////////////////////////////////////
+
+namespace FluidSim3D::Utilities
+{
+enum class KernelClass
+{
+    LIGHT,
+    HEAVY
+};
+
+enum class PartitionerType
+{
+    AUTO,
+    SIMPLE,
+    STATIC
+};
+
+struct SchedulingPolicy
+{
+    int myGrainSize;
+    PartitionerType myPartitioner;
+};
+
+inline std::array<SchedulingPolicy, 2>& schedulingPolicies()
+{
+    static std::array<SchedulingPolicy, 2> policies = {
+        {SchedulingPolicy{1000, PartitionerType::AUTO}, SchedulingPolicy{100, PartitionerType::AUTO}}};
+    return policies;
+}
+
+inline const SchedulingPolicy& schedulingPolicy(KernelClass kernelClass)
+{
+    return schedulingPolicies()[int(kernelClass)];
+}
+
+inline void setSchedulingPolicy(KernelClass kernelClass, const SchedulingPolicy& policy)
+{
+    assert(policy.myGrainSize > 0);
+    schedulingPolicies()[int(kernelClass)] = policy;
+}
+
+inline bool& deterministicFlag()
+{
+    static bool isDeterministic = false;
+    return isDeterministic;
+}
+
+inline void setDeterministic(bool isDeterministic) { deterministicFlag() = isDeterministic; }
+
+inline bool isDeterministic() { return deterministicFlag(); }
+
+inline int grainSize(KernelClass kernelClass) { return schedulingPolicy(kernelClass).myGrainSize; }
+
+// Grain size along each axis of a 3-D range so the block holds roughly the same number of items
+inline int grainSize3D(KernelClass kernelClass)
+{
+    return std::max(int(std::cbrt(float(grainSize(kernelClass)))), 1);
+}
+
+template <typename Range, typename Body>
+void parallelFor(KernelClass kernelClass, const Range& range, const Body& body)
+{
+    // The simple partitioner splits down to the grain size regardless of the thread count
+    if (isDeterministic())
+    {
+        tbb::parallel_for(range, body, tbb::simple_partitioner());
+        return;
+    }
+
+    switch (schedulingPolicy(kernelClass).myPartitioner)
+    {
+        case PartitionerType::SIMPLE:
+            tbb::parallel_for(range, body, tbb::simple_partitioner());
+            break;
+        case PartitionerType::STATIC:
+            tbb::parallel_for(range, body, tbb::static_partitioner());
+            break;
+        default:
+            tbb::parallel_for(range, body, tbb::auto_partitioner());
+    }
+}
+
+template <typename Body>
+void parallelFor(KernelClass kernelClass, int begin, int end, const Body& body)
+{
+    parallelFor(kernelClass, tbb::blocked_range<int>(begin, end, grainSize(kernelClass)), body);
+}
+
+template <typename Range, typename Value, typename Body, typename Reduction>
+Value parallelReduce(KernelClass kernelClass, const Range& range, const Value& identity, const Body& body,
+                     const Reduction& reduction)
+{
+    // Floating point reductions aren't associative so the join order has to be fixed as well
+    if (isDeterministic())
+        return tbb::parallel_deterministic_reduce(range, identity, body, reduction, tbb::simple_partitioner());
+
+    switch (schedulingPolicy(kernelClass).myPartitioner)
+    {
+        case PartitionerType::SIMPLE:
+            return tbb::parallel_reduce(range, identity, body, reduction, tbb::simple_partitioner());
+        case PartitionerType::STATIC:
+            return tbb::parallel_reduce(range, identity, body, reduction, tbb::static_partitioner());
+        default:
+            return tbb::parallel_reduce(range, identity, body, reduction, tbb::auto_partitioner());
+    }
+}
+
+template <typename Value, typename Body, typename Reduction>
+Value parallelReduce(KernelClass kernelClass, int begin, int end, const Value& identity, const Body& body,
+                     const Reduction& reduction)
+{
+    return parallelReduce(kernelClass, tbb::blocked_range<int>(begin, end, grainSize(kernelClass)), identity, body,
+                          reduction);
+}
+
+//
+// Persistence. The file holds one line per kernel class: "<class> <grain size> <partitioner>".
+//
+
+inline const char* kernelClassName(KernelClass kernelClass)
+{
+    return kernelClass == KernelClass::LIGHT ? "light" : "heavy";
+}
+
+inline const char* partitionerName(PartitionerType partitioner)
+{
+    switch (partitioner)
+    {
+        case PartitionerType::SIMPLE:
+            return "simple";
+        case PartitionerType::STATIC:
+            return "static";
+        default:
+            return "auto";
+    }
+}
+
+inline bool saveSchedulingPolicies(const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file) return false;
+
+    for (KernelClass kernelClass : {KernelClass::LIGHT, KernelClass::HEAVY})
+    {
+        const SchedulingPolicy& policy = schedulingPolicy(kernelClass);
+        file << kernelClassName(kernelClass) << " " << policy.myGrainSize << " " << partitionerName(policy.myPartitioner)
+             << "\n";
+    }
+
+    return bool(file);
+}
+
+// Returns false and leaves the current policies untouched if the file is missing or malformed
+inline bool loadSchedulingPolicies(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file) return false;
+
+    std::array<SchedulingPolicy, 2> loadedPolicies = schedulingPolicies();
+
+    std::string className, partitioner;
+    int grain;
+    while (file >> className >> grain >> partitioner)
+    {
+        if (grain <= 0) return false;
+
+        int classIndex;
+        if (className == "light")
+            classIndex = int(KernelClass::LIGHT);
+        else if (className == "heavy")
+            classIndex = int(KernelClass::HEAVY);
+        else
+            return false;
+
+        PartitionerType partitionerType;
+        if (partitioner == "auto")
+            partitionerType = PartitionerType::AUTO;
+        else if (partitioner == "simple")
+            partitionerType = PartitionerType::SIMPLE;
+        else if (partitioner == "static")
+            partitionerType = PartitionerType::STATIC;
+        // Files from before the affinity partitioner was dropped
+        else if (partitioner == "affinity")
+            partitionerType = PartitionerType::AUTO;
+        else
+            return false;
+
+        loadedPolicies[classIndex] = SchedulingPolicy{grain, partitionerType};
+    }
+
+    schedulingPolicies() = loadedPolicies;
+    return true;
+}
+
+//
+// Autotuning. runKernel(kernelClass) runs real loops of that class, e.g. a few simulator kernels on a
+// representative grid. Each class is timed over a range of grain sizes and every partitioner and the
+// fastest combination is kept.
+//
+
+template <typename KernelRunner>
+void autotuneSchedulingPolicies(const KernelRunner& runKernel, int trialCount = 5)
+{
+    for (KernelClass kernelClass : {KernelClass::LIGHT, KernelClass::HEAVY})
+    {
+        SchedulingPolicy bestPolicy = schedulingPolicy(kernelClass);
+        double bestTime = std::numeric_limits<double>::max();
+
+        for (int grain : {16, 64, 100, 256, 1000, 4096, 16384})
+            for (PartitionerType partitioner : {PartitionerType::AUTO, PartitionerType::SIMPLE, PartitionerType::STATIC})
+            {
+                setSchedulingPolicy(kernelClass, SchedulingPolicy{grain, partitioner});
+
+                // Warm up the caches before timing
+                runKernel(kernelClass);
+
+                double trialTime = std::numeric_limits<double>::max();
+                for (int trial = 0; trial < trialCount; ++trial)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    runKernel(kernelClass);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    trialTime = std::min(trialTime, elapsed.count());
+                }
+
+                if (trialTime < bestTime)
+                {
+                    bestTime = trialTime;
+                    bestPolicy = SchedulingPolicy{grain, partitioner};
+                }
+            }
+
+        setSchedulingPolicy(kernelClass, bestPolicy);
+    }
+}
+
+}  // namespace FluidSim3D::Utilities
+
+#endif
@@ -87,6 +87,10 @@ public:
         myGrid.resize(mySize[0] * mySize[1] * mySize[2], value);
     }
 
+    // Samples in flattened order
+    T* data() { return myGrid.data(); }
+    const T* data() const { return myGrid.data(); }
+
     const Vec3i& size() const { return mySize; }
     int voxelCount() const { return mySize[0] * mySize[1] * mySize[2]; }
 
@@ -118,5 +122,26 @@ protected:
     Vec3i mySize;
 };
 
+// Fused per-voxel evaluation. Sets every sample of output to function(input samples...) in a single parallel
+// sweep, so a compound expression over several grids costs one pass instead of one pass per operation. The
+// grids must share a size and output may be one of the inputs. The inner loop runs over raw storage so simple
+// functions vectorise.
+template <typename T, typename Function, typename... Inputs>
+void mapGrids(UniformGrid<T>& output, const Function& function, const UniformGrid<Inputs>&... inputs)
+{
+    assert(((inputs.size() == output.size()) && ...));
+
+    T* outputData = output.data();
+
+    parallelFor(KernelClass::LIGHT, 0, output.voxelCount(), [&](const tbb::blocked_range<int>& range) {
+        auto mapRange = [&](const Inputs*... inputData) {
+            for (int index = range.begin(); index != range.end(); ++index)
+                outputData[index] = function(inputData[index]...);
+        };
+
+        mapRange(inputs.data()...);
+    });
+}
+
 }  // namespace FluidSim3D::Utilities
 #endif
\ No newline at end of file
@@ -3,11 +3,15 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
 #include "tbb/tbb.h"
 
+#include "ExecutionContext.h"
+#include "SchedulingPolicy.h"
+
 ///////////////////////////////////
 //
 // Utilities.h
@@ -28,9 +32,6 @@ constexpr double PI = 3.1415926535897932384626433832795;
 // TBB utilities
 //
 
-constexpr int tbbLightGrainSize = 1000;
-constexpr int tbbHeavyGrainSize = 100;
-
 template <typename StorageType>
 void mergeLocalThreadVectors(std::vector<StorageType>& combinedVector,
                              tbb::enumerable_thread_specific<std::vector<StorageType>>& parallelVector)
@@ -46,6 +47,87 @@ void mergeLocalThreadVectors(std::vector<StorageType>& combinedVector,
     });
 }
 
+// Thread local vectors that also record which loop chunk each item came from. Merging
+// concatenates the chunks in loop order rather than thread order, so the merged vector
+// matches a serial loop no matter how the range was split or which thread ran each chunk.
+template <typename StorageType>
+class OrderedLocalThreadVectors
+{
+public:
+    // Call once at the start of each chunk with the first index of the chunk. Chunks are
+    // ordered by pass and then by their first index, so a loop that runs once per axis
+    // can collect into the same buffers by passing the axis as the pass.
+    std::vector<StorageType>& local(int chunkBegin, int pass = 0)
+    {
+        LocalVector& localVector = myLocalVectors.local();
+        localVector.myChunks.push_back(Chunk{pass, chunkBegin, int(localVector.myItems.size())});
+        return localVector.myItems;
+    }
+
+private:
+    template <typename MergedType>
+    friend void mergeLocalThreadVectors(std::vector<MergedType>& combinedVector,
+                                        OrderedLocalThreadVectors<MergedType>& parallelVector);
+
+    struct Chunk
+    {
+        int myPass;
+        int myBegin;
+        int myOffset;
+    };
+
+    struct LocalVector
+    {
+        std::vector<StorageType> myItems;
+        std::vector<Chunk> myChunks;
+    };
+
+    tbb::enumerable_thread_specific<LocalVector> myLocalVectors;
+};
+
+template <typename StorageType>
+void mergeLocalThreadVectors(std::vector<StorageType>& combinedVector,
+                             OrderedLocalThreadVectors<StorageType>& parallelVector)
+{
+    struct ChunkItems
+    {
+        int myPass;
+        int myBegin;
+        const StorageType* myFirst;
+        const StorageType* myLast;
+    };
+
+    std::vector<ChunkItems> chunks;
+    int vectorSize = 0;
+
+    parallelVector.myLocalVectors.combine_each([&](const auto& localVector) {
+        const std::vector<StorageType>& items = localVector.myItems;
+        for (int chunkIndex = 0; chunkIndex < int(localVector.myChunks.size()); ++chunkIndex)
+        {
+            const auto& chunk = localVector.myChunks[chunkIndex];
+
+            // Each chunk runs to the start of the next chunk on the same thread
+            int chunkEnd = chunkIndex + 1 < int(localVector.myChunks.size())
+                               ? localVector.myChunks[chunkIndex + 1].myOffset
+                               : int(items.size());
+
+            chunks.push_back(
+                ChunkItems{chunk.myPass, chunk.myBegin, items.data() + chunk.myOffset, items.data() + chunkEnd});
+        }
+
+        vectorSize += items.size();
+    });
+
+    // There are far fewer chunks than items so this is cheap next to copying the items
+    std::sort(chunks.begin(), chunks.end(), [](const ChunkItems& chunk0, const ChunkItems& chunk1) {
+        return chunk0.myPass < chunk1.myPass || (chunk0.myPass == chunk1.myPass && chunk0.myBegin < chunk1.myBegin);
+    });
+
+    combinedVector.reserve(combinedVector.size() + vectorSize);
+
+    for (const ChunkItems& chunk : chunks) combinedVector.insert(combinedVector.end(), chunk.myFirst, chunk.myLast);
+}
+
 //
 // BFS markers
 //
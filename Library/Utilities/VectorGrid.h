@@ -32,6 +32,29 @@ enum class SampleType
     NODE,
     EDGE
 };
+
+// Sample type of the scalar grid holding the axis component
+constexpr ScalarGridSettings::SampleType scalarSampleType(SampleType sampleType, int axis)
+{
+    using ScalarSampleType = ScalarGridSettings::SampleType;
+
+    switch (sampleType)
+    {
+        case SampleType::CENTER:
+            return ScalarSampleType::CENTER;
+        // If the grid is 2x2x2, it has 3x2x2 x-aligned faces.
+        // This is handled inside of the ScalarGrid
+        case SampleType::STAGGERED:
+            if (axis == 0) return ScalarSampleType::XFACE;
+            return axis == 1 ? ScalarSampleType::YFACE : ScalarSampleType::ZFACE;
+        // If the grid is 2x2x2, it has 3x3x3 nodes. This is handled inside of the ScalarGrid
+        case SampleType::NODE:
+            return ScalarSampleType::NODE;
+        default:
+            if (axis == 0) return ScalarSampleType::XEDGE;
+            return axis == 1 ? ScalarSampleType::YEDGE : ScalarSampleType::ZEDGE;
+    }
+}
 }
 
 template <typename T>
@@ -54,30 +77,10 @@ public:
                ScalarBorderType borderType = ScalarBorderType::CLAMP)
         : myXform(xform), myGridSize(size), mySampleType(sampleType)
     {
-        switch (sampleType)
+        for (int axis : {0, 1, 2})
         {
-            case SampleType::CENTER:
-                myGrids[0] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::CENTER, borderType);
-                myGrids[1] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::CENTER, borderType);
-                myGrids[2] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::CENTER, borderType);
-                break;
-            // If the grid is 2x2x2, it has 3x2x2 x-aligned faces.
-            // This is handled inside of the ScalarGrid
-            case SampleType::STAGGERED:
-                myGrids[0] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::XFACE, borderType);
-                myGrids[1] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::YFACE, borderType);
-                myGrids[2] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::ZFACE, borderType);
-                break;
-            // If the grid is 2x2x2, it has 3x3x3 nodes. This is handled inside of the ScalarGrid
-            case SampleType::NODE:
-                myGrids[0] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::NODE, borderType);
-                myGrids[1] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::NODE, borderType);
-                myGrids[2] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::NODE, borderType);
-                break;
-            case SampleType::EDGE:
-                myGrids[0] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::XEDGE, borderType);
-                myGrids[1] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::YEDGE, borderType);
-                myGrids[2] = ScalarGrid<T>(xform, size, initialValue, ScalarSampleType::ZEDGE, borderType);
+            myGrids[axis] = ScalarGrid<T>(xform, size, initialValue,
+                                          VectorGridSettings::scalarSampleType(sampleType, axis), borderType);
         }
     }
 
@@ -129,6 +132,19 @@ public:
     T interp(float x, float y, float z, int axis) const { return interp(Vec3f(x, y, z), axis); }
     T interp(const Vec3f& samplePoint, int axis) const { return myGrids[axis].interp(samplePoint); }
 
+    // Compile-time sample and border types (see ScalarGrid::interp) for hot loops that know the layout
+    template <SampleType Sample, ScalarBorderType Border>
+    Vec<3, T> interp(const Vec3f& samplePoint) const
+    {
+        assert(mySampleType == Sample);
+
+        using VectorGridSettings::scalarSampleType;
+
+        return Vec<3, T>(myGrids[0].template interp<scalarSampleType(Sample, 0), Border>(samplePoint),
+                         myGrids[1].template interp<scalarSampleType(Sample, 1), Border>(samplePoint),
+                         myGrids[2].template interp<scalarSampleType(Sample, 2), Border>(samplePoint));
+    }
+
     // World space vs. index space converters need to be done at the
     // underlying scalar grid level because the alignment of the three
     // grids are different depending on the SampleType.
@@ -183,8 +199,8 @@ T VectorGrid<T>::maxMagnitude() const
 
     if (mySampleType == SampleType::CENTER || mySampleType == SampleType::NODE)
     {
-        T magnitude = tbb::parallel_reduce(
-            tbb::blocked_range<int>(0, myGrids[0].voxelCount(), tbbLightGrainSize), 0,
+        T magnitude = parallelReduce(
+            KernelClass::LIGHT, 0, myGrids[0].voxelCount(), T(0),
             [&](const tbb::blocked_range<int>& range, T maxMagnitude) -> T {
                 for (int index = range.begin(); index != range.end(); ++index)
                 {
@@ -200,11 +216,11 @@ T VectorGrid<T>::maxMagnitude() const
     }
     else if (mySampleType == SampleType::STAGGERED)
     {
+        int grain = grainSize3D(KernelClass::LIGHT);
         auto blocked_range =
-            tbb::blocked_range3d<int>(0, myGridSize[0], std::cbrt(tbbLightGrainSize), 0, myGridSize[1],
-                                      std::cbrt(tbbLightGrainSize), 0, myGridSize[2], std::cbrt(tbbLightGrainSize));
-        T magnitude = tbb::parallel_reduce(
-            blocked_range, 0,
+            tbb::blocked_range3d<int>(0, myGridSize[0], grain, 0, myGridSize[1], grain, 0, myGridSize[2], grain);
+        T magnitude = parallelReduce(
+            KernelClass::LIGHT, blocked_range, T(0),
             [&](const tbb::blocked_range3d<int>& range, T maxMagnitude) -> T {
                 Vec3i cell;
 
@@ -1,6 +1,10 @@
 #include "EulerianLiquidSimulator.h"
 
+#include <array>
 #include <iostream>
+#include <memory>
+
+#include "tbb/flow_graph.h"
 
 #include "ComputeWeights.h"
 #include "ExtrapolateField.h"
@@ -8,6 +12,13 @@
 #include "Timer.h"
 #include "ViscositySolver.h"
 
+// The liquid velocity is always staggered and clamped at the border so the advection loops sample it through
+// the compile-time interpolation path
+static Vec3f sampleLiquidVelocity(const VectorGrid<float>& velocity, const Vec3f& point)
+{
+    return velocity.interp<VectorGridSettings::SampleType::STAGGERED, ScalarGridSettings::BorderType::CLAMP>(point);
+}
+
 void EulerianLiquidSimulator::drawGrid(Renderer& renderer, bool onlyDrawNarrowBand) const
 {
     myLiquidSurface.drawGrid(renderer, onlyDrawNarrowBand);
@@ -15,7 +26,8 @@ void EulerianLiquidSimulator::drawGrid(Renderer& renderer, bool onlyDrawNarrowBa
 
 void EulerianLiquidSimulator::drawLiquidSurface(Renderer& renderer) const
 {
-    TriMesh liquidSurfaceMesh = myLiquidSurface.buildMesh();
+    // Only the meshing runs in the context. Drawing stays on the calling thread.
+    TriMesh liquidSurfaceMesh = myContext.execute([&] { return myLiquidSurface.buildMesh(); });
     liquidSurfaceMesh.drawMesh(renderer, true /* render tri faces */, Vec3f(.5), false /* don't render tri normals */,
                                Vec3f(0), false /* don't render tri vertices */, Vec3f(0), true /* render tri edges */,
                                Vec3f(0, 1, 0));
@@ -30,7 +42,7 @@ void EulerianLiquidSimulator::drawLiquidVelocity(Renderer& renderer, Axis planeA
 
 void EulerianLiquidSimulator::drawSolidSurface(Renderer& renderer) const
 {
-    TriMesh solidSurfaceMesh = mySolidSurface.buildMesh();
+    TriMesh solidSurfaceMesh = myContext.execute([&] { return mySolidSurface.buildMesh(); });
     solidSurfaceMesh.drawMesh(renderer, false /* don't render tri faces */, Vec3f(0),
                               false /* don't render tri normals */, Vec3f(0), false /* don't render tri vertices */,
                               Vec3f(0), true /* render tri edges */, Vec3f(.25));
@@ -45,250 +57,460 @@ void EulerianLiquidSimulator::drawSolidVelocity(Renderer& renderer, Axis planeAx
 
 void EulerianLiquidSimulator::setSolidSurface(const LevelSet& solidSurface)
 {
-    assert(solidSurface.isBackgroundNegative());
+    myContext.execute([&] {
+        assert(solidSurface.isBackgroundNegative());
 
-    TriMesh localMesh = solidSurface.buildMesh();
+        TriMesh localMesh = solidSurface.buildMesh();
 
-    mySolidSurface.setBackgroundNegative();
-    mySolidSurface.initFromMesh(localMesh, false);
+        mySolidSurface.setBackgroundNegative();
+        mySolidSurface.initFromMesh(localMesh, false);
+    });
 }
 
 void EulerianLiquidSimulator::setSolidVelocity(const VectorGrid<float>& solidVelocity)
 {
-    for (int axis : {0, 1, 2})
-    {
-        tbb::parallel_for(tbb::blocked_range<int>(0, solidVelocity.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = mySolidVelocity.grid(axis).unflatten(faceIndex);
-
-                                  Vec3f facePosition = mySolidVelocity.indexToWorld(Vec3f(face), axis);
-                                  mySolidVelocity(face, axis) = solidVelocity.interp(facePosition, axis);
-                              }
-                          });
-    }
+    myContext.execute([&] {
+        for (int axis : {0, 1, 2})
+        {
+            parallelFor(KernelClass::LIGHT, 0, solidVelocity.grid(axis).voxelCount(),
+                        [&](tbb::blocked_range<int>& range) {
+                            for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                            {
+                                Vec3i face = mySolidVelocity.grid(axis).unflatten(faceIndex);
+
+                                Vec3f facePosition = mySolidVelocity.indexToWorld(Vec3f(face), axis);
+                                mySolidVelocity(face, axis) = solidVelocity.interp(facePosition, axis);
+                            }
+                        });
+        }
+    });
+}
+
+void EulerianLiquidSimulator::setSolidVelocity(VectorGrid<float>&& solidVelocity)
+{
+    if (mySolidVelocity.isGridMatched(solidVelocity))
+        mySolidVelocity = std::move(solidVelocity);
+    else
+        setSolidVelocity(static_cast<const VectorGrid<float>&>(solidVelocity));
 }
 
 void EulerianLiquidSimulator::setLiquidSurface(const LevelSet& surface)
 {
-    TriMesh localMesh = surface.buildMesh();
-    myLiquidSurface.initFromMesh(localMesh, false);
+    myContext.execute([&] {
+        TriMesh localMesh = surface.buildMesh();
+        myLiquidSurface.initFromMesh(localMesh, false);
+    });
 }
 
 void EulerianLiquidSimulator::setLiquidVelocity(const VectorGrid<float>& velocity)
 {
-    for (int axis : {0, 1, 2})
-    {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myLiquidVelocity.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
-
-                                  Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
-                                  myLiquidVelocity(face, axis) = velocity.interp(facePosition, axis);
-                              }
-                          });
-    }
+    myContext.execute([&] {
+        for (int axis : {0, 1, 2})
+        {
+            parallelFor(KernelClass::LIGHT, 0, myLiquidVelocity.grid(axis).voxelCount(),
+                        [&](tbb::blocked_range<int>& range) {
+                            for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                            {
+                                Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
+
+                                Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
+                                myLiquidVelocity(face, axis) = velocity.interp(facePosition, axis);
+                            }
+                        });
+        }
+    });
+}
+
+void EulerianLiquidSimulator::setLiquidVelocity(VectorGrid<float>&& velocity)
+{
+    if (myLiquidVelocity.isGridMatched(velocity))
+        myLiquidVelocity = std::move(velocity);
+    else
+        setLiquidVelocity(static_cast<const VectorGrid<float>&>(velocity));
 }
 
 void EulerianLiquidSimulator::unionLiquidSurface(const LevelSet& addedLiquidSurface)
 {
-    // Need to zero out velocity in this added region as it could get extrapolated values
+    myContext.execute([&] {
+        // Need to zero out velocity in this added region as it could get extrapolated values
+        for (int axis : {0, 1, 2})
+        {
+            parallelFor(
+                KernelClass::LIGHT, 0, myLiquidVelocity.grid(axis).voxelCount(),
+                [&](tbb::blocked_range<int>& range) {
+                    for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                    {
+                        Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
+
+                        Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
+                        if (addedLiquidSurface.interp(facePosition) <= 0. && myLiquidSurface.interp(facePosition) > 0.)
+                            myLiquidVelocity(face, axis) = 0;
+                    }
+                });
+        }
+
+        // Combine surfaces
+        myLiquidSurface.unionSurface(addedLiquidSurface);
+    });
+}
+
+void EulerianLiquidSimulator::addLiquidSource(const LevelSet& sourceSurface)
+{
+    myContext.execute([&] {
+        addLiquidSource(sourceSurface.worldMin(), sourceSurface.worldMax(),
+                        [&](const Vec3f& worldPoint) { return sourceSurface.interpOrBackground(worldPoint); });
+    });
+}
+
+void EulerianLiquidSimulator::addLiquidSource(const LevelSetCSG& sourceSurface)
+{
+    myContext.execute([&] {
+        if (sourceSurface.isEmpty()) return;
+
+        addLiquidSource(sourceSurface.worldMin(), sourceSurface.worldMax(),
+                        [&](const Vec3f& worldPoint) { return sourceSurface.phi(worldPoint); });
+    });
+}
+
+template <typename SurfaceSampler>
+void EulerianLiquidSimulator::addLiquidSource(const Vec3f& worldMin, const Vec3f& worldMax,
+                                              const SurfaceSampler& sampler)
+{
+    // Need to zero out velocity in the added region as it could get extrapolated values
     for (int axis : {0, 1, 2})
     {
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0, myLiquidVelocity.grid(axis).voxelCount(), tbbLightGrainSize),
-            [&](tbb::blocked_range<int>& range) {
-                for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                {
-                    Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
+        Vec3i faceMin = maxUnion(Vec3i(ceil(myLiquidVelocity.worldToIndex(worldMin, axis))), Vec3i(0));
+        Vec3i faceMax =
+            minUnion(Vec3i(floor(myLiquidVelocity.worldToIndex(worldMax, axis))) + Vec3i(1), myLiquidVelocity.size(axis));
 
-                    Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
-                    if (addedLiquidSurface.interp(facePosition) <= 0. && myLiquidSurface.interp(facePosition) > 0.)
-                        myLiquidVelocity(face, axis) = 0;
-                }
+        if (faceMin[0] >= faceMax[0] || faceMin[1] >= faceMax[1] || faceMin[2] >= faceMax[2]) continue;
+
+        parallelFor(KernelClass::LIGHT, faceMin[0], faceMax[0], [&](const tbb::blocked_range<int>& range) {
+            Vec3i sliceMin = faceMin, sliceMax = faceMax;
+            sliceMin[0] = range.begin();
+            sliceMax[0] = range.end();
+
+            forEachVoxelRange(sliceMin, sliceMax, [&](const Vec3i& face) {
+                Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
+                if (sampler(facePosition) <= 0. && myLiquidSurface.interp(facePosition) > 0.)
+                    myLiquidVelocity(face, axis) = 0;
             });
+        });
     }
 
-    // Combine surfaces
-    myLiquidSurface.unionSurface(addedLiquidSurface);
+    // Combine surfaces inside the source box only. The surface is redistanced when it is
+    // advected so there is no need to rebuild it here.
+    myLiquidSurface.stampSurface(worldMin, worldMax, sampler);
 }
 
 template <typename ForceSampler>
 void EulerianLiquidSimulator::addForce(float dt, const ForceSampler& force)
 {
-    for (int axis : {0, 1, 2})
-    {
-        tbb::parallel_for(tbb::blocked_range<int>(0, myLiquidVelocity.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
-
-                                  Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
-                                  myLiquidVelocity(face, axis) += dt * force(facePosition, axis);
-                              }
-                          });
-    }
+    myContext.execute([&] {
+        for (int axis : {0, 1, 2})
+        {
+            parallelFor(KernelClass::LIGHT, 0, myLiquidVelocity.grid(axis).voxelCount(),
+                        [&](tbb::blocked_range<int>& range) {
+                            for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                            {
+                                Vec3i face = myLiquidVelocity.grid(axis).unflatten(faceIndex);
+
+                                Vec3f facePosition = myLiquidVelocity.indexToWorld(Vec3f(face), axis);
+                                myLiquidVelocity(face, axis) += dt * force(facePosition, axis);
+                            }
+                        });
+        }
+    });
 }
 
 void EulerianLiquidSimulator::addForce(float dt, const Vec3f& force)
 {
-    addForce(dt, [&](Vec3f, int axis) { return force[axis]; });
+    // A constant force doesn't need face positions
+    myContext.execute([&] {
+        for (int axis : {0, 1, 2})
+        {
+            float impulse = dt * force[axis];
+            mapGrids(
+                myLiquidVelocity.grid(axis), [impulse](float velocity) { return velocity + impulse; },
+                myLiquidVelocity.grid(axis));
+        }
+    });
 }
 
 void EulerianLiquidSimulator::advectOldPressure(float dt)
 {
-    auto velocityFunc = [&](float, const Vec3f& pos) { return myLiquidVelocity.interp(pos); };
+    myContext.execute([&] {
+        auto velocityFunc = [&](float, const Vec3f& pos) { return sampleLiquidVelocity(myLiquidVelocity, pos); };
 
-    ScalarGrid<float> tempPressure(myOldPressure.xform(), myOldPressure.size());
+        ScalarGrid<Half> tempPressure(myOldPressure.xform(), myOldPressure.size());
 
-    advectField(dt, tempPressure, myOldPressure, velocityFunc, IntegrationOrder::RK3);
+        advectField(dt, tempPressure, myOldPressure, velocityFunc, IntegrationOrder::RK3);
 
-    std::swap(myOldPressure, tempPressure);
+        std::swap(myOldPressure, tempPressure);
+    });
 }
 
 void EulerianLiquidSimulator::advectLiquidSurface(float dt, IntegrationOrder integrator)
 {
-    auto velocityFunc = [&](float, const Vec3f& point) { return myLiquidVelocity.interp(point); };
+    myContext.execute([&] {
+        auto velocityFunc = [&](float, const Vec3f& point) { return sampleLiquidVelocity(myLiquidVelocity, point); };
+
+        TriMesh localMesh = myLiquidSurface.buildMesh();
+        localMesh.advectMesh(dt, velocityFunc, integrator);
+        assert(localMesh.unitTestMesh());
 
-    TriMesh localMesh = myLiquidSurface.buildMesh();
-    localMesh.advectMesh(dt, velocityFunc, integrator);
-    assert(localMesh.unitTestMesh());
+        myLiquidSurface.initFromMesh(localMesh, false);
 
-    myLiquidSurface.initFromMesh(localMesh, false);
+        // Remove solid regions from liquid surface
+        assert(myLiquidSurface.isGridMatched(mySolidSurface));
 
-    // Remove solid regions from liquid surface
-    tbb::parallel_for(tbb::blocked_range<int>(0, myLiquidSurface.voxelCount(), tbbLightGrainSize),
-                      [&](tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = myLiquidSurface.unflatten(cellIndex);
-                              myLiquidSurface(cell) = std::max(myLiquidSurface(cell), -mySolidSurface(cell));
-                          }
-                      });
+        mapGrids(
+            myLiquidSurface.grid(), [](float liquidPhi, float solidPhi) { return std::max(liquidPhi, -solidPhi); },
+            myLiquidSurface.grid(), mySolidSurface.grid());
 
-    myLiquidSurface.reinitMesh();
+        myLiquidSurface.reinitMesh();
+    });
 }
 
 void EulerianLiquidSimulator::advectViscosity(float dt, IntegrationOrder integrator)
 {
-    auto velocityFunc = [&](float, const Vec3f& point) { return myLiquidVelocity.interp(point); };
+    myContext.execute([&] {
+        auto velocityFunc = [&](float, const Vec3f& point) { return sampleLiquidVelocity(myLiquidVelocity, point); };
 
-    ScalarGrid<float> tempViscosity(myViscosity.xform(), myViscosity.size());
+        ScalarGrid<Half> tempViscosity(myViscosity.xform(), myViscosity.size());
 
-    advectField(dt, tempViscosity, myViscosity, velocityFunc, integrator);
+        advectField(dt, tempViscosity, myViscosity, velocityFunc, integrator);
 
-    std::swap(tempViscosity, myViscosity);
+        std::swap(tempViscosity, myViscosity);
+    });
 }
 
 void EulerianLiquidSimulator::advectLiquidVelocity(float dt, IntegrationOrder integrator)
 {
-    auto velocityFunc = [&](float, const Vec3f& point) { return myLiquidVelocity.interp(point); };
+    myContext.execute([&] {
+        VectorGrid<float> tempVelocity = computeAdvectedVelocity(dt, integrator);
+        std::swap(myLiquidVelocity, tempVelocity);
+    });
+}
+
+VectorGrid<float> EulerianLiquidSimulator::computeAdvectedVelocity(float dt, IntegrationOrder integrator) const
+{
+    auto velocityFunc = [&](float, const Vec3f& point) { return sampleLiquidVelocity(myLiquidVelocity, point); };
 
-    VectorGrid<float> tempVelocity(myLiquidSurface.xform(), myLiquidSurface.size(),
+    // Use the velocity grid's own layout so this can run while the liquid surface is being advected
+    VectorGrid<float> tempVelocity(myLiquidVelocity.xform(), myLiquidVelocity.gridSize(),
                                    VectorGridSettings::SampleType::STAGGERED);
 
     for (int axis : {0, 1, 2})
         advectField(dt, tempVelocity.grid(axis), myLiquidVelocity.grid(axis), velocityFunc, integrator);
 
-    std::swap(myLiquidVelocity, tempVelocity);
+    return tempVelocity;
 }
 
 void EulerianLiquidSimulator::runTimestep(float dt)
 {
-    std::cout << "\nStarting simulation loop\n" << std::endl;
+    myContext.execute([&] {
+        std::cout << "\nStarting simulation loop\n" << std::endl;
 
-    Timer simTimer;
+        // The timestep is expressed as a task graph so that independent stages can overlap. The cut-cell
+        // weights only depend on the solid and run alongside building the extrapolated liquid surface.
+        // After the pressure (and viscosity) solves, each velocity component is extrapolated independently
+        // and the advection of pressure, surface, viscosity and velocity all read the same extrapolated
+        // velocity field so they run concurrently. The advected velocity is only swapped in once every
+        // advection stage is finished.
+        using namespace tbb::flow;
 
-    LevelSet extrapolatedSurface = myLiquidSurface;
+        LevelSet& extrapolatedSurface = myExtrapolatedSurface;
+        VectorGrid<float> cutCellWeights, ghostFluidWeights;
+        std::array<BitMaskGrid, 3> validFaces;
+        VectorGrid<float> advectedVelocity;
 
-    float dx = extrapolatedSurface.dx();
+        float extrapolateSurfaceTime = 0, cutCellWeightsTime = 0, ghostFluidWeightsTime = 0;
+        float pressureTime = 0, viscosityTime = 0, viscosityPressureTime = 0;
+        std::array<float, 3> extrapolateVelocityTime;
+        float advectPressureTime = 0, advectSurfaceTime = 0, advectViscosityTime = 0, advectVelocityTime = 0;
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, myLiquidSurface.voxelCount(), tbbLightGrainSize),
-                      [&](tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = myLiquidSurface.unflatten(cellIndex);
+        graph taskGraph;
 
-                              if (mySolidSurface(cell) <= 0) extrapolatedSurface(cell) -= dx;
-                          }
-                      });
+        broadcast_node<continue_msg> startNode(taskGraph);
 
-    extrapolatedSurface.reinitMesh();
+        continue_node<continue_msg> extrapolateSurfaceNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
 
-    std::cout << "  Extrapolate into solids: " << simTimer.stop() << "s" << std::endl;
-    simTimer.reset();
+            assert(extrapolatedSurface.isGridMatched(myLiquidSurface));
 
-    VectorGrid<float> cutCellWeights = computeCutCellWeights(mySolidSurface, true);
-    VectorGrid<float> ghostFluidWeights = computeGhostFluidWeights(extrapolatedSurface);
+            float dx = extrapolatedSurface.dx();
 
-    std::cout << "  Compute weights: " << simTimer.stop() << "s" << std::endl;
-    simTimer.reset();
+            // Copy the liquid surface over and push it into the solid in the same sweep
+            mapGrids(
+                extrapolatedSurface.grid(),
+                [dx](float liquidPhi, float solidPhi) { return solidPhi <= 0 ? liquidPhi - dx : liquidPhi; },
+                myLiquidSurface.grid(), mySolidSurface.grid());
 
-    // Initialize and call pressure projection
-    PressureProjection projectDivergence(extrapolatedSurface, cutCellWeights, ghostFluidWeights, mySolidVelocity);
+            extrapolatedSurface.reinitMesh();
 
-    projectDivergence.setInitialGuess(myOldPressure);
-    projectDivergence.project(myLiquidVelocity);
+            extrapolateSurfaceTime = simTimer.stop();
+        });
 
-    myOldPressure = projectDivergence.getPressureGrid();
+        continue_node<continue_msg> cutCellWeightsNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            cutCellWeights = computeCutCellWeights(mySolidSurface, true);
+            cutCellWeightsTime = simTimer.stop();
+        });
 
-    const VectorGrid<VisitedCellLabels>& validFaces = projectDivergence.getValidFaces();
+        continue_node<continue_msg> ghostFluidWeightsNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            ghostFluidWeights = computeGhostFluidWeights(extrapolatedSurface);
+            ghostFluidWeightsTime = simTimer.stop();
+        });
 
-    assert(validFaces.isGridMatched(myLiquidVelocity));
+        continue_node<continue_msg> projectionNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
 
-    if (myDoSolveViscosity)
-    {
-        std::cout << "  Solve for pressure: " << simTimer.stop() << "s" << std::endl;
-        simTimer.reset();
+            // Initialize and call pressure projection
+            PressureProjection projectDivergence(extrapolatedSurface, cutCellWeights, ghostFluidWeights, mySolidVelocity);
 
-        ViscositySolver(dt, myLiquidSurface, myLiquidVelocity, mySolidSurface, mySolidVelocity, myViscosity);
+            if (myTallCellBand > 0) projectDivergence.enableTallCells(myTallCellBand);
+            if (myUseMatrixFreePressure) projectDivergence.enableMatrixFreeSolve();
+            projectDivergence.setConjugateGradientVariant(myPressureSolverVariant);
 
-        std::cout << "  Solve for viscosity: " << simTimer.stop() << "s" << std::endl;
-        simTimer.reset();
+            if (myPressureTolerance.mode() == SolverTolerance::Mode::RELATIVE_TO_PREVIOUS)
+                projectDivergence.setTolerance(myPressureTolerance.relativeTo(myPreviousMaxDivergence));
+            else
+                projectDivergence.setTolerance(myPressureTolerance);
 
-        projectDivergence.disableInitialGuess();
-        projectDivergence.project(myLiquidVelocity);
+            projectDivergence.setInitialGuess(myOldPressure);
+            projectDivergence.project(myLiquidVelocity);
 
-        std::cout << "  Solve for pressure after viscosity: " << simTimer.stop() << "s" << std::endl;
-        simTimer.reset();
-    }
-    else
-    {
-        std::cout << "  Solve for pressure: " << simTimer.stop() << "s" << std::endl;
-        simTimer.reset();
-    }
+            myOldPressure = ScalarGrid<Half>(projectDivergence.getPressureGrid());
+            myPreviousMaxDivergence = projectDivergence.initialMaxDivergence();
 
-    // Extrapolate velocity
-    for (int axis : {0, 1, 2})
-    {
-        // Zero out non-valid faces
-        tbb::parallel_for(tbb::blocked_range<int>(0, validFaces.grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = validFaces.grid(axis).unflatten(faceIndex);
-
-                                  if (validFaces(face, axis) != VisitedCellLabels::FINISHED_CELL)
-                                      myLiquidVelocity(face, axis) = 0;
-                              }
-                          });
-
-        extrapolateField(myLiquidVelocity.grid(axis), validFaces.grid(axis), 1.5 * myCFL);
-    }
+            pressureTime = simTimer.stop();
+
+            if (myDoSolveViscosity)
+            {
+                simTimer.reset();
 
-    std::cout << "  Extrapolate velocity: " << simTimer.stop() << "s" << std::endl;
-    simTimer.reset();
+                // The solvers read every cell several times so they get a float copy
+                ScalarGrid<float> viscosity(myViscosity);
 
-    advectOldPressure(dt);
-    advectLiquidSurface(dt, IntegrationOrder::RK3);
+                // Mildly viscous steps apply the stresses explicitly and skip the linear solve, unless the
+                // cut faces need too many substeps
+                bool isExplicit =
+                    myExplicitViscosityLimit > 0 &&
+                    viscousDiffusionNumber(dt, viscosity) <= myExplicitViscosityLimit &&
+                    ExplicitViscositySolver(dt, myLiquidSurface, myLiquidVelocity, mySolidSurface, mySolidVelocity,
+                                            viscosity, myExplicitViscositySubsteps) > 0;
 
-    if (myDoSolveViscosity) advectViscosity(dt, IntegrationOrder::FORWARDEULER);
+                if (!isExplicit)
+                {
+                    ViscosityPreconditioner viscosityPreconditioner = myUseMultigridViscosity
+                                                                          ? ViscosityPreconditioner::MULTIGRID
+                                                                          : ViscosityPreconditioner::JACOBI;
 
-    advectLiquidVelocity(dt, IntegrationOrder::RK3);
+                    ViscositySolver(dt, myLiquidSurface, myLiquidVelocity, mySolidSurface, mySolidVelocity,
+                                    viscosity, myViscositySolverVariant, viscosityPreconditioner,
+                                    myViscosityTolerance);
+                }
 
-    std::cout << "  Advect simulation: " << simTimer.stop() << "s" << std::endl;
-}
\ No newline at end of file
+                viscosityTime = simTimer.stop();
+                simTimer.reset();
+
+                projectDivergence.disableInitialGuess();
+                projectDivergence.project(myLiquidVelocity);
+
+                viscosityPressureTime = simTimer.stop();
+            }
+
+            // The valid faces only depend on the surface and weights so the last projection's are the same
+            validFaces = projectDivergence.takeValidFaces();
+
+#if !defined(NDEBUG)
+            for (int axis : {0, 1, 2}) assert(validFaces[axis].size() == myLiquidVelocity.size(axis));
+#endif
+        });
+
+        std::vector<std::unique_ptr<continue_node<continue_msg>>> extrapolateVelocityNodes;
+        for (int axis : {0, 1, 2})
+        {
+            extrapolateVelocityNodes.push_back(
+                std::make_unique<continue_node<continue_msg>>(taskGraph, [&, axis](const continue_msg&) {
+                    Timer simTimer;
+
+                    // Zero out non-valid faces
+                    validFaces[axis].forEachVoxel(false, [&](int faceIndex) {
+                        myLiquidVelocity(validFaces[axis].unflatten(faceIndex), axis) = 0;
+                    });
+
+                    // Nothing reads the mask after this so it's handed over to be used as the finished mask
+                    extrapolateField(myLiquidVelocity.grid(axis), std::move(validFaces[axis]), 1.5 * myCFL);
+
+                    extrapolateVelocityTime[axis] = simTimer.stop();
+                }));
+        }
+
+        continue_node<continue_msg> advectPressureNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            advectOldPressure(dt);
+            advectPressureTime = simTimer.stop();
+        });
+
+        continue_node<continue_msg> advectSurfaceNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            advectLiquidSurface(dt, IntegrationOrder::RK3);
+            advectSurfaceTime = simTimer.stop();
+        });
+
+        continue_node<continue_msg> advectViscosityNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            if (myDoSolveViscosity) advectViscosity(dt, IntegrationOrder::FORWARDEULER);
+            advectViscosityTime = simTimer.stop();
+        });
+
+        continue_node<continue_msg> advectVelocityNode(taskGraph, [&](const continue_msg&) {
+            Timer simTimer;
+            advectedVelocity = computeAdvectedVelocity(dt, IntegrationOrder::RK3);
+            advectVelocityTime = simTimer.stop();
+        });
+
+        make_edge(startNode, extrapolateSurfaceNode);
+        make_edge(startNode, cutCellWeightsNode);
+
+        make_edge(extrapolateSurfaceNode, ghostFluidWeightsNode);
+
+        make_edge(cutCellWeightsNode, projectionNode);
+        make_edge(ghostFluidWeightsNode, projectionNode);
+
+        for (auto& extrapolateVelocityNode : extrapolateVelocityNodes)
+        {
+            make_edge(projectionNode, *extrapolateVelocityNode);
+
+            make_edge(*extrapolateVelocityNode, advectPressureNode);
+            make_edge(*extrapolateVelocityNode, advectSurfaceNode);
+            make_edge(*extrapolateVelocityNode, advectViscosityNode);
+            make_edge(*extrapolateVelocityNode, advectVelocityNode);
+        }
+
+        startNode.try_put(continue_msg());
+        taskGraph.wait_for_all();
+
+        std::swap(myLiquidVelocity, advectedVelocity);
+
+        std::cout << "  Extrapolate into solids: " << extrapolateSurfaceTime << "s" << std::endl;
+        std::cout << "  Compute weights: " << cutCellWeightsTime << "s (cut-cell), " << ghostFluidWeightsTime
+                  << "s (ghost fluid)" << std::endl;
+        std::cout << "  Solve for pressure: " << pressureTime << "s" << std::endl;
+
+        if (myDoSolveViscosity)
+        {
+            std::cout << "  Solve for viscosity: " << viscosityTime << "s" << std::endl;
+            std::cout << "  Solve for pressure after viscosity: " << viscosityPressureTime << "s" << std::endl;
+        }
+
+        std::cout << "  Extrapolate velocity: " << extrapolateVelocityTime[0] << "s, " << extrapolateVelocityTime[1]
+                  << "s, " << extrapolateVelocityTime[2] << "s" << std::endl;
+        std::cout << "  Advect simulation: " << advectPressureTime << "s (pressure), " << advectSurfaceTime
+                  << "s (surface), " << advectViscosityTime << "s (viscosity), " << advectVelocityTime << "s (velocity)"
+                  << std::endl;
+    });
+}
@@ -1,8 +1,10 @@
 #ifndef EULERIAN_LIQUID_SIMULATOR_H
 #define EULERIAN_LIQUID_SIMULATOR_H
 
+#include "ConjugateGradient.h"
 #include "Integrator.h"
 #include "LevelSet.h"
+#include "LevelSetCSG.h"
 #include "ScalarGrid.h"
 #include "Transform.h"
 #include "Utilities.h"
@@ -19,6 +21,10 @@
 // Handles velocity, surface, viscosity field advection,
 // pressure projection, viscosity and velocity extrapolation.
 //
+// All parallel work runs in the simulator's execution context
+// so several simulators can share a node without competing
+// for the same threads.
+//
 ////////////////////////////////////
 
 using namespace FluidSim3D::SimTools;
@@ -28,38 +34,117 @@ using namespace FluidSim3D::Utilities;
 class EulerianLiquidSimulator
 {
 public:
-    EulerianLiquidSimulator(const Transform& xform, Vec3i size, float cfl = 5)
-        : myXform(xform), myDoSolveViscosity(false), myCFL(cfl)
+    EulerianLiquidSimulator(const Transform& xform, Vec3i size, float cfl = 5,
+                            const ExecutionContext& context = ExecutionContext())
+        : myXform(xform), myDoSolveViscosity(false), myCFL(cfl), myTallCellBand(0), myUseMatrixFreePressure(false),
+          myPressureSolverVariant(ConjugateGradientVariant::STANDARD),
+          myViscositySolverVariant(ConjugateGradientVariant::STANDARD), myUseMultigridViscosity(false),
+          myExplicitViscosityLimit(0), myExplicitViscositySubsteps(32), myPreviousMaxDivergence(0), myContext(context)
     {
         myLiquidVelocity = VectorGrid<float>(myXform, size, VectorGridSettings::SampleType::STAGGERED);
         mySolidVelocity = VectorGrid<float>(myXform, size, 0., VectorGridSettings::SampleType::STAGGERED);
 
         myLiquidSurface = LevelSet(myXform, size, myCFL);
         mySolidSurface = LevelSet(myXform, size, myCFL);
+        myExtrapolatedSurface = LevelSet(myXform, size, myCFL);
 
-        myOldPressure = ScalarGrid<float>(myXform, size, 0);
+        myOldPressure = ScalarGrid<Half>(myXform, size, 0);
     }
 
+    const ExecutionContext& executionContext() const { return myContext; }
+
     void setSolidSurface(const LevelSet& solidSurface);
     void setSolidVelocity(const VectorGrid<float>& solidVelocity);
     void setLiquidSurface(const LevelSet& liquidSurface);
     void setLiquidVelocity(const VectorGrid<float>& liquidVelocity);
 
+    // A velocity laid out like the simulation grid is adopted as is. Anything else is resampled
+    // like the overloads above.
+    void setSolidVelocity(VectorGrid<float>&& solidVelocity);
+    void setLiquidVelocity(VectorGrid<float>&& liquidVelocity);
+
+    // Borrowed views of the simulation state. They're only valid until the next call that changes it.
+    const LevelSet& liquidSurface() const { return myLiquidSurface; }
+    const LevelSet& solidSurface() const { return mySolidSurface; }
+    const VectorGrid<float>& liquidVelocity() const { return myLiquidVelocity; }
+
+    // Viscosity is stored at half precision so it has to be below 65504
     void setViscosity(const ScalarGrid<float>& viscosityGrid)
     {
         assert(myLiquidSurface.isGridMatched(viscosityGrid));
-        myViscosity = viscosityGrid;
+        assert(viscosityGrid.maxValue() < 65504);
+        myViscosity = ScalarGrid<Half>(viscosityGrid);
+        myDoSolveViscosity = true;
+    }
+
+    void setViscosity(ScalarGrid<Half>&& viscosityGrid)
+    {
+        assert(myLiquidSurface.isGridMatched(viscosityGrid));
+        myViscosity = std::move(viscosityGrid);
         myDoSolveViscosity = true;
     }
 
     void setViscosity(float constantViscosity = 1.)
     {
-        myViscosity = ScalarGrid<float>(myLiquidSurface.xform(), myLiquidSurface.size(), constantViscosity);
+        assert(constantViscosity < 65504);
+        myViscosity = ScalarGrid<Half>(myLiquidSurface.xform(), myLiquidSurface.size(), constantViscosity);
         myDoSolveViscosity = true;
     }
 
+    // Solve for pressure on tall cells away from the surface (see PressureProjection::enableTallCells).
+    // Useful for deep liquid where most of the interior pressure is close to hydrostatic.
+    void enableTallCellPressure(int surfaceBand = 4)
+    {
+        assert(surfaceBand >= 1);
+        myTallCellBand = surfaceBand;
+    }
+
+    void disableTallCellPressure() { myTallCellBand = 0; }
+
+    // Solve for pressure with the matrix-free stencil (see PressureProjection::enableMatrixFreeSolve)
+    void enableMatrixFreePressure() { myUseMatrixFreePressure = true; }
+
+    void disableMatrixFreePressure() { myUseMatrixFreePressure = false; }
+
+    // Choose the CG variant for each solve (see ConjugateGradient.h)
+    void setPressureSolverVariant(ConjugateGradientVariant variant) { myPressureSolverVariant = variant; }
+
+    void setViscositySolverVariant(ConjugateGradientVariant variant) { myViscositySolverVariant = variant; }
+
+    // When the solves stop (see ConjugateGradient.h). Pressure MAX_RESIDUAL tolerances are the largest
+    // divergence, in 1/s, left in any liquid cell. RELATIVE_TO_PREVIOUS is a fraction of the largest
+    // divergence the previous step started its projection with. Time budgets apply to each solve.
+    void setPressureTolerance(const SolverTolerance& tolerance) { myPressureTolerance = tolerance; }
+
+    void setViscosityTolerance(const SolverTolerance& tolerance)
+    {
+        assert(tolerance.mode() != SolverTolerance::Mode::RELATIVE_TO_PREVIOUS);
+        myViscosityTolerance = tolerance;
+    }
+
+    // Precondition the viscosity solve with a multigrid V-cycle (see ViscosityMultigrid.h)
+    void enableMultigridViscosity() { myUseMultigridViscosity = true; }
+
+    void disableMultigridViscosity() { myUseMultigridViscosity = false; }
+
+    // Steps whose largest viscosity * dt / dx^2 is at or below the limit try the sub-cycled explicit
+    // update instead of the linear solve. Steps whose cut faces would need more than maxSubsteps still
+    // solve implicitly. The default limit of zero always solves implicitly.
+    void setExplicitViscosityLimit(float limit, int maxSubsteps = 32)
+    {
+        assert(limit >= 0 && maxSubsteps > 0);
+        myExplicitViscosityLimit = limit;
+        myExplicitViscositySubsteps = maxSubsteps;
+    }
+
     void unionLiquidSurface(const LevelSet& addedLiquidSurface);
 
+    // Emit liquid from a source. Only the cells and faces inside the source's bounding box
+    // are touched so a continuous inflow costs time proportional to the source size.
+    // The source grid doesn't need to match the simulation grid.
+    void addLiquidSource(const LevelSet& sourceSurface);
+    void addLiquidSource(const LevelSetCSG& sourceSurface);
+
     template <typename ForceSampler>
     void addForce(float dt, const ForceSampler& force);
 
@@ -74,7 +159,10 @@ public:
     void runTimestep(float dt);
 
     // Useful for CFL
-    float maxVelocityMagnitude() { return myLiquidVelocity.maxMagnitude(); }
+    float maxVelocityMagnitude()
+    {
+        return myContext.execute([&] { return myLiquidVelocity.maxMagnitude(); });
+    }
 
     // Rendering tools
     void drawGrid(Renderer& renderer, bool onlyDrawNarrowBand = false) const;
@@ -86,17 +174,42 @@ public:
     void drawSolidVelocity(Renderer& renderer, Axis planeAxis, float planePosition, float length) const;
 
 private:
+    // Advect the liquid velocity into a new grid without replacing the current velocity
+    VectorGrid<float> computeAdvectedVelocity(float dt, IntegrationOrder integrator) const;
+
+    template <typename SurfaceSampler>
+    void addLiquidSource(const Vec3f& worldMin, const Vec3f& worldMax, const SurfaceSampler& sampler);
+
     // Simulation containers
     VectorGrid<float> myLiquidVelocity, mySolidVelocity;
     LevelSet myLiquidSurface, mySolidSurface;
-    ScalarGrid<float> myViscosity;
+
+    // Rebuilt by every timestep. Keeping it saves copying the liquid surface into a new grid.
+    LevelSet myExtrapolatedSurface;
+
+    // Secondary fields only need a few digits so they're stored as Half
+    ScalarGrid<Half> myViscosity;
 
     Transform myXform;
 
     bool myDoSolveViscosity;
     float myCFL;
 
-    ScalarGrid<float> myOldPressure;
+    // Zero solves on the full grid
+    int myTallCellBand;
+    bool myUseMatrixFreePressure;
+
+    ConjugateGradientVariant myPressureSolverVariant, myViscositySolverVariant;
+    bool myUseMultigridViscosity;
+    float myExplicitViscosityLimit;
+    int myExplicitViscositySubsteps;
+
+    SolverTolerance myPressureTolerance, myViscosityTolerance;
+    float myPreviousMaxDivergence;
+
+    ExecutionContext myContext;
+
+    ScalarGrid<Half> myOldPressure;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <mpi.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "DistributedLiquidSimulator.h"
+#include "InitialGeometry.h"
+#include "LevelSet.h"
+#include "SlabDecomposition.h"
+#include "Transform.h"
+#include "TriMesh.h"
+#include "Utilities.h"
+#include "Vec.h"
+
+///////////////////////////////////
+//
+// DistributedLiquid.cpp
+//
+// The LevelSetLiquid drop without the seed,
+// run headless over MPI ranks. Launch with
+// mpirun -np <ranks> DistributedLiquid [frames] [dx]
+// The root rank gathers the liquid surface at
+// the end of every frame and reports its volume.
+//
+////////////////////////////////////
+
+using namespace FluidSim3D::Distributed;
+using namespace FluidSim3D::SurfaceTrackers;
+using namespace FluidSim3D::Utilities;
+
+static constexpr float dt = 1. / 30.;
+static constexpr float cfl = 5.;
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        // Use the tuned scheduling policies if AutotuneScheduling has been run on this machine
+        loadSchedulingPolicies("schedulingPolicy.txt");
+
+        int frames = argc > 1 ? std::atoi(argv[1]) : 10;
+        float dx = argc > 2 ? std::atof(argv[2]) : .05;
+
+        float solidSphereRadius = 2;
+        Vec3f topRightCorner(solidSphereRadius + 15 * dx);
+        Vec3f bottomLeftCorner(-solidSphereRadius - 15 * dx);
+        Vec3i gridSize = Vec3i((topRightCorner - bottomLeftCorner) / dx);
+        Transform xform(dx, bottomLeftCorner);
+        Vec3f center = .5 * (topRightCorner + bottomLeftCorner);
+
+        SlabDecomposition decomposition(MPI_COMM_WORLD, xform, gridSize, DistributedLiquidSimulator::ghostWidth(cfl));
+
+        // Every rank builds the same meshes and scan converts its own slab
+        TriMesh liquidMesh = makeSphereMesh(center - Vec3f(0, .65, 0), 1, .5 * dx);
+        assert(liquidMesh.unitTestMesh());
+
+        TriMesh solidMesh = makeSphereMesh(center, 2, .5 * dx);
+        solidMesh.reverse();
+        assert(solidMesh.unitTestMesh());
+
+        DistributedLiquidSimulator simulator(decomposition, cfl);
+        simulator.setLiquidSurface(liquidMesh);
+        simulator.setSolidSurface(solidMesh);
+
+        LevelSet globalSurface;
+        if (decomposition.isRoot()) globalSurface = LevelSet(xform, gridSize, cfl);
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            if (decomposition.isRoot()) std::cout << "\nStart of frame: " << frame << std::endl;
+
+            float frameTime = 0.;
+            while (frameTime < dt)
+            {
+                // Set CFL condition
+                float speed = simulator.maxVelocityMagnitude();
+                float localDt = dt - frameTime;
+                assert(localDt >= 0);
+
+                if (speed > 1E-6)
+                {
+                    float cflDt = cfl * xform.dx() / speed;
+                    if (localDt > cflDt) localDt = cflDt;
+                }
+
+                if (localDt <= 0) break;
+
+                // Add gravity
+                simulator.addForce(localDt, Vec3f(0, -9.8, 0));
+
+                simulator.runTimestep(localDt);
+
+                frameTime += localDt;
+            }
+
+            simulator.gatherLiquidSurface(globalSurface);
+
+            if (decomposition.isRoot())
+            {
+                int liquidCellCount = 0;
+                forEachVoxelRange(Vec3i(0), gridSize, [&](const Vec3i& cell) {
+                    if (globalSurface(cell) <= 0) ++liquidCellCount;
+                });
+
+                std::cout << "\nEnd of frame: " << frame << ". Liquid volume: " << liquidCellCount * dx * dx * dx
+                          << " (" << decomposition.rankCount() << " ranks)" << std::endl;
+            }
+        }
+    }
+
+    MPI_Finalize();
+}
@@ -70,7 +70,7 @@ void display()
 
             if (seedTime > seedPeriod)
             {
-                simulator->unionLiquidSurface(seedSurface);
+                simulator->addLiquidSource(seedSurface);
                 seedTime = 0;
             }
 
@@ -131,6 +131,9 @@ void keyboard(unsigned char key, int x, int y)
 
 int main(int argc, char** argv)
 {
+    // Use the tuned scheduling policies if AutotuneScheduling has been run on this machine
+    loadSchedulingPolicies("schedulingPolicy.txt");
+
     float dx = .05;
     float solidSphereRadius = 2;
     Vec3f topRightCorner(solidSphereRadius + 15 * dx);
@@ -158,8 +161,9 @@ int main(int argc, char** argv)
     Vec3f seedCenter = center + Vec3f(.6, .6, 0);
     TriMesh seedMesh = makeCubeMesh(seedCenter, Vec3f(.5));
 
-    seedSurface = LevelSet(xform, gridSize, 5);
-    seedSurface.initFromMesh(seedMesh, false);
+    // The seed only needs a grid around itself since it's stamped into the simulation as a source
+    seedSurface = LevelSet(xform, Vec3i(0), 5);
+    seedSurface.initFromMesh(seedMesh, true);
 
     // Build solid boundary
 
@@ -6,7 +6,7 @@
 #include "InitialGeometry.h"
 #include "LevelSet.h"
 #include "Renderer.h"
-#include "TestVelocityFields.h"
+#include "SolidObject.h"
 #include "Transform.h"
 #include "TriMesh.h"
 #include "Utilities.h"
@@ -34,13 +34,13 @@ static float planeDX = .05;
 static Axis planeAxis = Axis::ZAXIS;
 
 static std::unique_ptr<EulerianLiquidSimulator> simulator;
-static std::unique_ptr<CircularField> solidVelocityField;
-
-static TriMesh movingSolidMesh;
-static TriMesh staticSolidMesh;
+static std::unique_ptr<CompositeSolid> solidGeometry;
 
 static LevelSet seedLiquidSurface;
 
+// Resampled from the solids every substep
+static LevelSet combinedSolidSurface;
+
 static Transform xform;
 static Vec3i gridSize;
 
@@ -77,44 +77,23 @@ void display()
             simulator->addForce(localDt, Vec3f(0, -9.8, 0));
 
             // Update moving solid
-            movingSolidMesh.advectMesh(localDt, *solidVelocityField, IntegrationOrder::RK3);
+            solidGeometry->advance(localDt);
 
-            // Need moving solid volume to build sampled velocity
-            LevelSet movingSolidSurface(xform, gridSize, 5);
-            movingSolidSurface.initFromMesh(movingSolidMesh, false);
+            // The solids were scan converted once at start up so building the combined
+            // surface and the moving solid velocity is a lookup per sample. The velocity
+            // matches the simulation grid so the simulator takes it over without resampling.
+            solidGeometry->sampleSurface(combinedSolidSurface);
 
             VectorGrid<float> movingSolidVelocity(xform, gridSize, 0, VectorGridSettings::SampleType::STAGGERED);
-
-            // Set moving solid velocity
-            for (int axis : {0, 1, 2})
-            {
-                tbb::parallel_for(
-                    tbb::blocked_range<int>(0, movingSolidVelocity.grid(axis).voxelCount(), tbbLightGrainSize),
-                    [&](const tbb::blocked_range<int>& range) {
-                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                        {
-                            Vec3i face = movingSolidVelocity.grid(axis).unflatten(faceIndex);
-
-                            Vec3f worldPosition = movingSolidVelocity.indexToWorld(Vec3f(face), axis);
-
-                            if (movingSolidSurface.interp(worldPosition) < xform.dx())
-                                movingSolidVelocity(face, axis) = (*solidVelocityField)(0, worldPosition)[axis];
-                        }
-                    });
-            }
-
-            LevelSet combinedSolidSurface(xform, gridSize, 5);
-            combinedSolidSurface.setBackgroundNegative();
-            combinedSolidSurface.initFromMesh(staticSolidMesh, false);
-            combinedSolidSurface.unionSurface(movingSolidSurface);
+            solidGeometry->sampleVelocity(movingSolidVelocity, xform.dx());
 
             simulator->setSolidSurface(combinedSolidSurface);
-            simulator->setSolidVelocity(movingSolidVelocity);
+            simulator->setSolidVelocity(std::move(movingSolidVelocity));
 
             // Projection set unfortunately includes viscosity at the moment
             simulator->runTimestep(localDt);
 
-            simulator->unionLiquidSurface(seedLiquidSurface);
+            simulator->addLiquidSource(seedLiquidSurface);
 
             frameTime += localDt;
         }
@@ -164,6 +143,9 @@ void keyboard(unsigned char key, int x, int y)
 
 int main(int argc, char** argv)
 {
+    // Use the tuned scheduling policies if AutotuneScheduling has been run on this machine
+    loadSchedulingPolicies("schedulingPolicy.txt");
+
     float dx = .025;
     Vec3f topRightCorner(1.75, 1.75, .75);
     Vec3f bottomLeftCorner(-1.75, -1.75, -.75);
@@ -180,29 +162,36 @@ int main(int argc, char** argv)
     // Build static boundary geometry
     float solidThickness = 10;
     Vec3f solidScale = .5 * (topRightCorner - bottomLeftCorner) - Vec3f(solidThickness * dx);
-    staticSolidMesh = makeCubeMesh(center, solidScale);
+    TriMesh staticSolidMesh = makeCubeMesh(center, solidScale);
     staticSolidMesh.reverse();
     assert(staticSolidMesh.unitTestMesh());
 
-    // Build moving boundary geometry
+    LevelSet staticSolidSurface(xform, gridSize, 5);
+    staticSolidSurface.setBackgroundNegative();
+    staticSolidSurface.initFromMesh(staticSolidMesh, false);
 
-    movingSolidMesh = makeSphereMesh(center + Vec3f(.75, -.25, 0), .25, dx);
+    solidGeometry = std::make_unique<CompositeSolid>(staticSolidSurface);
 
-    LevelSet movingSolidSurface(xform, gridSize, 5);
-    movingSolidSurface.initFromMesh(movingSolidMesh, false);
+    // Build moving boundary geometry. The sphere orbits the center of the domain
+    // clockwise about the z-axis.
+    TriMesh movingSolidMesh = makeSphereMesh(center + Vec3f(.75, -.25, 0), .25, dx);
 
-    LevelSet combinedSolidSurface(xform, gridSize, 5);
+    SolidObject movingSolid(movingSolidMesh, center, dx, 5);
+    movingSolid.setAngularVelocity(Vec3f(0, 0, -1));
+    solidGeometry->addSolid(movingSolid);
+
+    combinedSolidSurface = LevelSet(xform, gridSize, 5);
     combinedSolidSurface.setBackgroundNegative();
-    combinedSolidSurface.initFromMesh(staticSolidMesh, false);
-    combinedSolidSurface.unionSurface(movingSolidSurface);
+    solidGeometry->sampleSurface(combinedSolidSurface);
 
     // Build seeding liquid geometry
 
     TriMesh seedLiquidMesh = makeCubeMesh(center + Vec3f(0, .5, 0), Vec3f(.1, .25, .1));
     assert(seedLiquidMesh.unitTestMesh());
 
-    seedLiquidSurface = LevelSet(xform, gridSize, 5);
-    seedLiquidSurface.initFromMesh(seedLiquidMesh, false);
+    // The seed only needs a grid around itself since it's stamped into the simulation as a source
+    seedLiquidSurface = LevelSet(xform, Vec3i(0), 5);
+    seedLiquidSurface.initFromMesh(seedLiquidMesh, true);
 
     // Set up simulator
     simulator = std::make_unique<EulerianLiquidSimulator>(xform, gridSize, 5);
@@ -212,9 +201,6 @@ int main(int argc, char** argv)
 
     simulator->setViscosity(1.);
 
-    // Set up moving solid field
-    solidVelocityField = std::make_unique<CircularField>(center, 1, Axis::ZAXIS);
-
     std::function<void()> displayFunc = display;
     renderer->setUserDisplay(displayFunc);
 
@@ -73,32 +73,32 @@ int main(int argc, char** argv)
     testScalarGrid = std::make_unique<ScalarGrid<float>>(xform, gridSize);
     testVectorGrid = std::make_unique<VectorGrid<float>>(xform, gridSize, VectorGridSettings::SampleType::STAGGERED);
 
-    tbb::parallel_for(tbb::blocked_range<int>(0, testScalarGrid->voxelCount(), tbbLightGrainSize),
-                      [&](const tbb::blocked_range<int>& range) {
-                          for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
-                          {
-                              Vec3i cell = testScalarGrid->unflatten(cellIndex);
-
-                              Vec3f worldPoint = testScalarGrid->indexToWorld(Vec3f(cell));
-                              (*testScalarGrid)(cell) =
-                                  sqrt(sqr(worldPoint[0]) + sqr(worldPoint[1]) + sqr(worldPoint[2])) - 5.;
-                          }
-                      });
+    parallelFor(KernelClass::LIGHT, 0, testScalarGrid->voxelCount(),
+                [&](const tbb::blocked_range<int>& range) {
+                    for (int cellIndex = range.begin(); cellIndex != range.end(); ++cellIndex)
+                    {
+                        Vec3i cell = testScalarGrid->unflatten(cellIndex);
+
+                        Vec3f worldPoint = testScalarGrid->indexToWorld(Vec3f(cell));
+                        (*testScalarGrid)(cell) =
+                            sqrt(sqr(worldPoint[0]) + sqr(worldPoint[1]) + sqr(worldPoint[2])) - 5.;
+                    }
+                });
 
     for (int axis : {0, 1, 2})
     {
-        tbb::parallel_for(tbb::blocked_range<int>(0, testVectorGrid->grid(axis).voxelCount(), tbbLightGrainSize),
-                          [&](const tbb::blocked_range<int>& range) {
-                              for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
-                              {
-                                  Vec3i face = testVectorGrid->grid(axis).unflatten(faceIndex);
-
-                                  Vec3f worldPoint = testVectorGrid->indexToWorld(Vec3f(face), axis);
-
-                                  Vec3f gradVector = testScalarGrid->gradient(worldPoint);
-                                  (*testVectorGrid)(face, axis) = gradVector[axis];
-                              }
-                          });
+        parallelFor(KernelClass::LIGHT, 0, testVectorGrid->grid(axis).voxelCount(),
+                    [&](const tbb::blocked_range<int>& range) {
+                        for (int faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex)
+                        {
+                            Vec3i face = testVectorGrid->grid(axis).unflatten(faceIndex);
+
+                            Vec3f worldPoint = testVectorGrid->indexToWorld(Vec3f(face), axis);
+
+                            Vec3f gradVector = testScalarGrid->gradient(worldPoint);
+                            (*testVectorGrid)(face, axis) = gradVector[axis];
+                        }
+                    });
     }
 
     std::function<void()> displayFunc = display;
@@ -0,0 +1,102 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "ComputeWeights.h"
+#include "FieldAdvector.h"
+#include "InitialGeometry.h"
+#include "Integrator.h"
+#include "LevelSet.h"
+#include "ScalarGrid.h"
+#include "SchedulingPolicy.h"
+#include "Transform.h"
+#include "Utilities.h"
+#include "Vec.h"
+#include "VectorGrid.h"
+
+///////////////////////////////////
+//
+// AutotuneScheduling.cpp
+//
+// Times each kernel class over a sweep of grain
+// sizes and partitioners and writes the fastest
+// policies to a file that the simulation scenes
+// load at startup. The timed loops are simulator
+// kernels on a tank of liquid: advection and the
+// ghost fluid weights for LIGHT, the cut-cell
+// weights and supersampled volumes for HEAVY.
+// Run as
+// AutotuneScheduling [policy file] [cells per axis]
+//
+////////////////////////////////////
+
+using namespace FluidSim3D::SimTools;
+using namespace FluidSim3D::SurfaceTrackers;
+using namespace FluidSim3D::Utilities;
+
+int main(int argc, char** argv)
+{
+    std::string filename = argc > 1 ? argv[1] : "schedulingPolicy.txt";
+    int resolution = argc > 2 ? std::atoi(argv[2]) : 64;
+
+    float dx = 2. / float(resolution);
+    Transform xform(dx, Vec3f(-1));
+    Vec3i gridSize(resolution);
+
+    TriMesh solidMesh = makeCubeMesh(Vec3f(0), Vec3f(.9));
+    solidMesh.reverse();
+
+    LevelSet solidSurface(xform, gridSize, 5);
+    solidSurface.setBackgroundNegative();
+    solidSurface.initFromMesh(solidMesh, false);
+
+    LevelSet liquidSurface(xform, gridSize, 5);
+    liquidSurface.initFromMesh(makeSphereMesh(Vec3f(0, -.2, 0), .6, dx), false);
+
+    // A smooth swirl for the advection kernel
+    VectorGrid<float> velocity(xform, gridSize, VectorGridSettings::SampleType::STAGGERED);
+    for (int axis : {0, 1, 2})
+    {
+        forEachVoxelRange(Vec3i(0), velocity.size(axis), [&](const Vec3i& face) {
+            Vec3f point = velocity.indexToWorld(Vec3f(face), axis);
+            velocity(face, axis) = std::sin(3. * point[(axis + 1) % 3]) * std::cos(2. * point[(axis + 2) % 3]);
+        });
+    }
+
+    auto velocityFunc = [&](float, const Vec3f& point) {
+        return velocity.interp<VectorGridSettings::SampleType::STAGGERED, ScalarGridSettings::BorderType::CLAMP>(point);
+    };
+
+    ScalarGrid<float> sourceField(xform, gridSize), advectedField(xform, gridSize);
+    ScalarGrid<float> centerVolumes(xform, gridSize);
+
+    autotuneSchedulingPolicies([&](KernelClass kernelClass) {
+        if (kernelClass == KernelClass::LIGHT)
+        {
+            advectField(1. / 30., advectedField, sourceField, velocityFunc, IntegrationOrder::RK3);
+            computeGhostFluidWeights(liquidSurface);
+        }
+        else
+        {
+            computeCutCellWeights(solidSurface, true);
+            computeSupersampleVolumes(centerVolumes, liquidSurface, 3);
+        }
+    });
+
+    for (KernelClass kernelClass : {KernelClass::LIGHT, KernelClass::HEAVY})
+    {
+        const SchedulingPolicy& policy = schedulingPolicy(kernelClass);
+        std::cout << kernelClassName(kernelClass) << ": grain size " << policy.myGrainSize << ", "
+                  << partitionerName(policy.myPartitioner) << " partitioner" << std::endl;
+    }
+
+    if (!saveSchedulingPolicies(filename))
+    {
+        std::cerr << "Failed to write " << filename << std::endl;
+        return 1;
+    }
+
+    std::cout << "Saved to " << filename << std::endl;
+    return 0;
+}
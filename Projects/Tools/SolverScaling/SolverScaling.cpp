@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ComputeWeights.h"
+#include "ConjugateGradient.h"
+#include "ExecutionContext.h"
+#include "InitialGeometry.h"
+#include "LevelSet.h"
+#include "PressureProjection.h"
+#include "ScalarGrid.h"
+#include "Timer.h"
+#include "Transform.h"
+#include "Utilities.h"
+#include "Vec.h"
+#include "VectorGrid.h"
+#include "ViscositySolver.h"
+
+///////////////////////////////////
+//
+// SolverScaling.cpp
+//
+// Times the pressure and viscosity solves on a
+// tank of liquid with every CG variant, over
+// thread counts doubling up to the machine's
+// concurrency. Run as
+// SolverScaling [cells per axis] [repeats]
+// The solver logs go to stdout; the table of
+// timings and speed-ups is written to stderr.
+//
+////////////////////////////////////
+
+using namespace FluidSim3D::SimTools;
+using namespace FluidSim3D::SurfaceTrackers;
+using namespace FluidSim3D::Utilities;
+
+struct SolverCase
+{
+    const char* myName;
+    ConjugateGradientVariant myVariant;
+    bool myIsMatrixFree;
+    bool myIsViscosity;
+};
+
+int main(int argc, char** argv)
+{
+    int resolution = argc > 1 ? std::atoi(argv[1]) : 64;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    float dx = 2. / float(resolution);
+    Transform xform(dx, Vec3f(-1));
+    Vec3i gridSize(resolution);
+
+    TriMesh solidMesh = makeCubeMesh(Vec3f(0), Vec3f(.9));
+    solidMesh.reverse();
+
+    LevelSet solidSurface(xform, gridSize, 5);
+    solidSurface.setBackgroundNegative();
+    solidSurface.initFromMesh(solidMesh, false);
+
+    LevelSet liquidSurface(xform, gridSize, 5);
+    liquidSurface.initFromMesh(makeCubeMesh(Vec3f(0, -.3, 0), Vec3f(.95, .65, .95)), false);
+
+    VectorGrid<float> solidVelocity(xform, gridSize, 0, VectorGridSettings::SampleType::STAGGERED);
+    VectorGrid<float> cutCellWeights = computeCutCellWeights(solidSurface, true);
+    VectorGrid<float> ghostFluidWeights = computeGhostFluidWeights(liquidSurface);
+
+    ScalarGrid<float> viscosity(xform, gridSize, 1.);
+
+    // A smooth swirl so every solve has real work to do
+    VectorGrid<float> initialVelocity(xform, gridSize, VectorGridSettings::SampleType::STAGGERED);
+    for (int axis : {0, 1, 2})
+    {
+        forEachVoxelRange(Vec3i(0), initialVelocity.size(axis), [&](const Vec3i& face) {
+            Vec3f point = initialVelocity.indexToWorld(Vec3f(face), axis);
+            initialVelocity(face, axis) =
+                std::sin(3. * point[(axis + 1) % 3]) * std::cos(2. * point[(axis + 2) % 3]) - (axis == 1 ? 1 : 0);
+        });
+    }
+
+    const std::vector<SolverCase> solverCases = {
+        {"pressure", ConjugateGradientVariant::STANDARD, false, false},
+        {"pressure", ConjugateGradientVariant::PIPELINED, false, false},
+        {"pressure (matrix-free)", ConjugateGradientVariant::STANDARD, true, false},
+        {"pressure (matrix-free)", ConjugateGradientVariant::PIPELINED, true, false},
+        {"viscosity", ConjugateGradientVariant::STANDARD, false, true},
+        {"viscosity", ConjugateGradientVariant::PIPELINED, false, true}};
+
+    std::vector<int> threadCounts;
+    int maxThreadCount = tbb::this_task_arena::max_concurrency();
+    for (int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2) threadCounts.push_back(threadCount);
+    threadCounts.push_back(maxThreadCount);
+
+    // Best time for each case and thread count
+    std::vector<std::vector<float>> timings(solverCases.size(), std::vector<float>(threadCounts.size()));
+
+    for (int threadIndex = 0; threadIndex < int(threadCounts.size()); ++threadIndex)
+    {
+        ExecutionContext context(threadCounts[threadIndex]);
+
+        for (int caseIndex = 0; caseIndex < int(solverCases.size()); ++caseIndex)
+        {
+            const SolverCase& solverCase = solverCases[caseIndex];
+
+            float bestTime = std::numeric_limits<float>::max();
+
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                VectorGrid<float> velocity = initialVelocity;
+
+                Timer timer;
+
+                context.execute([&] {
+                    if (solverCase.myIsViscosity)
+                        ViscositySolver(1. / 30., liquidSurface, velocity, solidSurface, solidVelocity, viscosity,
+                                        solverCase.myVariant);
+                    else
+                    {
+                        PressureProjection projectDivergence(liquidSurface, cutCellWeights, ghostFluidWeights,
+                                                             solidVelocity);
+
+                        if (solverCase.myIsMatrixFree) projectDivergence.enableMatrixFreeSolve();
+                        projectDivergence.setConjugateGradientVariant(solverCase.myVariant);
+
+                        projectDivergence.project(velocity);
+                    }
+                });
+
+                bestTime = std::min(bestTime, timer.stop());
+            }
+
+            timings[caseIndex][threadIndex] = bestTime;
+        }
+    }
+
+    std::cerr << "\nGrid " << resolution << "^3, best of " << repeats << "\n" << std::endl;
+    std::cerr << std::left << std::setw(24) << "solve" << std::setw(12) << "variant";
+    for (int threadCount : threadCounts) std::cerr << std::setw(18) << (std::to_string(threadCount) + " threads");
+    std::cerr << std::endl;
+
+    for (int caseIndex = 0; caseIndex < int(solverCases.size()); ++caseIndex)
+    {
+        const SolverCase& solverCase = solverCases[caseIndex];
+
+        std::cerr << std::left << std::setw(24) << solverCase.myName << std::setw(12)
+                  << (solverCase.myVariant == ConjugateGradientVariant::PIPELINED ? "pipelined" : "standard");
+
+        for (int threadIndex = 0; threadIndex < int(threadCounts.size()); ++threadIndex)
+        {
+            float time = timings[caseIndex][threadIndex];
+            float speedup = timings[caseIndex][0] / time;
+
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(3) << time << "s (" << std::setprecision(1) << speedup << "x)";
+            std::cerr << std::setw(18) << cell.str();
+        }
+
+        std::cerr << std::endl;
+    }
+
+    return 0;
+}